@@ -25,6 +25,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 
 #include <errno.h>
@@ -33,6 +34,7 @@
 #include <time.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -43,7 +45,9 @@
 #include <dpkg/c-ctype.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/string.h>
 #include <dpkg/path.h>
+#include <dpkg/clock.h>
 #include <dpkg/treewalk.h>
 #include <dpkg/varbuf.h>
 #include <dpkg/fdio.h>
@@ -102,18 +106,6 @@ file_info_free(struct file_info *fi)
   free(fi);
 }
 
-static struct file_info *
-file_info_find_name(struct file_info *list, const char *filename)
-{
-  struct file_info *node;
-
-  for (node = list; node; node = node->next)
-    if (strcmp(node->fn, filename) == 0)
-      return node;
-
-  return NULL;
-}
-
 /**
  * Add a new file_info struct to a single linked list of file_info structs.
  *
@@ -149,6 +141,147 @@ file_info_list_free(struct file_info *fi)
   }
 }
 
+/**
+ * Hashed set of file_info structs, to be able to check for duplicates
+ * without scanning all the entries added so far.
+ */
+struct file_info_set {
+  struct file_info **bins;
+  size_t nbins;
+  size_t nentries;
+};
+
+#define FILE_INFO_SET_INIT { NULL, 0, 0 }
+
+static struct file_info **
+file_info_set_bin(struct file_info_set *set, const char *filename)
+{
+  return &set->bins[str_fnv_hash(filename) % set->nbins];
+}
+
+static void
+file_info_set_grow(struct file_info_set *set)
+{
+  struct file_info **oldbins = set->bins;
+  size_t oldnbins = set->nbins;
+  size_t i;
+
+  set->nbins = oldnbins ? oldnbins * 2 + 1 : 127;
+  set->bins = m_calloc(set->nbins, sizeof(*set->bins));
+
+  for (i = 0; i < oldnbins; i++) {
+    struct file_info *fi, *fi_next;
+
+    for (fi = oldbins[i]; fi; fi = fi_next) {
+      struct file_info **bin = file_info_set_bin(set, fi->fn);
+
+      fi_next = fi->next;
+      fi->next = *bin;
+      *bin = fi;
+    }
+  }
+
+  free(oldbins);
+}
+
+/**
+ * Add a filename to the set, if not already present.
+ *
+ * @return Whether the filename was added, false if it was a duplicate.
+ */
+static bool
+file_info_set_add(struct file_info_set *set, const char *filename)
+{
+  struct file_info **bin;
+  struct file_info *fi;
+
+  if (set->nentries >= set->nbins)
+    file_info_set_grow(set);
+
+  bin = file_info_set_bin(set, filename);
+  for (fi = *bin; fi; fi = fi->next)
+    if (strcmp(fi->fn, filename) == 0)
+      return false;
+
+  fi = file_info_new(filename);
+  fi->next = *bin;
+  *bin = fi;
+  set->nentries++;
+
+  return true;
+}
+
+static void
+file_info_set_destroy(struct file_info_set *set)
+{
+  size_t i;
+
+  for (i = 0; i < set->nbins; i++)
+    file_info_list_free(set->bins[i]);
+  free(set->bins);
+
+  set->bins = NULL;
+  set->nbins = 0;
+  set->nentries = 0;
+}
+
+/**
+ * A directory used as the base for stat calls on its contents.
+ *
+ * When the system supports it, the directory is opened once and the
+ * entries are stat()ed relative to it, instead of walking the whole
+ * pathname for each entry.
+ */
+struct stat_dir {
+  const char *path;
+  struct varbuf pathname;
+  int fd;
+};
+
+static void
+stat_dir_open(struct stat_dir *sd, const char *path)
+{
+  sd->path = path;
+  varbuf_init(&sd->pathname, 0);
+#ifdef HAVE_FSTATAT
+  sd->fd = open(path, O_RDONLY | O_DIRECTORY);
+#else
+  sd->fd = -1;
+#endif
+}
+
+/**
+ * Get the status of a file relative to the directory, without following
+ * a trailing symlink.
+ */
+static int
+stat_dir_lstat(struct stat_dir *sd, const char *filename, struct stat *st)
+{
+#ifdef HAVE_FSTATAT
+  if (sd->fd >= 0) {
+    const char *relname = path_skip_slash_dotslash(filename);
+
+    if (relname[0] == '\0')
+      relname = ".";
+
+    return fstatat(sd->fd, relname, st, AT_SYMLINK_NOFOLLOW);
+  }
+#endif
+
+  varbuf_reset(&sd->pathname);
+  varbuf_printf(&sd->pathname, "%s/%s", sd->path, filename);
+
+  return lstat(sd->pathname.buf, st);
+}
+
+static void
+stat_dir_close(struct stat_dir *sd)
+{
+  if (sd->fd >= 0)
+    close(sd->fd);
+  varbuf_destroy(&sd->pathname);
+}
+
 static void
 file_treewalk_feed(const char *dir, int fd_out)
 {
@@ -208,12 +341,13 @@ static const char *const maintainerscripts[] = {
 static void
 check_file_perms(const char *ctrldir)
 {
-  struct varbuf path = VARBUF_INIT;
+  struct stat_dir sd;
   const char *const *mscriptp;
   struct stat mscriptstab;
 
-  varbuf_printf(&path, "%s/", ctrldir);
-  if (lstat(path.buf, &mscriptstab))
+  stat_dir_open(&sd, ctrldir);
+
+  if (stat_dir_lstat(&sd, "", &mscriptstab))
     ohshite(_("unable to stat control directory"));
   if (!S_ISDIR(mscriptstab.st_mode))
     ohshit(_("control directory is not a directory"));
@@ -223,9 +357,7 @@ check_file_perms(const char *ctrldir)
            (unsigned long)(mscriptstab.st_mode & 07777));
 
   for (mscriptp = maintainerscripts; *mscriptp; mscriptp++) {
-    varbuf_reset(&path);
-    varbuf_printf(&path, "%s/%s", ctrldir, *mscriptp);
-    if (!lstat(path.buf, &mscriptstab)) {
+    if (!stat_dir_lstat(&sd, *mscriptp, &mscriptstab)) {
       if (S_ISLNK(mscriptstab.st_mode))
         continue;
       if (!S_ISREG(mscriptstab.st_mode))
@@ -240,7 +372,7 @@ check_file_perms(const char *ctrldir)
     }
   }
 
-  varbuf_destroy(&path);
+  stat_dir_close(&sd);
 }
 
 /**
@@ -252,8 +384,8 @@ check_conffiles(const char *ctrldir, const char *rootdir)
   FILE *cf;
   struct varbuf controlfile = VARBUF_INIT;
   char conffilename[MAXCONFFILENAME + 1];
-  struct file_info *conffiles_head = NULL;
-  struct file_info *conffiles_tail = NULL;
+  struct file_info_set conffiles = FILE_INFO_SET_INIT;
+  struct stat_dir rootsd;
 
   varbuf_printf(&controlfile, "%s/%s", ctrldir, CONFFILESFILE);
 
@@ -265,6 +397,8 @@ check_conffiles(const char *ctrldir, const char *rootdir)
     ohshite(_("error opening conffiles file"));
   }
 
+  stat_dir_open(&rootsd, rootdir);
+
   while (fgets(conffilename, MAXCONFFILENAME + 1, cf)) {
     struct stat controlstab;
     int n;
@@ -278,9 +412,7 @@ check_conffiles(const char *ctrldir, const char *rootdir)
              conffilename);
 
     conffilename[n - 1] = '\0';
-    varbuf_reset(&controlfile);
-    varbuf_printf(&controlfile, "%s/%s", rootdir, conffilename);
-    if (lstat(controlfile.buf, &controlstab)) {
+    if (stat_dir_lstat(&rootsd, conffilename, &controlstab)) {
       if (errno == ENOENT) {
         if ((n > 1) && c_isspace(conffilename[n - 2]))
           warning(_("conffile filename '%s' contains trailing white spaces"),
@@ -292,17 +424,12 @@ check_conffiles(const char *ctrldir, const char *rootdir)
       warning(_("conffile '%s' is not a plain file"), conffilename);
     }
 
-    if (file_info_find_name(conffiles_head, conffilename)) {
+    if (!file_info_set_add(&conffiles, conffilename))
       warning(_("conffile name '%s' is duplicated"), conffilename);
-    } else {
-      struct file_info *conffile;
-
-      conffile = file_info_new(conffilename);
-      file_info_list_append(&conffiles_head, &conffiles_tail, conffile);
-    }
   }
 
-  file_info_list_free(conffiles_head);
+  stat_dir_close(&rootsd);
+  file_info_set_destroy(&conffiles);
   varbuf_destroy(&controlfile);
 
   if (ferror(cf))
@@ -418,6 +545,8 @@ gen_dest_pathname_from_pkg(const char *dir, struct pkginfo *pkg)
 
 typedef void filenames_feed_func(const char *dir, int fd_out);
 
+typedef void tarball_writer_func(int fd_tarball, void *data);
+
 struct tar_pack_options {
   time_t timestamp;
   const char *mode;
@@ -426,11 +555,14 @@ struct tar_pack_options {
 
 /**
  * Pack the contents of a directory into a tarball.
+ *
+ * The tarball writer is run in its own subprocess, and is in charge of
+ * compressing the tar stream read from fd_tarball into its destination.
  */
 static void
 tarball_pack(const char *dir, filenames_feed_func *tar_filenames_feeder,
              struct tar_pack_options *options,
-             struct compress_params *tar_compress_params, int fd_out)
+             tarball_writer_func *tarball_writer, void *writer_data)
 {
   int pipe_filenames[2], pipe_tarball[2];
   pid_t pid_tar, pid_comp;
@@ -474,8 +606,7 @@ tarball_pack(const char *dir, filenames_feed_func *tar_filenames_feeder,
   pid_comp = subproc_fork();
   if (pid_comp == 0) {
     close(pipe_filenames[1]);
-    compress_filter(tar_compress_params, pipe_tarball[0], fd_out,
-                    _("compressing tar member"));
+    tarball_writer(pipe_tarball[0], writer_data);
     exit(0);
   }
   close(pipe_tarball[0]);
@@ -489,6 +620,230 @@ tarball_pack(const char *dir, filenames_feed_func *tar_filenames_feeder,
   subproc_reap(pid_tar, "tar -cf", 0);
 }
 
+/**
+ * Tarball writer compressing into a plain file descriptor.
+ */
+struct tarball_file_writer {
+  struct compress_params *params;
+  int fd_out;
+};
+
+static void
+tarball_write_file(int fd_tarball, void *data)
+{
+  struct tarball_file_writer *w = data;
+
+  compress_filter(w->params, fd_tarball, w->fd_out,
+                  _("compressing tar member"));
+}
+
+/**
+ * Tarball writer compressing into its final position in the archive,
+ * buffering the output until the preceding members have been written.
+ */
+struct tarball_member_writer {
+  struct compress_params *params;
+  struct dpkg_ar *ar;
+  /** The member name, or NULL when no ar member header is needed. */
+  const char *name;
+  /** Reaches end of file when the preceding members have been written. */
+  int fd_gate;
+};
+
+static bool
+tarball_read_gate(int fd_gate)
+{
+  char c;
+  ssize_t n;
+
+  n = read(fd_gate, &c, 1);
+  if (n < 0 && errno != EINTR)
+    ohshite(_("failed to wait for the %s"), _("control member"));
+
+  return n == 0;
+}
+
+static void
+tarball_wait_gate(int fd_gate)
+{
+  while (!tarball_read_gate(fd_gate))
+    ;
+  close(fd_gate);
+}
+
+static int
+tarball_make_tmpfile(const char *desc)
+{
+  char *tfbuf;
+  int fd_tmp;
+
+  tfbuf = path_make_temp_template("dpkg-deb");
+  fd_tmp = mkstemp(tfbuf);
+  if (fd_tmp == -1)
+    ohshite(_("failed to make temporary file (%s)"), desc);
+  /* Make sure it's gone, the fd will remain until we close it. */
+  if (unlink(tfbuf))
+    ohshit(_("failed to unlink temporary file (%s), %s"), desc, tfbuf);
+  free(tfbuf);
+
+  return fd_tmp;
+}
+
+/* The amount of compressed data to keep in memory while waiting for the
+ * control member, before spilling it into a temporary file. */
+#define TARBALL_GATE_BUFFER_MAX (4 * 1024 * 1024)
+
+/*
+ * Collect the compressed data into a buffer until the gate gets closed,
+ * so that the compressor does not stall waiting for the control member.
+ * Past TARBALL_GATE_BUFFER_MAX the data goes into a temporary file instead,
+ * which is returned in fd_spill, or -1 if none was needed.
+ *
+ * Returns true if the compressor output has already reached end of file.
+ */
+static bool
+tarball_buffer_gate(int fd_gate, int fd_in, struct varbuf *buf, int *fd_spill)
+{
+  struct pollfd fds[2];
+  bool eof = false;
+
+  *fd_spill = -1;
+
+  fds[0].fd = fd_gate;
+  fds[0].events = POLLIN;
+  fds[1].fd = fd_in;
+  fds[1].events = POLLIN;
+
+  for (;;) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      ohshite(_("failed to wait for the %s"), _("control member"));
+    }
+
+    if (fds[1].revents) {
+      char chunk[8192];
+      ssize_t n;
+
+      n = read(fd_in, chunk, sizeof(chunk));
+      if (n < 0 && errno != EINTR)
+        ohshite(_("failed to read from the %s"), _("data member"));
+      if (n == 0) {
+        /* Stop polling for the compressor output. */
+        fds[1].fd = -1;
+        eof = true;
+      } else if (n > 0) {
+        if (*fd_spill < 0 && buf->used + n > TARBALL_GATE_BUFFER_MAX) {
+          *fd_spill = tarball_make_tmpfile(_("data member"));
+          if (fd_write(*fd_spill, buf->buf, buf->used) < 0)
+            ohshite(_("failed to write temporary file (%s)"),
+                    _("data member"));
+          varbuf_destroy(buf);
+        }
+
+        if (*fd_spill < 0)
+          varbuf_add_buf(buf, chunk, n);
+        else if (fd_write(*fd_spill, chunk, n) < 0)
+          ohshite(_("failed to write temporary file (%s)"), _("data member"));
+      }
+    }
+
+    if (fds[0].revents && tarball_read_gate(fd_gate))
+      break;
+  }
+  close(fd_gate);
+
+  return eof;
+}
+
+static void
+tarball_write_member_tmpfile(int fd_tarball, struct tarball_member_writer *w)
+{
+  int fd_tmp;
+
+  /* The archive cannot be patched afterwards, so go through a temporary
+   * file to know the member size beforehand. */
+  fd_tmp = tarball_make_tmpfile(_("data member"));
+
+  /* The compressor closes its output, so give it a duplicate. */
+  compress_filter(w->params, fd_tarball, m_dup(fd_tmp),
+                  _("compressing tar member"));
+
+  if (lseek(fd_tmp, 0, SEEK_SET))
+    ohshite(_("failed to rewind temporary file (%s)"), _("data member"));
+
+  tarball_wait_gate(w->fd_gate);
+
+  dpkg_ar_member_put_file(w->ar, w->name, fd_tmp, -1);
+
+  close(fd_tmp);
+}
+
+static void
+tarball_write_member_direct(int fd_tarball, struct tarball_member_writer *w)
+{
+  struct dpkg_ar_member member;
+  struct dpkg_error err;
+  struct varbuf buf = VARBUF_INIT;
+  int pipe_comp[2];
+  int fd_spill;
+  pid_t pid_comp;
+  bool eof;
+
+  m_pipe(pipe_comp);
+  pid_comp = subproc_fork();
+  if (pid_comp == 0) {
+    close(pipe_comp[0]);
+    close(w->fd_gate);
+    compress_filter(w->params, fd_tarball, pipe_comp[1],
+                    _("compressing tar member"));
+    exit(0);
+  }
+  close(pipe_comp[1]);
+  close(fd_tarball);
+
+  /* Keep the compressor going while the control member is being built,
+   * and only then start writing the data member into the archive. */
+  eof = tarball_buffer_gate(w->fd_gate, pipe_comp[0], &buf, &fd_spill);
+
+  if (w->name)
+    dpkg_ar_member_begin(w->ar, &member, w->name);
+
+  if (fd_spill >= 0) {
+    if (lseek(fd_spill, 0, SEEK_SET))
+      ohshite(_("failed to rewind temporary file (%s)"), _("data member"));
+    if (fd_fd_copy(fd_spill, w->ar->fd, -1, &err) < 0)
+      ohshit(_("cannot copy '%s' into archive '%s': %s"), _("data member"),
+             w->ar->name, err.str);
+    close(fd_spill);
+  }
+
+  if (fd_write(w->ar->fd, buf.buf, buf.used) < 0)
+    ohshite(_("error writing '%s'"), w->ar->name);
+  varbuf_destroy(&buf);
+
+  if (!eof && fd_fd_copy(pipe_comp[0], w->ar->fd, -1, &err) < 0)
+    ohshit(_("cannot copy '%s' into archive '%s': %s"), _("data member"),
+           w->ar->name, err.str);
+  close(pipe_comp[0]);
+
+  subproc_reap(pid_comp, _("<compress> from tar -cf"), 0);
+
+  if (w->name)
+    dpkg_ar_member_end(w->ar, &member);
+}
+
+static void
+tarball_write_member(int fd_tarball, void *data)
+{
+  struct tarball_member_writer *w = data;
+
+  if (w->name && lseek(w->ar->fd, 0, SEEK_CUR) < 0 && errno == ESPIPE)
+    tarball_write_member_tmpfile(fd_tarball, w);
+  else
+    tarball_write_member_direct(fd_tarball, w);
+}
+
 static time_t
 parse_timestamp(const char *value)
 {
@@ -503,32 +858,121 @@ parse_timestamp(const char *value)
   return timestamp;
 }
 
+/**
+ * Build the control member, and append it to the archive.
+ */
+static void
+build_control_member(struct dpkg_ar *ar, const char *ctrldir, time_t timestamp,
+                     struct compress_params *control_compress_params)
+{
+  struct tarball_file_writer control_writer;
+  struct tar_pack_options tar_options;
+  struct dpkg_error err;
+  char *tfbuf;
+  int gzfd;
+
+  /* Create a temporary file to store the control data in. Immediately
+   * unlink our temporary file so others can't mess with it. */
+  tfbuf = path_make_temp_template("dpkg-deb");
+  gzfd = mkstemp(tfbuf);
+  if (gzfd == -1)
+    ohshite(_("failed to make temporary file (%s)"), _("control member"));
+  /* Make sure it's gone, the fd will remain until we close it. */
+  if (unlink(tfbuf))
+    ohshit(_("failed to unlink temporary file (%s), %s"), _("control member"),
+           tfbuf);
+  free(tfbuf);
+
+  /* Fork a tar to package the control-section of the package. */
+  control_writer.params = control_compress_params;
+  control_writer.fd_out = gzfd;
+
+  tar_options.mode = "u+rw,go=rX";
+  tar_options.timestamp = timestamp;
+  tar_options.root_owner_group = true;
+  tarball_pack(ctrldir, control_treewalk_feed, &tar_options,
+               tarball_write_file, &control_writer);
+
+  if (lseek(gzfd, 0, SEEK_SET))
+    ohshite(_("failed to rewind temporary file (%s)"), _("control member"));
+
+  /* We have our first file for the ar-archive. Write a header for it
+   * to the package and insert it. */
+  if (deb_format.major == 0) {
+    struct stat controlstab;
+    char versionbuf[40];
+
+    if (fstat(gzfd, &controlstab))
+      ohshite(_("failed to stat temporary file (%s)"), _("control member"));
+    sprintf(versionbuf, "%-8s\n%jd\n", OLDARCHIVEVERSION,
+            (intmax_t)controlstab.st_size);
+    if (fd_write(ar->fd, versionbuf, strlen(versionbuf)) < 0)
+      ohshite(_("error writing '%s'"), ar->name);
+    if (fd_fd_copy(gzfd, ar->fd, -1, &err) < 0)
+      ohshit(_("cannot copy '%s' into archive '%s': %s"), _("control member"),
+             ar->name, err.str);
+  } else if (deb_format.major == 2) {
+    char adminmember[16 + 1];
+
+    sprintf(adminmember, "%s%s", ADMINMEMBER,
+            compressor_get_extension(control_compress_params->type));
+
+    dpkg_ar_member_put_file(ar, adminmember, gzfd, -1);
+  } else {
+    internerr("unknown deb format version %d.%d", deb_format.major, deb_format.minor);
+  }
+
+  close(gzfd);
+}
+
+static double
+build_elapsed(struct timespec *start)
+{
+  struct timespec now;
+  double elapsed;
+
+  dpkg_clock_get_monotonic(&now);
+  elapsed = dpkg_clock_elapsed(start, &now);
+
+  /* Restart the clock, so that consecutive phases can be timed. */
+  *start = now;
+
+  return elapsed;
+}
+
+/**
+ * Time spent in each of the phases of a package build.
+ */
+struct build_times {
+  double check;
+  double pack;
+};
+
 /**
  * Overly complex function that builds a .deb file.
+ *
+ * @param dir   The directory from where to build the binary package.
+ * @param dest  The destination name, either a file or directory name.
+ * @param times Where to store the time spent on each phase, or NULL.
  */
-int
-do_build(const char *const *argv)
+static void
+build_package(const char *dir, const char *dest, struct build_times *times)
 {
   struct compress_params control_compress_params;
+  struct tarball_member_writer data_writer;
   struct tar_pack_options tar_options;
   struct dpkg_error err;
   struct dpkg_ar *ar;
+  struct timespec clock;
   time_t timestamp;
   const char *timestamp_str;
-  const char *dir, *dest;
+  char datamember[16 + 1];
   char *ctrldir;
   char *debar;
-  char *tfbuf;
-  int gzfd;
+  int pipe_gate[2];
+  pid_t pid_control;
 
-  /* Decode our arguments. */
-  dir = *argv++;
-  if (!dir)
-    badusage(_("--%s needs a <directory> argument"), cipaction->olong);
-
-  dest = *argv++;
-  if (dest && *argv)
-    badusage(_("--%s takes at most two arguments"), cipaction->olong);
+  dpkg_clock_get_monotonic(&clock);
 
   debar = gen_dest_pathname(dir, dest);
   ctrldir = str_fmt("%s/%s", dir, BUILDCONTROLDIR);
@@ -549,6 +993,9 @@ do_build(const char *const *argv)
   }
   m_output(stdout, _("<standard output>"));
 
+  if (times)
+    times->check = build_elapsed(&clock);
+
   timestamp_str = getenv("SOURCE_DATE_EPOCH");
   if (timestamp_str)
     timestamp = parse_timestamp(timestamp_str);
@@ -563,18 +1010,6 @@ do_build(const char *const *argv)
 
   unsetenv("TAR_OPTIONS");
 
-  /* Create a temporary file to store the control data in. Immediately
-   * unlink our temporary file so others can't mess with it. */
-  tfbuf = path_make_temp_template("dpkg-deb");
-  gzfd = mkstemp(tfbuf);
-  if (gzfd == -1)
-    ohshite(_("failed to make temporary file (%s)"), _("control member"));
-  /* Make sure it's gone, the fd will remain until we close it. */
-  if (unlink(tfbuf))
-    ohshit(_("failed to unlink temporary file (%s), %s"), _("control member"),
-           tfbuf);
-  free(tfbuf);
-
   /* Select the compressor to use for our control archive. */
   if (opt_uniform_compression) {
     control_compress_params = compress_params;
@@ -586,97 +1021,250 @@ do_build(const char *const *argv)
       internerr("invalid control member compressor params: %s", err.str);
   }
 
-  /* Fork a tar to package the control-section of the package. */
-  tar_options.mode = "u+rw,go=rX";
-  tar_options.timestamp = timestamp;
-  tar_options.root_owner_group = true;
-  tarball_pack(ctrldir, control_treewalk_feed, &tar_options,
-               &control_compress_params, gzfd);
-
-  free(ctrldir);
-
-  if (lseek(gzfd, 0, SEEK_SET))
-    ohshite(_("failed to rewind temporary file (%s)"), _("control member"));
-
-  /* We have our first file for the ar-archive. Write a header for it
-   * to the package and insert it. */
   if (deb_format.major == 0) {
-    struct stat controlstab;
-    char versionbuf[40];
-
-    if (fstat(gzfd, &controlstab))
-      ohshite(_("failed to stat temporary file (%s)"), _("control member"));
-    sprintf(versionbuf, "%-8s\n%jd\n", OLDARCHIVEVERSION,
-            (intmax_t)controlstab.st_size);
-    if (fd_write(ar->fd, versionbuf, strlen(versionbuf)) < 0)
-      ohshite(_("error writing '%s'"), debar);
-    if (fd_fd_copy(gzfd, ar->fd, -1, &err) < 0)
-      ohshit(_("cannot copy '%s' into archive '%s': %s"), _("control member"),
-             ar->name, err.str);
+    /* In old format, the data member is just concatenated after the
+     * control member. */
+    data_writer.name = NULL;
   } else if (deb_format.major == 2) {
     const char deb_magic[] = ARCHIVEVERSION "\n";
-    char adminmember[16 + 1];
-
-    sprintf(adminmember, "%s%s", ADMINMEMBER,
-            compressor_get_extension(control_compress_params.type));
 
     dpkg_ar_put_magic(ar);
     dpkg_ar_member_put_mem(ar, DEBMAGIC, deb_magic, strlen(deb_magic));
-    dpkg_ar_member_put_file(ar, adminmember, gzfd, -1);
+
+    sprintf(datamember, "%s%s", DATAMEMBER,
+            compressor_get_extension(compress_params.type));
+    data_writer.name = datamember;
   } else {
     internerr("unknown deb format version %d.%d", deb_format.major, deb_format.minor);
   }
 
-  close(gzfd);
-
-  /* Control is done, now we need to archive the data. */
-  if (deb_format.major == 0) {
-    /* In old format, the data member is just concatenated after the
-     * control member, so we do not need a temporary file and can use
-     * the compression file descriptor. */
-    gzfd = ar->fd;
-  } else if (deb_format.major == 2) {
-    /* Start by creating a new temporary file. Immediately unlink the
-     * temporary file so others can't mess with it. */
-    tfbuf = path_make_temp_template("dpkg-deb");
-    gzfd = mkstemp(tfbuf);
-    if (gzfd == -1)
-      ohshite(_("failed to make temporary file (%s)"), _("data member"));
-    /* Make sure it's gone, the fd will remain until we close it. */
-    if (unlink(tfbuf))
-      ohshit(_("failed to unlink temporary file (%s), %s"), _("data member"),
-             tfbuf);
-    free(tfbuf);
-  } else {
-    internerr("unknown deb format version %d.%d", deb_format.major, deb_format.minor);
+  /* The control and data members are built concurrently. The control
+   * member is built by a subprocess into a temporary file, and appended
+   * to the archive, while the data tree gets packed and compressed. The
+   * compressed data is buffered until the control member is in the
+   * archive, which is signaled by the gate pipe getting closed, and from
+   * then on it gets written directly into its final position. */
+  m_pipe(pipe_gate);
+
+  pid_control = subproc_fork();
+  if (pid_control == 0) {
+    close(pipe_gate[0]);
+    build_control_member(ar, ctrldir, timestamp, &control_compress_params);
+    exit(0);
   }
+  close(pipe_gate[1]);
+
+  free(ctrldir);
 
   /* Pack the directory into a tarball, feeding files from the callback. */
+  data_writer.params = &compress_params;
+  data_writer.ar = ar;
+  data_writer.fd_gate = pipe_gate[0];
+
   tar_options.mode = NULL;
   tar_options.timestamp = timestamp;
   tar_options.root_owner_group = opt_root_owner_group;
-  tarball_pack(dir, file_treewalk_feed, &tar_options, &compress_params, gzfd);
-
-  /* Okay, we have data.tar as well now, add it to the ar wrapper. */
-  if (deb_format.major == 2) {
-    char datamember[16 + 1];
-
-    sprintf(datamember, "%s%s", DATAMEMBER,
-            compressor_get_extension(compress_params.type));
-
-    if (lseek(gzfd, 0, SEEK_SET))
-      ohshite(_("failed to rewind temporary file (%s)"), _("data member"));
+  tarball_pack(dir, file_treewalk_feed, &tar_options,
+               tarball_write_member, &data_writer);
+  close(pipe_gate[0]);
 
-    dpkg_ar_member_put_file(ar, datamember, gzfd, -1);
+  subproc_reap(pid_control, _("control member"), 0);
 
-    close(gzfd);
-  }
   if (fsync(ar->fd))
     ohshite(_("unable to sync file '%s'"), ar->name);
 
   dpkg_ar_close(ar);
 
+  if (times)
+    times->pack = build_elapsed(&clock);
+
   free(debar);
+}
+
+int
+do_build(const char *const *argv)
+{
+  const char *dir, *dest;
+
+  /* Decode our arguments. */
+  dir = *argv++;
+  if (!dir)
+    badusage(_("--%s needs a <directory> argument"), cipaction->olong);
+
+  dest = *argv++;
+  if (dest && *argv)
+    badusage(_("--%s takes at most two arguments"), cipaction->olong);
+
+  build_package(dir, dest, NULL);
+
+  return 0;
+}
+
+/**
+ * A package build scheduled by --build-many.
+ */
+struct build_job {
+  char *dir;
+  char *dest;
+  pid_t pid;
+};
+
+static struct build_job *
+build_jobs_load(const char *listfile, int *njobs)
+{
+  struct build_job *jobs = NULL;
+  struct varbuf line = VARBUF_INIT;
+  int nalloc = 0;
+  int lineno = 0;
+  FILE *fp;
+  int c;
+
+  if (strcmp(listfile, "-") == 0)
+    fp = stdin;
+  else
+    fp = fopen(listfile, "r");
+  if (fp == NULL)
+    ohshite(_("cannot open build list '%s'"), listfile);
+
+  *njobs = 0;
+  do {
+    struct build_job *job;
+    char *dir, *dest, *extra;
+
+    varbuf_reset(&line);
+    while ((c = getc(fp)) != EOF && c != '\n')
+      varbuf_add_char(&line, c);
+    varbuf_end_str(&line);
+    lineno++;
+
+    dir = strtok(line.buf, " \t");
+    if (dir == NULL || dir[0] == '#')
+      continue;
+    dest = strtok(NULL, " \t");
+    extra = strtok(NULL, " \t");
+    if (extra)
+      ohshit(_("build list '%s' line %d has more than two fields"),
+             listfile, lineno);
+
+    if (*njobs == nalloc) {
+      nalloc = nalloc ? nalloc * 2 : 32;
+      jobs = m_realloc(jobs, nalloc * sizeof(*jobs));
+    }
+    job = &jobs[(*njobs)++];
+    job->dir = m_strdup(dir);
+    job->dest = dest ? m_strdup(dest) : NULL;
+    job->pid = -1;
+  } while (c != EOF);
+
+  if (ferror(fp))
+    ohshite(_("error reading build list '%s'"), listfile);
+  if (fp != stdin)
+    fclose(fp);
+  varbuf_destroy(&line);
+
+  return jobs;
+}
+
+static void
+build_job_start(struct build_job *job)
+{
+  job->pid = subproc_fork();
+  if (job->pid == 0) {
+    struct build_times times;
+
+    build_package(job->dir, job->dest, &times);
+
+    info(_("built '%s' in %.3fs (checks %.3fs, packing %.3fs)."),
+         job->dir, times.check + times.pack, times.check, times.pack);
+    m_output(stdout, _("<standard output>"));
+
+    exit(0);
+  }
+}
+
+static struct build_job *
+build_job_find(struct build_job *jobs, int njobs, pid_t pid)
+{
+  int i;
+
+  for (i = 0; i < njobs; i++)
+    if (jobs[i].pid == pid)
+      return &jobs[i];
+
+  return NULL;
+}
+
+/**
+ * Build many packages, running up to opt_jobs builds concurrently.
+ */
+int
+do_build_many(const char *const *argv)
+{
+  struct build_job *jobs;
+  struct timespec clock;
+  const char *listfile;
+  int njobs, nstarted, nrunning, nfailed;
+  int i;
+
+  listfile = *argv++;
+  if (!listfile)
+    badusage(_("--%s needs a <list-file> argument"), cipaction->olong);
+  if (*argv)
+    badusage(_("--%s takes only one argument"), cipaction->olong);
+
+  jobs = build_jobs_load(listfile, &njobs);
+
+  if (opt_jobs <= 0) {
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    opt_jobs = ncpus > 0 ? ncpus : 1;
+  }
+
+  dpkg_clock_get_monotonic(&clock);
+
+  /* Make sure no buffered output gets duplicated into the children. */
+  m_output(stdout, _("<standard output>"));
+
+  nstarted = nrunning = nfailed = 0;
+  while (nstarted < njobs || nrunning > 0) {
+    struct build_job *job;
+    pid_t pid;
+    int status;
+
+    while (nrunning < opt_jobs && nstarted < njobs) {
+      build_job_start(&jobs[nstarted++]);
+      nrunning++;
+    }
+
+    pid = waitpid(-1, &status, 0);
+    if (pid < 0) {
+      if (errno == EINTR)
+        continue;
+      ohshite(_("wait for build subprocess failed"));
+    }
+
+    job = build_job_find(jobs, nstarted, pid);
+    if (job == NULL)
+      continue;
+    nrunning--;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      warning(_("failed to build package from '%s'"), job->dir);
+      nfailed++;
+    }
+  }
+
+  info(_("built %d of %d packages in %.3fs using %d jobs."),
+       njobs - nfailed, njobs, build_elapsed(&clock), opt_jobs);
+
+  for (i = 0; i < njobs; i++) {
+    free(jobs[i].dir);
+    free(jobs[i].dest);
+  }
+  free(jobs);
+
+  if (nfailed)
+    ohshit(_("%d of %d packages failed to build"), nfailed, njobs);
 
   return 0;
 }
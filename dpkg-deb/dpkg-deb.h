@@ -25,6 +25,7 @@
 #include <dpkg/deb-version.h>
 
 action_func do_build;
+action_func do_build_many;
 action_func do_contents;
 action_func do_control;
 action_func do_showinfo;
@@ -39,6 +40,7 @@ action_func do_fsystarfile;
 extern int opt_verbose;
 extern int opt_root_owner_group;
 extern int opt_uniform_compression;
+extern int opt_jobs;
 extern int debugflag, nocheckflag;
 
 extern struct deb_version deb_format;
@@ -71,6 +71,7 @@ usage(const struct cmdinfo *cip, const char *value)
   printf(_(
 "Commands:\n"
 "  -b|--build <directory> [<deb>]   Build an archive.\n"
+"  --build-many <list-file>         Build the archives listed in <list-file>.\n"
 "  -c|--contents <deb>              List contents.\n"
 "  -I|--info <deb> [<cfile> ...]    Show info to stdout.\n"
 "  -W|--show <deb>                  Show information on package(s)\n"
@@ -106,6 +107,8 @@ usage(const struct cmdinfo *cip, const char *value)
 "                                     packages).\n"
 "      --root-owner-group           Forces the owner and groups to root.\n"
 "      --[no-]uniform-compression   Use the compression params on all members.\n"
+"      --jobs=<n>                   Build up to <n> packages concurrently with\n"
+"                                     --build-many (default: online CPUs).\n"
 "  -z#                              Set the compression level when building.\n"
 "  -Z<type>                         Set the compression type used when building.\n"
 "                                     Allowed types: gzip, xz, none.\n"
@@ -143,6 +146,7 @@ int nocheckflag = 0;
 int opt_verbose = 0;
 int opt_root_owner_group = 0;
 int opt_uniform_compression = 1;
+int opt_jobs = 0;
 
 struct deb_version deb_format = DEB_VERSION(2, 0);
 
@@ -200,8 +204,21 @@ set_compress_type(const struct cmdinfo *cip, const char *value)
     badusage(_("obsolete compression type '%s'; use xz or gzip instead"), value);
 }
 
+static void
+set_jobs(const struct cmdinfo *cip, const char *value)
+{
+  long jobs;
+
+  jobs = dpkg_options_parse_arg_int(cip, value);
+  if (jobs < 1)
+    badusage(_("invalid number of jobs for --%s: %ld"), cip->olong, jobs);
+
+  opt_jobs = jobs;
+}
+
 static const struct cmdinfo cmdinfos[]= {
   ACTION("build",         'b', 0, do_build),
+  ACTION("build-many",    0,   0, do_build_many),
   ACTION("contents",      'c', 0, do_contents),
   ACTION("control",       'e', 0, do_control),
   ACTION("info",          'I', 0, do_info),
@@ -220,6 +237,7 @@ static const struct cmdinfo cmdinfos[]= {
   { "root-owner-group",    0, 0, &opt_root_owner_group,    NULL, NULL,    1 },
   { "uniform-compression", 0, 0, &opt_uniform_compression, NULL, NULL,    1 },
   { "no-uniform-compression", 0, 0, &opt_uniform_compression, NULL, NULL, 0 },
+  { "jobs",          0,   1, NULL,           NULL,         set_jobs         },
   { NULL,            'z', 1, NULL,           NULL,         set_compress_level },
   { NULL,            'Z', 1, NULL,           NULL,         set_compress_type  },
   { NULL,            'S', 1, NULL,           NULL,         set_compress_strategy },
@@ -0,0 +1,187 @@
+/*
+ * libcompat - system compatibility library
+ * sha1.c - SHA-1 message digest algorithm
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This implements the SHA-1 algorithm as specified in FIPS 180-4, with
+ * the same interface as the one provided by libmd.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <string.h>
+
+#include "sha1.h"
+
+#define PUT_64BIT_BE(cp, value) do {					\
+	(cp)[0] = (value) >> 56;					\
+	(cp)[1] = (value) >> 48;					\
+	(cp)[2] = (value) >> 40;					\
+	(cp)[3] = (value) >> 32;					\
+	(cp)[4] = (value) >> 24;					\
+	(cp)[5] = (value) >> 16;					\
+	(cp)[6] = (value) >> 8;						\
+	(cp)[7] = (value); } while (0)
+
+#define PUT_32BIT_BE(cp, value) do {					\
+	(cp)[0] = (value) >> 24;					\
+	(cp)[1] = (value) >> 16;					\
+	(cp)[2] = (value) >> 8;						\
+	(cp)[3] = (value); } while (0)
+
+#define GET_32BIT_BE(cp) (						\
+	(uint32_t)(cp)[0] << 24 |					\
+	(uint32_t)(cp)[1] << 16 |					\
+	(uint32_t)(cp)[2] << 8 |					\
+	(uint32_t)(cp)[3])
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static uint8_t PADDING[SHA1_BLOCK_LENGTH] = {
+	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+void
+SHA1Init(SHA1_CTX *ctx)
+{
+	ctx->count = 0;
+	ctx->state[0] = 0x67452301;
+	ctx->state[1] = 0xefcdab89;
+	ctx->state[2] = 0x98badcfe;
+	ctx->state[3] = 0x10325476;
+	ctx->state[4] = 0xc3d2e1f0;
+}
+
+void
+SHA1Update(SHA1_CTX *ctx, const uint8_t *input, size_t len)
+{
+	size_t have, need;
+
+	/* Check how many bytes we already have and how many more we need. */
+	have = (size_t)((ctx->count >> 3) & (SHA1_BLOCK_LENGTH - 1));
+	need = SHA1_BLOCK_LENGTH - have;
+
+	/* Update bitcount */
+	ctx->count += (uint64_t)len << 3;
+
+	if (len >= need) {
+		if (have != 0) {
+			memcpy(ctx->buffer + have, input, need);
+			SHA1Transform(ctx->state, ctx->buffer);
+			input += need;
+			len -= need;
+			have = 0;
+		}
+
+		/* Process data in SHA1_BLOCK_LENGTH-byte chunks. */
+		while (len >= SHA1_BLOCK_LENGTH) {
+			SHA1Transform(ctx->state, input);
+			input += SHA1_BLOCK_LENGTH;
+			len -= SHA1_BLOCK_LENGTH;
+		}
+	}
+
+	/* Handle any remaining bytes of data. */
+	if (len != 0)
+		memcpy(ctx->buffer + have, input, len);
+}
+
+/*
+ * Pad to 64-byte boundary with the bit pattern
+ * 1 0* (64-bit count of bits processed, MSB-first)
+ */
+void
+SHA1Pad(SHA1_CTX *ctx)
+{
+	uint8_t count[8];
+	size_t padlen;
+
+	/* Convert count to 8 bytes in big endian order. */
+	PUT_64BIT_BE(count, ctx->count);
+
+	/* Pad out to 56 mod 64. */
+	padlen = SHA1_BLOCK_LENGTH -
+	    ((ctx->count >> 3) & (SHA1_BLOCK_LENGTH - 1));
+	if (padlen < 1 + 8)
+		padlen += SHA1_BLOCK_LENGTH;
+	SHA1Update(ctx, PADDING, padlen - 8);		/* padlen - 8 <= 64 */
+	SHA1Update(ctx, count, 8);
+}
+
+void
+SHA1Final(uint8_t digest[SHA1_DIGEST_LENGTH], SHA1_CTX *ctx)
+{
+	int i;
+
+	SHA1Pad(ctx);
+	if (digest != NULL) {
+		for (i = 0; i < 5; i++)
+			PUT_32BIT_BE(digest + i * 4, ctx->state[i]);
+		memset(ctx, 0, sizeof(*ctx));
+	}
+}
+
+void
+SHA1Transform(uint32_t state[5], const uint8_t block[SHA1_BLOCK_LENGTH])
+{
+	uint32_t a, b, c, d, e, f, k, t, w[80];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = GET_32BIT_BE(block + i * 4);
+	for (i = 16; i < 80; i++)
+		w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+
+	for (i = 0; i < 80; i++) {
+		if (i < 20) {
+			f = d ^ (b & (c ^ d));
+			k = 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (d & (b | c));
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+
+		t = ROL(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = ROL(b, 30);
+		b = a;
+		a = t;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
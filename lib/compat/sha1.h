@@ -0,0 +1,41 @@
+/*
+ * libcompat - system compatibility library
+ * sha1.h - SHA-1 message digest algorithm
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SHA1_H_
+#define _SHA1_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define	SHA1_BLOCK_LENGTH		64
+#define	SHA1_DIGEST_LENGTH		20
+#define	SHA1_DIGEST_STRING_LENGTH	(SHA1_DIGEST_LENGTH * 2 + 1)
+
+typedef struct SHA1Context {
+	uint32_t state[5];			/* state */
+	uint64_t count;			/* number of bits, mod 2^64 */
+	uint8_t buffer[SHA1_BLOCK_LENGTH];	/* input buffer */
+} SHA1_CTX;
+
+void	 SHA1Init(SHA1_CTX *);
+void	 SHA1Update(SHA1_CTX *, const uint8_t *, size_t);
+void	 SHA1Pad(SHA1_CTX *);
+void	 SHA1Final(uint8_t [SHA1_DIGEST_LENGTH], SHA1_CTX *);
+void	 SHA1Transform(uint32_t [5], const uint8_t [SHA1_BLOCK_LENGTH]);
+
+#endif /* _SHA1_H_ */
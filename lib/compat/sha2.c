@@ -0,0 +1,212 @@
+/*
+ * libcompat - system compatibility library
+ * sha2.c - SHA-256 message digest algorithm
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This implements the SHA-256 algorithm as specified in FIPS 180-4, with
+ * the same interface as the one provided by libmd.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <string.h>
+
+#include "sha2.h"
+
+#define PUT_64BIT_BE(cp, value) do {					\
+	(cp)[0] = (value) >> 56;					\
+	(cp)[1] = (value) >> 48;					\
+	(cp)[2] = (value) >> 40;					\
+	(cp)[3] = (value) >> 32;					\
+	(cp)[4] = (value) >> 24;					\
+	(cp)[5] = (value) >> 16;					\
+	(cp)[6] = (value) >> 8;						\
+	(cp)[7] = (value); } while (0)
+
+#define PUT_32BIT_BE(cp, value) do {					\
+	(cp)[0] = (value) >> 24;					\
+	(cp)[1] = (value) >> 16;					\
+	(cp)[2] = (value) >> 8;						\
+	(cp)[3] = (value); } while (0)
+
+#define GET_32BIT_BE(cp) (						\
+	(uint32_t)(cp)[0] << 24 |					\
+	(uint32_t)(cp)[1] << 16 |					\
+	(uint32_t)(cp)[2] << 8 |					\
+	(uint32_t)(cp)[3])
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define CH(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define MAJ(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define SIGMA0(x)	(ROR((x), 2) ^ ROR((x), 13) ^ ROR((x), 22))
+#define SIGMA1(x)	(ROR((x), 6) ^ ROR((x), 11) ^ ROR((x), 25))
+#define sigma0(x)	(ROR((x), 7) ^ ROR((x), 18) ^ ((x) >> 3))
+#define sigma1(x)	(ROR((x), 17) ^ ROR((x), 19) ^ ((x) >> 10))
+
+static const uint32_t K256[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static uint8_t PADDING[SHA256_BLOCK_LENGTH] = {
+	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+void
+SHA256Init(SHA2_CTX *ctx)
+{
+	ctx->count = 0;
+	ctx->state[0] = 0x6a09e667;
+	ctx->state[1] = 0xbb67ae85;
+	ctx->state[2] = 0x3c6ef372;
+	ctx->state[3] = 0xa54ff53a;
+	ctx->state[4] = 0x510e527f;
+	ctx->state[5] = 0x9b05688c;
+	ctx->state[6] = 0x1f83d9ab;
+	ctx->state[7] = 0x5be0cd19;
+}
+
+void
+SHA256Update(SHA2_CTX *ctx, const uint8_t *input, size_t len)
+{
+	size_t have, need;
+
+	/* Check how many bytes we already have and how many more we need. */
+	have = (size_t)((ctx->count >> 3) & (SHA256_BLOCK_LENGTH - 1));
+	need = SHA256_BLOCK_LENGTH - have;
+
+	/* Update bitcount */
+	ctx->count += (uint64_t)len << 3;
+
+	if (len >= need) {
+		if (have != 0) {
+			memcpy(ctx->buffer + have, input, need);
+			SHA256Transform(ctx->state, ctx->buffer);
+			input += need;
+			len -= need;
+			have = 0;
+		}
+
+		/* Process data in SHA256_BLOCK_LENGTH-byte chunks. */
+		while (len >= SHA256_BLOCK_LENGTH) {
+			SHA256Transform(ctx->state, input);
+			input += SHA256_BLOCK_LENGTH;
+			len -= SHA256_BLOCK_LENGTH;
+		}
+	}
+
+	/* Handle any remaining bytes of data. */
+	if (len != 0)
+		memcpy(ctx->buffer + have, input, len);
+}
+
+/*
+ * Pad to 64-byte boundary with the bit pattern
+ * 1 0* (64-bit count of bits processed, MSB-first)
+ */
+void
+SHA256Pad(SHA2_CTX *ctx)
+{
+	uint8_t count[8];
+	size_t padlen;
+
+	/* Convert count to 8 bytes in big endian order. */
+	PUT_64BIT_BE(count, ctx->count);
+
+	/* Pad out to 56 mod 64. */
+	padlen = SHA256_BLOCK_LENGTH -
+	    ((ctx->count >> 3) & (SHA256_BLOCK_LENGTH - 1));
+	if (padlen < 1 + 8)
+		padlen += SHA256_BLOCK_LENGTH;
+	SHA256Update(ctx, PADDING, padlen - 8);		/* padlen - 8 <= 64 */
+	SHA256Update(ctx, count, 8);
+}
+
+void
+SHA256Final(uint8_t digest[SHA256_DIGEST_LENGTH], SHA2_CTX *ctx)
+{
+	int i;
+
+	SHA256Pad(ctx);
+	if (digest != NULL) {
+		for (i = 0; i < 8; i++)
+			PUT_32BIT_BE(digest + i * 4, ctx->state[i]);
+		memset(ctx, 0, sizeof(*ctx));
+	}
+}
+
+void
+SHA256Transform(uint32_t state[8], const uint8_t block[SHA256_BLOCK_LENGTH])
+{
+	uint32_t a, b, c, d, e, f, g, h, t1, t2, w[64];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = GET_32BIT_BE(block + i * 4);
+	for (i = 16; i < 64; i++)
+		w[i] = sigma1(w[i - 2]) + w[i - 7] + sigma0(w[i - 15]) + w[i - 16];
+
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
+
+	for (i = 0; i < 64; i++) {
+		t1 = h + SIGMA1(e) + CH(e, f, g) + K256[i] + w[i];
+		t2 = SIGMA0(a) + MAJ(a, b, c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
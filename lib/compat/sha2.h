@@ -0,0 +1,42 @@
+/*
+ * libcompat - system compatibility library
+ * sha2.h - SHA-256 message digest algorithm
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SHA2_H_
+#define _SHA2_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define	SHA256_BLOCK_LENGTH		64
+#define	SHA256_DIGEST_LENGTH		32
+#define	SHA256_DIGEST_STRING_LENGTH	(SHA256_DIGEST_LENGTH * 2 + 1)
+
+/* Only the SHA-256 variant is implemented, but keep the libmd type name. */
+typedef struct SHA2Context {
+	uint32_t state[8];			/* state */
+	uint64_t count;			/* number of bits, mod 2^64 */
+	uint8_t buffer[SHA256_BLOCK_LENGTH];	/* input buffer */
+} SHA2_CTX;
+
+void	 SHA256Init(SHA2_CTX *);
+void	 SHA256Update(SHA2_CTX *, const uint8_t *, size_t);
+void	 SHA256Pad(SHA2_CTX *);
+void	 SHA256Final(uint8_t [SHA256_DIGEST_LENGTH], SHA2_CTX *);
+void	 SHA256Transform(uint32_t [8], const uint8_t [SHA256_BLOCK_LENGTH]);
+
+#endif /* _SHA2_H_ */
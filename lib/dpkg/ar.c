@@ -162,10 +162,10 @@ dpkg_ar_put_magic(struct dpkg_ar *ar)
 		ohshite(_("unable to write file '%s'"), ar->name);
 }
 
-void
-dpkg_ar_member_put_header(struct dpkg_ar *ar, struct dpkg_ar_member *member)
+static void
+dpkg_ar_member_format_header(struct dpkg_ar *ar, struct dpkg_ar_member *member,
+                             char *header)
 {
-	char header[sizeof(struct dpkg_ar_hdr) + 1];
 	int n;
 
 	if (strlen(member->name) > 15)
@@ -180,11 +180,75 @@ dpkg_ar_member_put_header(struct dpkg_ar *ar, struct dpkg_ar_member *member)
 	             (unsigned long)member->mode, (intmax_t)member->size);
 	if (n != sizeof(struct dpkg_ar_hdr))
 		ohshit(_("generated corrupt ar header for '%s'"), ar->name);
+}
+
+void
+dpkg_ar_member_put_header(struct dpkg_ar *ar, struct dpkg_ar_member *member)
+{
+	char header[sizeof(struct dpkg_ar_hdr) + 1];
+
+	dpkg_ar_member_format_header(ar, member, header);
 
-	if (fd_write(ar->fd, header, n) < 0)
+	if (fd_write(ar->fd, header, sizeof(struct dpkg_ar_hdr)) < 0)
 		ohshite(_("unable to write file '%s'"), ar->name);
 }
 
+/**
+ * Start a member whose size is not known yet.
+ *
+ * A placeholder header is written at the current archive offset, and the
+ * member contents are expected to be written right after it, directly into
+ * the archive file descriptor, until dpkg_ar_member_end() gets called. The
+ * archive must be seekable.
+ *
+ * @param ar The archive.
+ * @param member The member to initialize.
+ * @param name The member name.
+ */
+void
+dpkg_ar_member_begin(struct dpkg_ar *ar, struct dpkg_ar_member *member,
+                     const char *name)
+{
+	dpkg_ar_member_init(ar, member, name, 0);
+
+	member->offset = lseek(ar->fd, 0, SEEK_CUR);
+	if (member->offset < 0)
+		ohshite(_("unable to get position in file '%s'"), ar->name);
+
+	dpkg_ar_member_put_header(ar, member);
+}
+
+/**
+ * Finish a member started with dpkg_ar_member_begin().
+ *
+ * The member size is computed from the current archive offset, and the
+ * header is rewritten in place with it, then the padding is appended.
+ *
+ * @param ar The archive.
+ * @param member The member to finish.
+ */
+void
+dpkg_ar_member_end(struct dpkg_ar *ar, struct dpkg_ar_member *member)
+{
+	char header[sizeof(struct dpkg_ar_hdr) + 1];
+	off_t end;
+
+	end = lseek(ar->fd, 0, SEEK_CUR);
+	if (end < 0)
+		ohshite(_("unable to get position in file '%s'"), ar->name);
+
+	member->size = end - member->offset - sizeof(struct dpkg_ar_hdr);
+
+	dpkg_ar_member_format_header(ar, member, header);
+	if (pwrite(ar->fd, header, sizeof(struct dpkg_ar_hdr),
+	           member->offset) != sizeof(struct dpkg_ar_hdr))
+		ohshite(_("unable to write file '%s'"), ar->name);
+
+	if (member->size & 1)
+		if (fd_write(ar->fd, "\n", 1) < 0)
+			ohshite(_("unable to write file '%s'"), ar->name);
+}
+
 void
 dpkg_ar_member_put_mem(struct dpkg_ar *ar,
                        const char *name, const void *data, size_t size)
@@ -93,6 +93,9 @@ void dpkg_ar_member_put_file(struct dpkg_ar *ar, const char *name,
                              int fd, off_t size);
 void dpkg_ar_member_put_mem(struct dpkg_ar *ar, const char *name,
                             const void *data, size_t size);
+void dpkg_ar_member_begin(struct dpkg_ar *ar, struct dpkg_ar_member *member,
+                          const char *name);
+void dpkg_ar_member_end(struct dpkg_ar *ar, struct dpkg_ar_member *member);
 off_t dpkg_ar_member_get_size(struct dpkg_ar *ar, struct dpkg_ar_hdr *arh);
 
 /** @} */
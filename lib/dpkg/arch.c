@@ -34,6 +34,7 @@
 #include <dpkg/ehandle.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/string.h>
 #include <dpkg/dir.h>
 #include <dpkg/varbuf.h>
 #include <dpkg/arch.h>
@@ -106,8 +107,37 @@ static struct dpkg_arch arch_item_native = {
 };
 static struct dpkg_arch *arch_head = &arch_item_native;
 static struct dpkg_arch *arch_builtin_tail = &arch_item_any;
+static struct dpkg_arch *arch_tail = &arch_item_any;
 static bool arch_list_dirty;
 
+/* Every Architecture field and qualifier gets looked up, so the names in
+ * the list are also indexed by hash. */
+#define ARCH_HASH_BINS 61
+
+static struct dpkg_arch *arch_hash[ARCH_HASH_BINS];
+static bool arch_hash_ready;
+
+static void
+dpkg_arch_hash_add(struct dpkg_arch *arch)
+{
+	unsigned int bin = str_fnv_hash(arch->name) % ARCH_HASH_BINS;
+
+	arch->hash_next = arch_hash[bin];
+	arch_hash[bin] = arch;
+}
+
+static void
+dpkg_arch_hash_init(void)
+{
+	struct dpkg_arch *arch;
+
+	memset(arch_hash, 0, sizeof(arch_hash));
+	for (arch = arch_head; arch; arch = arch->next)
+		dpkg_arch_hash_add(arch);
+
+	arch_hash_ready = true;
+}
+
 static struct dpkg_arch *
 dpkg_arch_new(const char *name, enum dpkg_arch_type type)
 {
@@ -135,7 +165,7 @@ dpkg_arch_new(const char *name, enum dpkg_arch_type type)
 struct dpkg_arch *
 dpkg_arch_find(const char *name)
 {
-	struct dpkg_arch *arch, *last_arch = NULL;
+	struct dpkg_arch *arch;
 	enum dpkg_arch_type type;
 
 	if (name == NULL)
@@ -143,11 +173,13 @@ dpkg_arch_find(const char *name)
 	if (name[0] == '\0')
 		return &arch_item_empty;
 
-	for (arch = arch_head; arch; arch = arch->next) {
+	if (!arch_hash_ready)
+		dpkg_arch_hash_init();
+
+	arch = arch_hash[str_fnv_hash(name) % ARCH_HASH_BINS];
+	for (; arch; arch = arch->hash_next)
 		if (strcmp(arch->name, name) == 0)
 			return arch;
-		last_arch = arch;
-	}
 
 	if (dpkg_arch_name_is_illegal(name))
 		type = DPKG_ARCH_ILLEGAL;
@@ -155,7 +187,9 @@ dpkg_arch_find(const char *name)
 		type = DPKG_ARCH_UNKNOWN;
 
 	arch = dpkg_arch_new(name, type);
-	last_arch->next = arch;
+	arch_tail->next = arch;
+	arch_tail = arch;
+	dpkg_arch_hash_add(arch);
 
 	return arch;
 }
@@ -212,6 +246,8 @@ void
 dpkg_arch_reset_list(void)
 {
 	arch_builtin_tail->next = NULL;
+	arch_tail = arch_builtin_tail;
+	arch_hash_ready = false;
 	arch_list_dirty = false;
 }
 
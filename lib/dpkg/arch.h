@@ -49,6 +49,9 @@ struct dpkg_arch {
 	struct dpkg_arch *next;
 	const char *name;
 	enum dpkg_arch_type type;
+	/* Members below are private state. */
+
+	struct dpkg_arch *hash_next;
 };
 
 const char *dpkg_arch_name_is_illegal(const char *name) DPKG_ATTR_NONNULL(1);
@@ -30,6 +30,7 @@
 
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
+#include <dpkg/dpkg-db.h>
 #include <dpkg/atomic-file.h>
 
 #define ATOMIC_FILE_NEW_EXT "-new"
@@ -68,6 +69,8 @@ atomic_file_sync(struct atomic_file *file)
 		ohshite(_("unable to write new file '%.250s'"), file->name_new);
 	if (fflush(file->fp))
 		ohshite(_("unable to flush new file '%.250s'"), file->name_new);
+	if (dpkg_db_is_sync_deferred())
+		return;
 	if (fsync(fileno(file->fp)))
 		ohshite(_("unable to sync new file '%.250s'"), file->name_new);
 }
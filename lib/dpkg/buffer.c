@@ -27,6 +27,8 @@
 
 #include <errno.h>
 #include <md5.h>
+#include <sha1.h>
+#include <sha2.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -37,30 +39,118 @@
 #include <dpkg/fdio.h>
 #include <dpkg/buffer.h>
 
-struct buffer_md5_ctx {
-	MD5_CTX ctx;
+struct buffer_hash {
+	int type;
 	char *hash;
+	union {
+		MD5_CTX md5;
+		SHA1_CTX sha1;
+		SHA2_CTX sha256;
+	} ctx;
+};
+
+struct buffer_hash_ctx {
+	struct buffer_hash hashes[3];
+	int nhashes;
 };
 
 static void
-buffer_md5_init(struct buffer_data *data)
+buffer_hash_init(struct buffer_hash_ctx *ctx, int type, char *hash)
 {
-	struct buffer_md5_ctx *ctx;
+	struct buffer_hash *h;
+
+	if (hash == NULL)
+		return;
+
+	h = &ctx->hashes[ctx->nhashes++];
+	h->type = type;
+	h->hash = hash;
+
+	switch (type) {
+	case BUFFER_DIGEST_MD5:
+		MD5Init(&h->ctx.md5);
+		break;
+	case BUFFER_DIGEST_SHA1:
+		SHA1Init(&h->ctx.sha1);
+		break;
+	case BUFFER_DIGEST_SHA256:
+		SHA256Init(&h->ctx.sha256);
+		break;
+	default:
+		internerr("unknown digest type %i", type);
+	}
+}
 
-	ctx = m_malloc(sizeof(*ctx));
-	ctx->hash = data->arg.ptr;
-	data->arg.ptr = ctx;
-	MD5Init(&ctx->ctx);
+static void
+buffer_hash_update(struct buffer_hash *h, const void *buf, off_t length)
+{
+	switch (h->type) {
+	case BUFFER_DIGEST_MD5:
+		MD5Update(&h->ctx.md5, buf, length);
+		break;
+	case BUFFER_DIGEST_SHA1:
+		SHA1Update(&h->ctx.sha1, buf, length);
+		break;
+	case BUFFER_DIGEST_SHA256:
+		SHA256Update(&h->ctx.sha256, buf, length);
+		break;
+	}
+}
+
+static void
+buffer_hash_done(struct buffer_hash *h)
+{
+	static const char hexdigits[] = "0123456789abcdef";
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	char *hash = h->hash;
+	int len = 0;
+	int i;
+
+	switch (h->type) {
+	case BUFFER_DIGEST_MD5:
+		MD5Final(digest, &h->ctx.md5);
+		len = MD5_DIGEST_LENGTH;
+		break;
+	case BUFFER_DIGEST_SHA1:
+		SHA1Final(digest, &h->ctx.sha1);
+		len = SHA1_DIGEST_LENGTH;
+		break;
+	case BUFFER_DIGEST_SHA256:
+		SHA256Final(digest, &h->ctx.sha256);
+		len = SHA256_DIGEST_LENGTH;
+		break;
+	}
+
+	for (i = 0; i < len; i++) {
+		*hash++ = hexdigits[digest[i] >> 4];
+		*hash++ = hexdigits[digest[i] & 0xf];
+	}
+	*hash = '\0';
 }
 
 static off_t
 buffer_digest_init(struct buffer_data *data)
 {
+	struct buffer_hash_ctx *ctx;
+	struct buffer_digests *digests;
+
 	switch (data->type) {
 	case BUFFER_DIGEST_NULL:
 		break;
 	case BUFFER_DIGEST_MD5:
-		buffer_md5_init(data);
+	case BUFFER_DIGEST_SHA1:
+	case BUFFER_DIGEST_SHA256:
+		ctx = m_calloc(1, sizeof(*ctx));
+		buffer_hash_init(ctx, data->type, data->arg.ptr);
+		data->arg.ptr = ctx;
+		break;
+	case BUFFER_DIGEST_MULTI:
+		digests = data->arg.ptr;
+		ctx = m_calloc(1, sizeof(*ctx));
+		buffer_hash_init(ctx, BUFFER_DIGEST_MD5, digests->md5);
+		buffer_hash_init(ctx, BUFFER_DIGEST_SHA1, digests->sha1);
+		buffer_hash_init(ctx, BUFFER_DIGEST_SHA256, digests->sha256);
+		data->arg.ptr = ctx;
 		break;
 	}
 	return 0;
@@ -69,14 +159,20 @@ buffer_digest_init(struct buffer_data *data)
 static off_t
 buffer_digest_update(struct buffer_data *digest, const void *buf, off_t length)
 {
+	struct buffer_hash_ctx *ctx;
 	off_t ret = length;
+	int i;
 
 	switch (digest->type) {
 	case BUFFER_DIGEST_NULL:
 		break;
 	case BUFFER_DIGEST_MD5:
-		MD5Update(&(((struct buffer_md5_ctx *)digest->arg.ptr)->ctx),
-		          buf, length);
+	case BUFFER_DIGEST_SHA1:
+	case BUFFER_DIGEST_SHA256:
+	case BUFFER_DIGEST_MULTI:
+		ctx = digest->arg.ptr;
+		for (i = 0; i < ctx->nhashes; i++)
+			buffer_hash_update(&ctx->hashes[i], buf, length);
 		break;
 	default:
 		internerr("unknown data type %i", digest->type);
@@ -85,33 +181,23 @@ buffer_digest_update(struct buffer_data *digest, const void *buf, off_t length)
 	return ret;
 }
 
-static void
-buffer_md5_done(struct buffer_data *data)
-{
-	struct buffer_md5_ctx *ctx;
-	unsigned char digest[16], *p = digest;
-	char *hash;
-	int i;
-
-	ctx = (struct buffer_md5_ctx *)data->arg.ptr;
-	hash = ctx->hash;
-	MD5Final(digest, &ctx->ctx);
-	for (i = 0; i < 16; ++i) {
-		sprintf(hash, "%02x", *p++);
-		hash += 2;
-	}
-	*hash = '\0';
-	free(ctx);
-}
-
 static off_t
 buffer_digest_done(struct buffer_data *data)
 {
+	struct buffer_hash_ctx *ctx;
+	int i;
+
 	switch (data->type) {
 	case BUFFER_DIGEST_NULL:
 		break;
 	case BUFFER_DIGEST_MD5:
-		buffer_md5_done(data);
+	case BUFFER_DIGEST_SHA1:
+	case BUFFER_DIGEST_SHA256:
+	case BUFFER_DIGEST_MULTI:
+		ctx = data->arg.ptr;
+		for (i = 0; i < ctx->nhashes; i++)
+			buffer_hash_done(&ctx->hashes[i]);
+		free(ctx);
 		break;
 	}
 	return 0;
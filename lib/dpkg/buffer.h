@@ -45,6 +45,9 @@ DPKG_BEGIN_DECLS
 
 #define BUFFER_DIGEST_NULL		4
 #define BUFFER_DIGEST_MD5		5
+#define BUFFER_DIGEST_SHA1		6
+#define BUFFER_DIGEST_SHA256		7
+#define BUFFER_DIGEST_MULTI		8
 
 #define BUFFER_READ_FD			0
 
@@ -56,14 +59,35 @@ struct buffer_data {
 	int type;
 };
 
+/**
+ * The digests to compute in a single pass with BUFFER_DIGEST_MULTI.
+ *
+ * Each member points to the buffer to store the hex string for that digest
+ * into, or is NULL if that digest is not wanted.
+ */
+struct buffer_digests {
+	char *md5;
+	char *sha1;
+	char *sha256;
+};
+
 # define buffer_md5(buf, hash, limit) \
 	buffer_digest(buf, hash, BUFFER_DIGEST_MD5, limit)
+# define buffer_sha1(buf, hash, limit) \
+	buffer_digest(buf, hash, BUFFER_DIGEST_SHA1, limit)
+# define buffer_sha256(buf, hash, limit) \
+	buffer_digest(buf, hash, BUFFER_DIGEST_SHA256, limit)
 
 # define fd_md5(fd, hash, limit, err) \
 	buffer_copy_IntPtr(fd, BUFFER_READ_FD, \
 	                   hash, BUFFER_DIGEST_MD5, \
 	                   NULL, BUFFER_WRITE_NULL, \
 	                   limit, err)
+# define fd_digests(fd, digests, limit, err) \
+	buffer_copy_IntPtr(fd, BUFFER_READ_FD, \
+	                   digests, BUFFER_DIGEST_MULTI, \
+	                   NULL, BUFFER_WRITE_NULL, \
+	                   limit, err)
 # define fd_fd_copy(fd1, fd2, limit, err) \
 	buffer_copy_IntInt(fd1, BUFFER_READ_FD, \
 	                   NULL, BUFFER_DIGEST_NULL, \
@@ -26,6 +26,7 @@
 #include <stdio.h>
 
 #include <dpkg/dpkg.h>
+#include <dpkg/varbuf.h>
 
 void
 cu_closepipe(int argc, void **argv)
@@ -67,3 +68,11 @@ cu_filename(int argc, void **argv)
 
 	(void)unlink(filename);
 }
+
+void
+cu_varbuf_scratch(int argc, void **argv)
+{
+	struct varbuf *vb = argv[0];
+
+	varbuf_scratch_put(vb);
+}
@@ -0,0 +1,70 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * clock.c - clock handling routines
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/time.h>
+
+#include <time.h>
+#include <unistd.h>
+
+#include <dpkg/i18n.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/clock.h>
+
+/**
+ * Get the current time from a clock not affected by system time changes.
+ *
+ * The time returned is only meaningful to measure elapsed time, and falls
+ * back to the wall-clock time on systems without a monotonic clock.
+ *
+ * @param ts The timespec to fill in.
+ */
+void
+dpkg_clock_get_monotonic(struct timespec *ts)
+{
+#if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && \
+    defined(_POSIX_MONOTONIC_CLOCK) && _POSIX_MONOTONIC_CLOCK > 0
+	if (clock_gettime(CLOCK_MONOTONIC, ts) < 0)
+		ohshite(_("cannot get current time"));
+#else
+	struct timeval tv;
+
+	if (gettimeofday(&tv, NULL) < 0)
+		ohshite(_("cannot get current time"));
+
+	ts->tv_sec = tv.tv_sec;
+	ts->tv_nsec = tv.tv_usec * 1000;
+#endif
+}
+
+/**
+ * Compute the elapsed time between two clock readings.
+ *
+ * @param start The earlier time.
+ * @param end The later time.
+ *
+ * @return The elapsed time in seconds.
+ */
+double
+dpkg_clock_elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return (double)(end->tv_sec - start->tv_sec) +
+	       (double)(end->tv_nsec - start->tv_nsec) / 1000000000.0;
+}
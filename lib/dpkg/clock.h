@@ -0,0 +1,42 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * clock.h - clock handling routines
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBDPKG_CLOCK_H
+#define LIBDPKG_CLOCK_H
+
+#include <time.h>
+
+#include <dpkg/macros.h>
+
+DPKG_BEGIN_DECLS
+
+/**
+ * @defgroup clock Clock handling
+ * @ingroup dpkg-internal
+ * @{
+ */
+
+void dpkg_clock_get_monotonic(struct timespec *ts);
+double dpkg_clock_elapsed(const struct timespec *start,
+                          const struct timespec *end);
+
+/** @} */
+
+DPKG_END_DECLS
+
+#endif /* LIBDPKG_CLOCK_H */
@@ -26,15 +26,19 @@
 #include <sys/stat.h>
 
 #include <errno.h>
+#include <string.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <stdlib.h>
 
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/string.h>
 #include <dpkg/fsys.h>
 #include <dpkg/db-ctrl.h>
 #include <dpkg/debug.h>
+#include <dpkg/dir.h>
 
 bool
 pkg_infodb_has_file(struct pkginfo *pkg, struct pkgbin *pkgbin,
@@ -52,69 +56,383 @@ pkg_infodb_has_file(struct pkginfo *pkg, struct pkgbin *pkgbin,
 		ohshite(_("unable to check existence of '%.250s'"), filename);
 }
 
+/**
+ * Make sure the directory for the package control files exists.
+ */
 void
-pkg_infodb_foreach(struct pkginfo *pkg, struct pkgbin *pkgbin,
-                   pkg_infodb_file_func *func)
+pkg_infodb_setup_pkgdir(struct pkginfo *pkg, struct pkgbin *pkgbin)
+{
+	const char *pkgdir;
+	char *pkgsdir;
+
+	if (pkg_infodb_get_format() < PKG_INFODB_FORMAT_HIERARCHICAL)
+		return;
+
+	pkgsdir = dpkg_db_get_path(INFODIR "/" INFOPKGSDIR);
+	if (mkdir(pkgsdir, 0755) == 0)
+		dir_sync_path_parent(pkgsdir);
+	else if (errno != EEXIST)
+		ohshite(_("unable to create info directory '%.250s'"), pkgsdir);
+
+	pkgdir = pkg_infodb_get_pkgdir(pkg, pkgbin);
+	if (mkdir(pkgdir, 0755) == 0)
+		dir_sync_path(pkgsdir);
+	else if (errno != EEXIST)
+		ohshite(_("unable to create info directory '%.250s'"), pkgdir);
+
+	free(pkgsdir);
+}
+
+/**
+ * Sync to disk the directory for the package control files.
+ */
+void
+pkg_infodb_sync_pkgdir(struct pkginfo *pkg, struct pkgbin *pkgbin)
+{
+	const char *pkgdir;
+	struct stat st;
+
+	pkgdir = pkg_infodb_get_pkgdir(pkg, pkgbin);
+
+	/* With the hierarchical format the package might have no files. */
+	if (pkg_infodb_get_format() >= PKG_INFODB_FORMAT_HIERARCHICAL &&
+	    stat(pkgdir, &st) < 0 && errno == ENOENT)
+		return;
+
+	dir_sync_path(pkgdir);
+}
+
+/**
+ * Remove the directory for the package control files, if it is empty.
+ */
+void
+pkg_infodb_remove_pkgdir(struct pkginfo *pkg, struct pkgbin *pkgbin)
+{
+	const char *pkgdir;
+	char *pkgsdir;
+
+	if (pkg_infodb_get_format() < PKG_INFODB_FORMAT_HIERARCHICAL)
+		return;
+
+	pkgdir = pkg_infodb_get_pkgdir(pkg, pkgbin);
+	if (rmdir(pkgdir) < 0) {
+		if (errno == ENOENT || errno == ENOTEMPTY || errno == EEXIST)
+			return;
+		ohshite(_("unable to remove info directory '%.250s'"), pkgdir);
+	}
+
+	pkgsdir = dpkg_db_get_path(INFODIR "/" INFOPKGSDIR);
+	dir_sync_path(pkgsdir);
+	free(pkgsdir);
+}
+
+/*
+ * With the flat formats the info directory can contain tens of thousands
+ * of files, so instead of scanning it for each package, we index it on
+ * first use by package name, and keep the index up-to-date as control files
+ * get added or removed.
+ */
+
+#define INFODB_INDEX_BINS 8191
+
+struct infodb_file {
+	struct infodb_file *next;
+	char *filetype;
+};
+
+struct infodb_pkg {
+	struct infodb_pkg *next;
+	char *pkgname;
+	struct infodb_file *files;
+};
+
+static struct infodb_pkg *infodb_index[INFODB_INDEX_BINS];
+static bool infodb_index_loaded;
+
+static struct infodb_pkg *
+infodb_index_find(const char *pkgname, size_t len, bool create)
+{
+	struct infodb_pkg **pkgp;
+	struct infodb_pkg *ipkg;
+	char *name;
+
+	name = m_strndup(pkgname, len);
+	pkgp = &infodb_index[str_fnv_hash(name) % INFODB_INDEX_BINS];
+
+	for (ipkg = *pkgp; ipkg; ipkg = ipkg->next) {
+		if (strcmp(ipkg->pkgname, name) == 0) {
+			free(name);
+			return ipkg;
+		}
+	}
+
+	if (!create) {
+		free(name);
+		return NULL;
+	}
+
+	ipkg = m_malloc(sizeof(*ipkg));
+	ipkg->pkgname = name;
+	ipkg->files = NULL;
+	ipkg->next = *pkgp;
+	*pkgp = ipkg;
+
+	return ipkg;
+}
+
+static void
+infodb_index_add(const char *basename)
+{
+	struct infodb_pkg *ipkg;
+	struct infodb_file *ifile;
+	const char *dot;
+
+	/* Ignore dotfiles, including ‘.’ and ‘..’. */
+	if (basename[0] == '.')
+		return;
+
+	/* Ignore anything odd. */
+	dot = strrchr(basename, '.');
+	if (dot == NULL)
+		return;
+
+	ipkg = infodb_index_find(basename, dot - basename, true);
+
+	for (ifile = ipkg->files; ifile; ifile = ifile->next)
+		if (strcmp(ifile->filetype, dot + 1) == 0)
+			return;
+
+	ifile = m_malloc(sizeof(*ifile));
+	ifile->filetype = m_strdup(dot + 1);
+	ifile->next = ipkg->files;
+	ipkg->files = ifile;
+}
+
+static void
+infodb_index_load(void)
 {
 	DIR *db_dir;
 	struct dirent *db_de;
-	struct varbuf_state db_path_state;
-	struct varbuf db_path = VARBUF_INIT;
-	const char *pkgname;
-	enum pkg_infodb_format db_format;
 
-	/* Make sure to always read and verify the format version. */
-	db_format = pkg_infodb_get_format();
+	db_dir = opendir(pkg_infodb_get_dir());
+	if (!db_dir)
+		ohshite(_("cannot read info directory"));
 
-	if (pkgbin->multiarch == PKG_MULTIARCH_SAME &&
-	    db_format == PKG_INFODB_FORMAT_MULTIARCH)
-		pkgname = pkgbin_name(pkg, pkgbin, pnaw_always);
-	else
-		pkgname = pkgbin_name(pkg, pkgbin, pnaw_never);
+	push_cleanup(cu_closedir, ~0, 1, (void *)db_dir);
+	while ((db_de = readdir(db_dir)) != NULL) {
+		debug(dbg_veryverbose, "infodb index info file '%s'",
+		      db_de->d_name);
 
-	varbuf_add_str(&db_path, pkg_infodb_get_dir());
+		infodb_index_add(db_de->d_name);
+	}
+	pop_cleanup(ehflag_normaltidy); /* closedir */
+
+	infodb_index_loaded = true;
+}
+
+static const char *
+infodb_index_basename(const char *filename)
+{
+	const char *slash;
+
+	slash = strrchr(filename, '/');
+	if (slash)
+		return slash + 1;
+	return filename;
+}
+
+/**
+ * Record that a control file has been added to the info database.
+ *
+ * @param filename The pathname of the control file in the info directory.
+ */
+void
+pkg_infodb_index_add_file(const char *filename)
+{
+	if (!infodb_index_loaded)
+		return;
+
+	infodb_index_add(infodb_index_basename(filename));
+}
+
+/**
+ * Record that a control file has been removed from the info database.
+ *
+ * @param filename The pathname of the control file in the info directory.
+ */
+void
+pkg_infodb_index_remove_file(const char *filename)
+{
+	struct infodb_pkg *ipkg;
+	struct infodb_file **filep;
+	const char *basename;
+	const char *dot;
+
+	if (!infodb_index_loaded)
+		return;
+
+	basename = infodb_index_basename(filename);
+	dot = strrchr(basename, '.');
+	if (dot == NULL)
+		return;
+
+	ipkg = infodb_index_find(basename, dot - basename, false);
+	if (ipkg == NULL)
+		return;
+
+	for (filep = &ipkg->files; *filep; filep = &(*filep)->next) {
+		struct infodb_file *ifile = *filep;
+
+		if (strcmp(ifile->filetype, dot + 1) == 0) {
+			*filep = ifile->next;
+			free(ifile->filetype);
+			free(ifile);
+			return;
+		}
+	}
+}
+
+/**
+ * Discard the info database index.
+ *
+ * This needs to be called whenever the info directory gets modified behind
+ * our back, so that it gets scanned again on next use.
+ */
+void
+pkg_infodb_index_reset(void)
+{
+	int i;
+
+	for (i = 0; i < INFODB_INDEX_BINS; i++) {
+		struct infodb_pkg *ipkg, *ipkg_next;
+
+		for (ipkg = infodb_index[i]; ipkg; ipkg = ipkg_next) {
+			struct infodb_file *ifile, *ifile_next;
+
+			for (ifile = ipkg->files; ifile; ifile = ifile_next) {
+				ifile_next = ifile->next;
+				free(ifile->filetype);
+				free(ifile);
+			}
+
+			ipkg_next = ipkg->next;
+			free(ipkg->pkgname);
+			free(ipkg);
+		}
+		infodb_index[i] = NULL;
+	}
+
+	infodb_index_loaded = false;
+}
+
+static void
+pkg_infodb_foreach_pkgdir(struct pkginfo *pkg, struct pkgbin *pkgbin,
+                          pkg_infodb_file_func *func)
+{
+	DIR *db_dir;
+	struct dirent *db_de;
+	struct varbuf_state db_path_state;
+	struct varbuf db_path = VARBUF_INIT;
+
+	varbuf_add_str(&db_path, pkg_infodb_get_pkgdir(pkg, pkgbin));
 	varbuf_add_char(&db_path, '/');
 	varbuf_end_str(&db_path);
 	varbuf_snapshot(&db_path, &db_path_state);
 
 	db_dir = opendir(db_path.buf);
-	if (!db_dir)
+	if (!db_dir) {
+		if (errno == ENOENT) {
+			varbuf_destroy(&db_path);
+			return;
+		}
 		ohshite(_("cannot read info directory"));
+	}
 
 	push_cleanup(cu_closedir, ~0, 1, (void *)db_dir);
 	while ((db_de = readdir(db_dir)) != NULL) {
-		const char *filename, *filetype, *dot;
-
-		debug(dbg_veryverbose, "infodb foreach info file '%s'",
-		      db_de->d_name);
-
 		/* Ignore dotfiles, including ‘.’ and ‘..’. */
 		if (db_de->d_name[0] == '.')
 			continue;
 
-		/* Ignore anything odd. */
-		dot = strrchr(db_de->d_name, '.');
-		if (dot == NULL)
-			continue;
+		debug(dbg_stupidlyverbose, "infodb foreach file this pkg '%s'",
+		      db_de->d_name);
 
-		/* Ignore files from other packages. */
-		if (strlen(pkgname) != (size_t)(dot - db_de->d_name) ||
-		    strncmp(db_de->d_name, pkgname, dot - db_de->d_name))
-			continue;
+		varbuf_rollback(&db_path, &db_path_state);
+		varbuf_add_str(&db_path, db_de->d_name);
+		varbuf_end_str(&db_path);
+
+		func(db_path.buf, db_de->d_name);
+	}
+	pop_cleanup(ehflag_normaltidy); /* closedir */
+
+	varbuf_destroy(&db_path);
+}
+
+void
+pkg_infodb_foreach(struct pkginfo *pkg, struct pkgbin *pkgbin,
+                   pkg_infodb_file_func *func)
+{
+	struct varbuf_state db_path_state;
+	struct varbuf db_path = VARBUF_INIT;
+	struct infodb_pkg *ipkg;
+	struct infodb_file *ifile;
+	const char *pkgname;
+	enum pkg_infodb_format db_format;
+	char **filetypes;
+	int nfiles, i;
+
+	/* Make sure to always read and verify the format version. */
+	db_format = pkg_infodb_get_format();
+
+	/* Each package has its own directory, which is cheap to scan. */
+	if (db_format >= PKG_INFODB_FORMAT_HIERARCHICAL) {
+		pkg_infodb_foreach_pkgdir(pkg, pkgbin, func);
+		return;
+	}
+
+	if (pkgbin->multiarch == PKG_MULTIARCH_SAME &&
+	    db_format == PKG_INFODB_FORMAT_MULTIARCH)
+		pkgname = pkgbin_name(pkg, pkgbin, pnaw_always);
+	else
+		pkgname = pkgbin_name(pkg, pkgbin, pnaw_never);
 
-		debug(dbg_stupidlyverbose, "infodb foreach file this pkg");
+	if (!infodb_index_loaded)
+		infodb_index_load();
 
-		/* Skip past the full stop. */
-		filetype = dot + 1;
+	ipkg = infodb_index_find(pkgname, strlen(pkgname), false);
+	if (ipkg == NULL)
+		return;
+
+	/* Take a copy of the file types, as the function might add or remove
+	 * files from the info database, and thus modify the index. */
+	nfiles = 0;
+	for (ifile = ipkg->files; ifile; ifile = ifile->next)
+		nfiles++;
+	filetypes = m_malloc(sizeof(filetypes[0]) * (nfiles + 1));
+	nfiles = 0;
+	for (ifile = ipkg->files; ifile; ifile = ifile->next)
+		filetypes[nfiles++] = m_strdup(ifile->filetype);
+
+	varbuf_add_str(&db_path, pkg_infodb_get_dir());
+	varbuf_add_char(&db_path, '/');
+	varbuf_add_str(&db_path, pkgname);
+	varbuf_add_char(&db_path, '.');
+	varbuf_end_str(&db_path);
+	varbuf_snapshot(&db_path, &db_path_state);
+
+	for (i = 0; i < nfiles; i++) {
+		debug(dbg_stupidlyverbose, "infodb foreach file this pkg '%s'",
+		      filetypes[i]);
 
 		varbuf_rollback(&db_path, &db_path_state);
-		varbuf_add_str(&db_path, db_de->d_name);
+		varbuf_add_str(&db_path, filetypes[i]);
 		varbuf_end_str(&db_path);
-		filename = db_path.buf;
 
-		func(filename, filetype);
+		func(db_path.buf, filetypes[i]);
+
+		free(filetypes[i]);
 	}
-	pop_cleanup(ehflag_normaltidy); /* closedir */
+	free(filetypes);
 
 	varbuf_destroy(&db_path);
 }
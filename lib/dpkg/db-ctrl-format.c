@@ -124,6 +124,16 @@ pkg_infodb_get_dir(void)
 	return db_infodir;
 }
 
+static void
+pkg_infodb_add_pkgname(struct varbuf *vb, struct pkginfo *pkg,
+                       struct pkgbin *pkgbin, enum pkg_infodb_format format)
+{
+	varbuf_add_str(vb, pkg->set->name);
+	if (pkgbin->multiarch == PKG_MULTIARCH_SAME &&
+	    format >= PKG_INFODB_FORMAT_MULTIARCH)
+		varbuf_add_archqual(vb, pkgbin->arch);
+}
+
 const char *
 pkg_infodb_get_file(struct pkginfo *pkg, struct pkgbin *pkgbin,
                     const char *filetype)
@@ -137,22 +147,54 @@ pkg_infodb_get_file(struct pkginfo *pkg, struct pkgbin *pkgbin,
 	varbuf_reset(&vb);
 	varbuf_add_str(&vb, pkg_infodb_get_dir());
 	varbuf_add_char(&vb, '/');
-	varbuf_add_str(&vb, pkg->set->name);
-	if (pkgbin->multiarch == PKG_MULTIARCH_SAME &&
-	    format == PKG_INFODB_FORMAT_MULTIARCH)
-		varbuf_add_archqual(&vb, pkgbin->arch);
-	varbuf_add_char(&vb, '.');
+	if (format >= PKG_INFODB_FORMAT_HIERARCHICAL) {
+		varbuf_add_str(&vb, INFOPKGSDIR "/");
+		pkg_infodb_add_pkgname(&vb, pkg, pkgbin, format);
+		varbuf_add_char(&vb, '/');
+	} else {
+		pkg_infodb_add_pkgname(&vb, pkg, pkgbin, format);
+		varbuf_add_char(&vb, '.');
+	}
 	varbuf_add_str(&vb, filetype);
 	varbuf_end_str(&vb);
 
 	return vb.buf;
 }
 
+/**
+ * Get the directory containing the package control files.
+ *
+ * For the flat formats this is the info directory itself, otherwise it is
+ * the package own subdirectory.
+ */
+const char *
+pkg_infodb_get_pkgdir(struct pkginfo *pkg, struct pkgbin *pkgbin)
+{
+	static struct varbuf vb;
+	enum pkg_infodb_format format;
+
+	/* Make sure to always read and verify the format version. */
+	format = pkg_infodb_get_format();
+
+	if (format < PKG_INFODB_FORMAT_HIERARCHICAL)
+		return pkg_infodb_get_dir();
+
+	varbuf_reset(&vb);
+	varbuf_add_str(&vb, pkg_infodb_get_dir());
+	varbuf_add_str(&vb, "/" INFOPKGSDIR "/");
+	pkg_infodb_add_pkgname(&vb, pkg, pkgbin, format);
+	varbuf_end_str(&vb);
+
+	return vb.buf;
+}
+
 const char *
 pkg_infodb_reset_dir(void)
 {
 	free(db_infodir);
 	db_infodir = NULL;
 
+	pkg_infodb_index_reset();
+
 	return pkg_infodb_get_dir();
 }
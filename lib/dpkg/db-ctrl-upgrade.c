@@ -28,12 +28,15 @@
 #include <sys/stat.h>
 
 #include <errno.h>
+#include <dirent.h>
+#include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
 
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/varbuf.h>
 #include <dpkg/fsys.h>
 #include <dpkg/db-ctrl.h>
 #include <dpkg/path.h>
@@ -47,6 +50,7 @@ struct rename_node {
 
 /* Global variables. */
 static struct rename_node *rename_head = NULL;
+static enum pkg_infodb_format db_upgrade_format = PKG_INFODB_FORMAT_MULTIARCH;
 
 static struct rename_node *
 rename_node_new(const char *old, const char *new, struct rename_node *next)
@@ -173,6 +177,8 @@ cu_abort_db_upgrade(int argc, void **argv)
 	if (unlink(file->name_new) && errno != ENOENT)
 		ohshite(_("cannot remove '%.250s'"), file->name_new);
 
+	pkg_infodb_index_reset();
+
 	atomic_file_free(file);
 }
 
@@ -190,7 +196,7 @@ pkg_infodb_write_format(struct atomic_file *file, int version)
 }
 
 static void
-pkg_infodb_unlink_monoarch_files(void)
+pkg_infodb_unlink_old_files(void)
 {
 	struct rename_node *next;
 
@@ -218,22 +224,191 @@ pkg_infodb_upgrade_to_multiarch(void)
 	pkg_infodb_link_multiarch_files();
 	pkg_infodb_write_format(db_file, 1);
 
-	pkg_infodb_unlink_monoarch_files();
+	pkg_infodb_unlink_old_files();
 	atomic_file_commit(db_file);
 	dir_sync_path(pkg_infodb_get_dir());
 
+	/* The files have been renamed, rescan them on next use. */
+	pkg_infodb_index_reset();
+
+	pop_cleanup(ehflag_normaltidy);
+
+	atomic_file_free(db_file);
+	free(db_format_file);
+}
+
+static void
+pkg_infodb_link_hierarchical_files(bool resuming)
+{
+	DIR *db_dir;
+	struct dirent *db_de;
+	struct varbuf oldname = VARBUF_INIT;
+	struct varbuf newname = VARBUF_INIT;
+	struct varbuf_state oldname_state;
+	struct varbuf_state newname_state;
+
+	varbuf_add_str(&oldname, pkg_infodb_get_dir());
+	varbuf_add_char(&oldname, '/');
+	varbuf_end_str(&oldname);
+	varbuf_snapshot(&oldname, &oldname_state);
+
+	varbuf_add_buf(&newname, oldname.buf, oldname.used);
+	varbuf_add_str(&newname, INFOPKGSDIR "/");
+	varbuf_end_str(&newname);
+	varbuf_snapshot(&newname, &newname_state);
+
+	db_dir = opendir(oldname.buf);
+	if (!db_dir)
+		ohshite(_("cannot read info directory"));
+
+	push_cleanup(cu_closedir, ~0, 1, (void *)db_dir);
+	while ((db_de = readdir(db_dir)) != NULL) {
+		const char *dot;
+
+		/* Ignore dotfiles, including ‘.’ and ‘..’. */
+		if (db_de->d_name[0] == '.')
+			continue;
+
+		/* Ignore anything odd, including the format file and the
+		 * packages directory. */
+		dot = strrchr(db_de->d_name, '.');
+		if (dot == NULL)
+			continue;
+
+		varbuf_rollback(&oldname, &oldname_state);
+		varbuf_add_str(&oldname, db_de->d_name);
+		varbuf_end_str(&oldname);
+
+		varbuf_rollback(&newname, &newname_state);
+		varbuf_add_buf(&newname, db_de->d_name, dot - db_de->d_name);
+		varbuf_end_str(&newname);
+
+		if (mkdir(newname.buf, 0755) < 0 && errno != EEXIST)
+			ohshite(_("unable to create info directory '%.250s'"),
+			        newname.buf);
+
+		varbuf_add_char(&newname, '/');
+		varbuf_add_str(&newname, dot + 1);
+		varbuf_end_str(&newname);
+
+		/* When not resuming an interrupted upgrade, any existing file
+		 * is a leftover from an aborted one, and might be stale. */
+		if (!resuming && unlink(newname.buf) < 0 && errno != ENOENT)
+			ohshite(_("cannot remove '%.250s'"), newname.buf);
+
+		if (link(oldname.buf, newname.buf) && errno != EEXIST)
+			ohshite(_("error creating hard link '%.255s'"),
+			        newname.buf);
+		rename_head = rename_node_new(oldname.buf, newname.buf, rename_head);
+	}
+	pop_cleanup(ehflag_normaltidy); /* closedir */
+
+	varbuf_destroy(&newname);
+	varbuf_destroy(&oldname);
+}
+
+static void
+pkg_infodb_sync_hierarchical_dirs(void)
+{
+	DIR *db_dir;
+	struct dirent *db_de;
+	struct varbuf pkgdir = VARBUF_INIT;
+	struct varbuf_state pkgdir_state;
+
+	varbuf_add_str(&pkgdir, pkg_infodb_get_dir());
+	varbuf_add_str(&pkgdir, "/" INFOPKGSDIR);
+	varbuf_end_str(&pkgdir);
+
+	db_dir = opendir(pkgdir.buf);
+	if (!db_dir)
+		ohshite(_("cannot read info directory"));
+
+	varbuf_add_char(&pkgdir, '/');
+	varbuf_end_str(&pkgdir);
+	varbuf_snapshot(&pkgdir, &pkgdir_state);
+
+	push_cleanup(cu_closedir, ~0, 1, (void *)db_dir);
+	while ((db_de = readdir(db_dir)) != NULL) {
+		if (db_de->d_name[0] == '.')
+			continue;
+
+		varbuf_rollback(&pkgdir, &pkgdir_state);
+		varbuf_add_str(&pkgdir, db_de->d_name);
+		varbuf_end_str(&pkgdir);
+
+		dir_sync_path(pkgdir.buf);
+	}
+	pop_cleanup(ehflag_normaltidy); /* closedir */
+
+	varbuf_rollback(&pkgdir, &pkgdir_state);
+	varbuf_end_str(&pkgdir);
+	dir_sync_path(pkgdir.buf);
+
+	varbuf_destroy(&pkgdir);
+}
+
+static void
+pkg_infodb_upgrade_to_hierarchical(void)
+{
+	struct atomic_file *db_file;
+	char *db_format_file;
+	char *db_pkgs_dir;
+	bool resuming;
+
+	resuming = pkg_infodb_get_format() == PKG_INFODB_FORMAT_HIERARCHICAL &&
+	           pkg_infodb_is_upgrading();
+
+	db_format_file = dpkg_db_get_path(INFODIR "/format");
+	db_file = atomic_file_new(db_format_file, 0);
+	atomic_file_open(db_file);
+
+	push_cleanup(cu_abort_db_upgrade, ehflag_bombout, 1, db_file);
+
+	db_pkgs_dir = dpkg_db_get_path(INFODIR "/" INFOPKGSDIR);
+	if (mkdir(db_pkgs_dir, 0755) < 0 && errno != EEXIST)
+		ohshite(_("unable to create info directory '%.250s'"),
+		        db_pkgs_dir);
+	free(db_pkgs_dir);
+
+	/* The new layout must be complete on disk before we switch over. */
+	pkg_infodb_link_hierarchical_files(resuming);
+	pkg_infodb_sync_hierarchical_dirs();
+	pkg_infodb_write_format(db_file, PKG_INFODB_FORMAT_HIERARCHICAL);
+
+	pkg_infodb_unlink_old_files();
+	atomic_file_commit(db_file);
+	dir_sync_path(pkg_infodb_get_dir());
+
+	/* The files have been moved, rescan them on next use. */
+	pkg_infodb_index_reset();
+
 	pop_cleanup(ehflag_normaltidy);
 
 	atomic_file_free(db_file);
 	free(db_format_file);
 }
 
+/**
+ * Set the infodb format to upgrade to.
+ *
+ * By default the infodb gets upgraded to the multiarch format, the
+ * hierarchical format has to be explicitly requested, as it changes
+ * the layout other tools might be expecting.
+ */
+void
+pkg_infodb_set_upgrade_format(enum pkg_infodb_format format)
+{
+	db_upgrade_format = format;
+}
+
 /**
  * Upgrade the infodb if there's the need and possibility.
  *
  * Currently this implies, that the modstatdb was opened for writing and:
  * - previous upgrade has not been completed; or
- * - current format is not the latest one.
+ * - current format is older than the requested upgrade format.
+ *
+ * The upgrades are performed one format at a time.
  */
 void
 pkg_infodb_upgrade(void)
@@ -247,6 +422,13 @@ pkg_infodb_upgrade(void)
 		return;
 
 	if (db_format < PKG_INFODB_FORMAT_MULTIARCH ||
-	    pkg_infodb_is_upgrading())
+	    (db_format == PKG_INFODB_FORMAT_MULTIARCH &&
+	     pkg_infodb_is_upgrading()))
 		pkg_infodb_upgrade_to_multiarch();
+
+	if ((db_format == PKG_INFODB_FORMAT_HIERARCHICAL &&
+	     pkg_infodb_is_upgrading()) ||
+	    (pkg_infodb_get_format() < PKG_INFODB_FORMAT_HIERARCHICAL &&
+	     db_upgrade_format >= PKG_INFODB_FORMAT_HIERARCHICAL))
+		pkg_infodb_upgrade_to_hierarchical();
 }
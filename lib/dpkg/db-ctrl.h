@@ -29,21 +29,31 @@ enum pkg_infodb_format {
 	PKG_INFODB_FORMAT_UNKNOWN = -1,
 	PKG_INFODB_FORMAT_LEGACY = 0,
 	PKG_INFODB_FORMAT_MULTIARCH = 1,
+	PKG_INFODB_FORMAT_HIERARCHICAL = 2,
 	PKG_INFODB_FORMAT_LAST,
 };
 
 enum pkg_infodb_format pkg_infodb_get_format(void);
 void pkg_infodb_set_format(enum pkg_infodb_format format);
 bool pkg_infodb_is_upgrading(void);
+void pkg_infodb_set_upgrade_format(enum pkg_infodb_format format);
 void pkg_infodb_upgrade(void);
 
 const char *pkg_infodb_get_dir(void);
 const char *pkg_infodb_get_file(struct pkginfo *pkg, struct pkgbin *pkgbin,
                                 const char *filetype);
 const char *pkg_infodb_reset_dir(void);
+const char *pkg_infodb_get_pkgdir(struct pkginfo *pkg, struct pkgbin *pkgbin);
+void pkg_infodb_setup_pkgdir(struct pkginfo *pkg, struct pkgbin *pkgbin);
+void pkg_infodb_sync_pkgdir(struct pkginfo *pkg, struct pkgbin *pkgbin);
+void pkg_infodb_remove_pkgdir(struct pkginfo *pkg, struct pkgbin *pkgbin);
 bool pkg_infodb_has_file(struct pkginfo *pkg, struct pkgbin *pkgbin,
                          const char *name);
 
+void pkg_infodb_index_add_file(const char *filename);
+void pkg_infodb_index_remove_file(const char *filename);
+void pkg_infodb_index_reset(void);
+
 typedef void pkg_infodb_file_func(const char *filename, const char *filetype);
 
 void pkg_infodb_foreach(struct pkginfo *pkg, struct pkgbin *pkgbin,
@@ -54,6 +54,7 @@ write_filehash_except(struct pkginfo *pkg, struct pkgbin *pkgbin,
 	if (pkg_infodb_has_file(pkg, &pkg->available, HASHFILE))
 		return;
 
+	pkg_infodb_setup_pkgdir(pkg, pkgbin);
 	hashfile = pkg_infodb_get_file(pkg, pkgbin, HASHFILE);
 
 	file = atomic_file_new(hashfile, 0);
@@ -76,7 +77,9 @@ write_filehash_except(struct pkginfo *pkg, struct pkgbin *pkgbin,
 	atomic_file_commit(file);
 	atomic_file_free(file);
 
-	dir_sync_path(pkg_infodb_get_dir());
+	pkg_infodb_sync_pkgdir(pkg, pkgbin);
+
+	pkg_infodb_index_add_file(hashfile);
 }
 
 static void
@@ -134,18 +137,20 @@ void
 parse_filehash(struct pkginfo *pkg, struct pkgbin *pkgbin)
 {
 	const char *hashfile;
-	struct varbuf buf = VARBUF_INIT;
+	struct varbuf *buf;
 	struct dpkg_error err = DPKG_ERROR_INIT;
 
 	hashfile = pkg_infodb_get_file(pkg, pkgbin, HASHFILE);
 
-	if (file_slurp(hashfile, &buf, &err) < 0 && err.syserrno != ENOENT)
+	buf = varbuf_scratch_get();
+	push_cleanup(cu_varbuf_scratch, ~0, 1, buf);
+	if (file_slurp(hashfile, buf, &err) < 0 && err.syserrno != ENOENT)
 		dpkg_error_print(&err,
 		                 _("loading control file '%s' for package '%s'"),
 		                 HASHFILE, pkg_name(pkg, pnaw_nonambig));
 
-	if (buf.used > 0)
-		parse_filehash_buffer(&buf, pkg, pkgbin);
+	if (buf->used > 0)
+		parse_filehash_buffer(buf, pkg, pkgbin);
 
-	varbuf_destroy(&buf);
+	pop_cleanup(ehflag_normaltidy); /* varbuf_scratch_put */
 }
@@ -80,7 +80,7 @@ ensure_packagefiles_available(struct pkginfo *pkg)
   const char *filelistfile;
   struct fileinlist **lendp;
   char *loaded_list_end, *thisline, *nextline, *ptr;
-  struct varbuf buf = VARBUF_INIT;
+  struct varbuf *buf;
   struct dpkg_error err = DPKG_ERROR_INIT;
 
   if (pkg->files_list_valid)
@@ -99,7 +99,10 @@ ensure_packagefiles_available(struct pkginfo *pkg)
 
   onerr_abort++;
 
-  if (file_slurp(filelistfile, &buf, &err) < 0) {
+  buf = varbuf_scratch_get();
+  push_cleanup(cu_varbuf_scratch, ~0, 1, buf);
+  if (file_slurp(filelistfile, buf, &err) < 0) {
+    pop_cleanup(ehflag_normaltidy);
     if (err.syserrno != ENOENT)
       dpkg_error_print(&err, _("loading files list file for package '%s'"),
                        pkg_name(pkg, pnaw_nonambig));
@@ -116,11 +119,11 @@ ensure_packagefiles_available(struct pkginfo *pkg)
     return;
   }
 
-  if (buf.used) {
-    loaded_list_end = buf.buf + buf.used;
+  if (buf->used) {
+    loaded_list_end = buf->buf + buf->used;
 
     lendp = &pkg->files;
-    thisline = buf.buf;
+    thisline = buf->buf;
     while (thisline < loaded_list_end) {
       struct filenamenode *namenode;
 
@@ -144,7 +147,7 @@ ensure_packagefiles_available(struct pkginfo *pkg)
     }
   }
 
-  varbuf_destroy(&buf);
+  pop_cleanup(ehflag_normaltidy); /* varbuf_scratch_put */
 
   onerr_abort--;
 
@@ -301,6 +304,7 @@ write_filelist_except(struct pkginfo *pkg, struct pkgbin *pkgbin,
   struct fileinlist *node;
   const char *listfile;
 
+  pkg_infodb_setup_pkgdir(pkg, pkgbin);
   listfile = pkg_infodb_get_file(pkg, pkgbin, LISTFILE);
 
   file = atomic_file_new(listfile, 0);
@@ -318,7 +322,9 @@ write_filelist_except(struct pkginfo *pkg, struct pkgbin *pkgbin,
   atomic_file_commit(file);
   atomic_file_free(file);
 
-  dir_sync_path(pkg_infodb_get_dir());
+  pkg_infodb_sync_pkgdir(pkg, pkgbin);
+
+  pkg_infodb_index_add_file(listfile);
 
   note_must_reread_files_inpackage(pkg);
 }
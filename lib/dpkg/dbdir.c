@@ -29,6 +29,7 @@
 #include <dpkg/dpkg-db.h>
 
 static const char *db_dir = ADMINDIR;
+static bool db_sync_deferred;
 
 /**
  * Set current on-disk database directory.
@@ -86,3 +87,30 @@ dpkg_db_get_path(const char *pathpart)
 {
 	return str_fmt("%s/%s", db_dir, pathpart);
 }
+
+/**
+ * Set whether the on-disk database durability syncs should be deferred.
+ *
+ * When deferred, the database file and directory syncs, including the
+ * atomic file syncs, the status journal syncs, and the package control
+ * files directory syncs on unpack, are all skipped. The caller is then
+ * responsible for syncing the file systems once it has finished.
+ *
+ * @param deferred Whether to defer the syncs.
+ */
+void
+dpkg_db_set_sync_deferred(bool deferred)
+{
+	db_sync_deferred = deferred;
+}
+
+/**
+ * Check whether the on-disk database durability syncs are being deferred.
+ *
+ * @return Whether the syncs are deferred.
+ */
+bool
+dpkg_db_is_sync_deferred(void)
+{
+	return db_sync_deferred;
+}
@@ -29,6 +29,8 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
 #include <fcntl.h>
@@ -43,7 +45,9 @@
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
 #include <dpkg/file.h>
+#include <dpkg/fdio.h>
 #include <dpkg/dir.h>
+#include <dpkg/parsedump.h>
 #include <dpkg/triglib.h>
 
 static bool db_initialized;
@@ -60,6 +64,30 @@ static int updateslength;
 static char *updatefnbuf, *updatefnrest;
 static struct varbuf uvb;
 
+/*
+ * While a transaction is in progress, the writer publishes a read snapshot
+ * made of the status file plus a compact delta with the last journal record
+ * of each package modified since the last checkpoint. The snapshot carries
+ * the number of journal entries it covers (its generation) and the identity
+ * of the status file it applies to, so that readers can pick it up instead
+ * of replaying the whole journal, and detect when it is not consistent with
+ * what they see.
+ */
+
+#define SNAPSHOT_MAGIC "dpkg-snapshot"
+#define SNAPSHOT_FORMAT 1
+
+struct snapshot_entry {
+  struct pkginfo *pkg;
+  struct varbuf record;
+};
+
+static char *snapshotfile, *snapshottmpfile;
+static struct snapshot_entry *snapshot_entries;
+static int snapshot_nentries;
+static bool snapshot_disabled;
+static struct varbuf snapshot_vb;
+
 static int ulist_select(const struct dirent *de) {
   const char *p;
   int l;
@@ -76,10 +104,264 @@ static int ulist_select(const struct dirent *de) {
   return 1;
 }
 
+static bool
+snapshot_parse_header(struct parsedb_state *ps, const struct stat *st,
+                      int *generation)
+{
+  intmax_t ino, size, mtime;
+  char magic[sizeof(SNAPSHOT_MAGIC)];
+  char header[128];
+  char *eol;
+  int format;
+
+  if (ps->dataptr == NULL)
+    return false;
+  eol = memchr(ps->dataptr, '\n', ps->endptr - ps->dataptr);
+  if (eol == NULL || eol - ps->dataptr >= (ptrdiff_t)sizeof(header))
+    return false;
+
+  /* The data might be mapped read-only, so work on a copy. */
+  memcpy(header, ps->dataptr, eol - ps->dataptr);
+  header[eol - ps->dataptr] = '\0';
+
+  if (sscanf(header, "%13s %d %d %jd %jd %jd", magic, &format,
+             generation, &ino, &size, &mtime) != 6)
+    return false;
+  if (strcmp(magic, SNAPSHOT_MAGIC) != 0 || format != SNAPSHOT_FORMAT)
+    return false;
+  if (ino != (intmax_t)st->st_ino || size != (intmax_t)st->st_size ||
+      mtime != (intmax_t)st->st_mtime)
+    return false;
+
+  ps->dataptr = eol + 1;
+  ps->lno++;
+
+  return true;
+}
+
+/*
+ * Load the status file and the published read snapshot, if there is one
+ * and it matches both the status file and the journal.
+ */
+static bool
+snapshot_load(void)
+{
+  struct parsedb_state *status_ps, *snap_ps;
+  struct stat st;
+  int statusfd, snapfd;
+  int generation;
+  bool valid;
+
+  snapfd = open(snapshotfile, O_RDONLY);
+  if (snapfd < 0)
+    return false;
+  push_cleanup(cu_closefd, ~ehflag_normaltidy, 1, &snapfd);
+
+  statusfd = open(statusfile, O_RDONLY);
+  if (statusfd < 0 || fstat(statusfd, &st) < 0) {
+    if (statusfd >= 0)
+      close(statusfd);
+    pop_cleanup(ehflag_normaltidy);
+    close(snapfd);
+    return false;
+  }
+  push_cleanup(cu_closefd, ~ehflag_normaltidy, 1, &statusfd);
+
+  snap_ps = parsedb_new(snapshotfile, snapfd, pdb_parse_update);
+  parsedb_load(snap_ps);
+
+  valid = snapshot_parse_header(snap_ps, &st, &generation);
+  if (valid) {
+    /* If there is a newer journal entry, the writer went away before
+     * publishing its snapshot. */
+    sprintf(updatefnrest, IMPORTANTFMT, generation);
+    if (access(updatefnbuf, F_OK) == 0 || errno != ENOENT)
+      valid = false;
+  }
+
+  if (valid) {
+    status_ps = parsedb_new(statusfile, statusfd, pdb_parse_status);
+    parsedb_load(status_ps);
+    parsedb_parse(status_ps, NULL);
+    parsedb_close(status_ps);
+
+    parsedb_parse(snap_ps, NULL);
+  }
+  parsedb_close(snap_ps);
+
+  pop_cleanup(ehflag_normaltidy);
+  close(statusfd);
+  pop_cleanup(ehflag_normaltidy);
+  close(snapfd);
+
+  return valid;
+}
+
+static void
+snapshot_remove(void)
+{
+  if (unlink(snapshotfile) < 0 && errno != ENOENT)
+    ohshite(_("cannot remove read snapshot %.255s"), snapshotfile);
+}
+
+static void
+snapshot_reset(void)
+{
+  int i;
+
+  for (i = 0; i < snapshot_nentries; i++)
+    varbuf_destroy(&snapshot_entries[i].record);
+  snapshot_nentries = 0;
+}
+
+/*
+ * Record the last journal entry for the package, keeping the entries in
+ * the order they were last written, so that replaying them is equivalent
+ * to replaying the journal.
+ */
+static void
+snapshot_note(struct pkginfo *pkg, const struct varbuf *record)
+{
+  struct snapshot_entry entry;
+  int i;
+
+  for (i = 0; i < snapshot_nentries; i++)
+    if (snapshot_entries[i].pkg == pkg)
+      break;
+
+  if (i < snapshot_nentries) {
+    entry = snapshot_entries[i];
+    memmove(&snapshot_entries[i], &snapshot_entries[i + 1],
+            (snapshot_nentries - i - 1) * sizeof(entry));
+    snapshot_nentries--;
+  } else {
+    entry.pkg = pkg;
+    varbuf_init(&entry.record, record->used);
+  }
+
+  varbuf_reset(&entry.record);
+  varbuf_add_buf(&entry.record, record->buf, record->used);
+  snapshot_entries[snapshot_nentries++] = entry;
+}
+
+/*
+ * Atomically replace the read snapshot with one covering the journal
+ * entries written so far. The snapshot is only an optimization for
+ * readers, so it does not need to be synced, and on failure we just stop
+ * publishing it, which makes readers go back to replaying the journal.
+ */
+static void
+snapshot_publish(void)
+{
+  struct stat st;
+  int fd, i;
+
+  if (snapshot_disabled)
+    return;
+
+  if (stat(statusfile, &st) < 0)
+    goto fail;
+
+  varbuf_reset(&snapshot_vb);
+  varbuf_printf(&snapshot_vb, "%s %d %d %jd %jd %jd\n",
+                SNAPSHOT_MAGIC, SNAPSHOT_FORMAT, nextupdate,
+                (intmax_t)st.st_ino, (intmax_t)st.st_size,
+                (intmax_t)st.st_mtime);
+  for (i = 0; i < snapshot_nentries; i++) {
+    if (i > 0)
+      varbuf_add_char(&snapshot_vb, '\n');
+    varbuf_add_buf(&snapshot_vb, snapshot_entries[i].record.buf,
+                   snapshot_entries[i].record.used);
+  }
+
+  fd = open(snapshottmpfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    goto fail;
+  if (fd_write(fd, snapshot_vb.buf, snapshot_vb.used) < 0) {
+    close(fd);
+    goto fail;
+  }
+  if (close(fd) < 0)
+    goto fail;
+  if (rename(snapshottmpfile, snapshotfile) < 0)
+    goto fail;
+
+  return;
+
+fail:
+  warning(_("cannot publish database read snapshot %s: %s"),
+          snapshotfile, strerror(errno));
+  (void)unlink(snapshottmpfile);
+  (void)unlink(snapshotfile);
+  snapshot_disabled = true;
+}
+
+/*
+ * Read all the journal entries into a single buffer, in order, and then
+ * replay them with a single parser context. Each entry is parsed on its
+ * own, so that parse errors refer to the entry file and its line numbers.
+ */
+static void
+journal_replay(struct dirent **cdlist, int cdn)
+{
+  struct varbuf journal = VARBUF_INIT;
+  struct parsedb_state *ps;
+  size_t *offsets;
+  int i;
+
+  offsets = m_malloc((cdn + 1) * sizeof(*offsets));
+
+  for (i = 0; i < cdn; i++) {
+    struct stat st;
+    ssize_t n;
+    int fd;
+
+    strcpy(updatefnrest, cdlist[i]->d_name);
+
+    fd = open(updatefnbuf, O_RDONLY);
+    if (fd < 0)
+      ohshite(_("failed to open package info file '%.255s' for reading"),
+              updatefnbuf);
+    push_cleanup(cu_closefd, ~ehflag_normaltidy, 1, &fd);
+
+    if (fstat(fd, &st) < 0)
+      ohshite(_("can't stat package info file '%.255s'"), updatefnbuf);
+
+    offsets[i] = journal.used;
+    varbuf_grow(&journal, st.st_size);
+    n = fd_read(fd, journal.buf + journal.used, st.st_size);
+    if (n < 0)
+      ohshite(_("reading package info file '%.255s'"), updatefnbuf);
+    journal.used += n;
+
+    pop_cleanup(ehflag_normaltidy); /* fd */
+    close(fd);
+  }
+  offsets[cdn] = journal.used;
+
+  ps = parsedb_new(updatefnbuf, -1, pdb_parse_update);
+  for (i = 0; i < cdn; i++) {
+    strcpy(updatefnrest, cdlist[i]->d_name);
+
+    ps->lno = 0;
+    parsedb_load_buf(ps, journal.buf + offsets[i], offsets[i + 1] - offsets[i]);
+    parsedb_parse(ps, NULL);
+  }
+  parsedb_close(ps);
+
+  *updatefnrest = '\0';
+
+  free(offsets);
+  varbuf_destroy(&journal);
+}
+
 static void cleanupdates(void) {
   struct dirent **cdlist;
   int cdn, i;
 
+  if (cstatus < msdbrw_write && snapshot_load())
+    return;
+
   parsedb(statusfile, pdb_parse_status, NULL);
 
   *updatefnrest = '\0';
@@ -89,12 +371,10 @@ static void cleanupdates(void) {
     ohshite(_("cannot scan updates directory '%.255s'"), updatefnbuf);
 
   if (cdn) {
-    for (i=0; i<cdn; i++) {
-      strcpy(updatefnrest, cdlist[i]->d_name);
-      parsedb(updatefnbuf, pdb_parse_update, NULL);
-    }
+    journal_replay(cdlist, cdn);
 
     if (cstatus >= msdbrw_write) {
+      snapshot_remove();
       writedb(statusfile, wdb_must_sync);
 
       for (i=0; i<cdn; i++) {
@@ -145,6 +425,8 @@ static const struct fni {
   {   AVAILFILE,                  &availablefile      },
   {   UPDATESDIR,                 &updatesdir         },
   {   UPDATESDIR IMPORTANTTMP,    &importanttmpfile   },
+  {   UPDATESDIR SNAPSHOTFILE,    &snapshotfile       },
+  {   UPDATESDIR SNAPSHOTTMP,     &snapshottmpfile    },
   {   NULL, NULL                                      }
 };
 
@@ -310,6 +592,9 @@ modstatdb_open(enum modstatdb_rw readwritereq)
   if (cstatus >= msdbrw_write) {
     createimptmp();
     varbuf_init(&uvb, 10240);
+    snapshot_entries = m_malloc((MAXUPDATES + 1) * sizeof(*snapshot_entries));
+    snapshot_nentries = 0;
+    snapshot_disabled = false;
   }
 
   trig_fixup_awaiters(cstatus);
@@ -330,6 +615,11 @@ void modstatdb_checkpoint(void) {
   if (cstatus < msdbrw_write)
     internerr("modstatdb status '%d' is not writtable", cstatus);
 
+  /* Readers must not combine the new status file with an old snapshot,
+   * they will replay the journal until we publish a new one. */
+  snapshot_remove();
+  snapshot_reset();
+
   writedb(statusfile, wdb_must_sync);
 
   for (i=0; i<nextupdate; i++) {
@@ -360,6 +650,9 @@ void modstatdb_shutdown(void) {
     fclose(importanttmp);
     (void)unlink(importanttmpfile);
     varbuf_destroy(&uvb);
+    varbuf_destroy(&snapshot_vb);
+    free(snapshot_entries);
+    snapshot_entries = NULL;
     /* Fall through. */
   case msdbrw_needsuperuserlockonly:
     modstatdb_unlock();
@@ -390,7 +683,7 @@ modstatdb_note_core(struct pkginfo *pkg)
   if (ftruncate(fileno(importanttmp), uvb.used))
     ohshite(_("unable to truncate for updated status of '%.250s'"),
             pkg_name(pkg, pnaw_nonambig));
-  if (fsync(fileno(importanttmp)))
+  if (!dpkg_db_is_sync_deferred() && fsync(fileno(importanttmp)))
     ohshite(_("unable to fsync updated status of '%.250s'"),
             pkg_name(pkg, pnaw_nonambig));
   if (fclose(importanttmp))
@@ -413,6 +706,9 @@ modstatdb_note_core(struct pkginfo *pkg)
   if (nextupdate > MAXUPDATES) {
     modstatdb_checkpoint();
     nextupdate = 0;
+  } else {
+    snapshot_note(pkg, &uvb);
+    snapshot_publish();
   }
 
   createimptmp();
@@ -32,6 +32,7 @@
 
 #include <dpkg/dpkg.h>
 #include <dpkg/i18n.h>
+#include <dpkg/dpkg-db.h>
 #include <dpkg/dir.h>
 
 /**
@@ -45,6 +46,9 @@ dir_sync(DIR *dir, const char *path)
 {
 	int fd;
 
+	if (dpkg_db_is_sync_deferred())
+		return;
+
 	fd = dirfd(dir);
 	if (fd < 0)
 		ohshite(_("unable to get file descriptor for directory '%s'"),
@@ -102,6 +106,9 @@ dir_file_sync(const char *dir, const char *filename)
 	char *path;
 	int fd;
 
+	if (dpkg_db_is_sync_deferred())
+		return;
+
 	path = str_fmt("%s/%s", dir, filename);
 
 	fd = open(path, O_WRONLY);
@@ -255,6 +255,8 @@ struct pkgset {
 const char *dpkg_db_set_dir(const char *dir);
 const char *dpkg_db_get_dir(void);
 char *dpkg_db_get_path(const char *pathpart);
+void dpkg_db_set_sync_deferred(bool deferred);
+bool dpkg_db_is_sync_deferred(void);
 
 #include <dpkg/atomic-file.h>
 
@@ -391,6 +393,9 @@ enum pkg_name_arch_when {
   pnaw_always,
 };
 
+bool pkgbin_name_needs_arch(const struct pkgbin *pkgbin,
+                            enum pkg_name_arch_when pnaw);
+
 void varbuf_add_pkgbin_name(struct varbuf *vb, const struct pkginfo *pkg,
                             const struct pkgbin *pkgbin,
                             enum pkg_name_arch_when pnaw);
@@ -84,12 +84,15 @@ DPKG_BEGIN_DECLS
 #define STATOVERRIDEFILE  "statoverride"
 #define UPDATESDIR        "updates/"
 #define INFODIR           "info"
+#define INFOPKGSDIR       "pkgs"
 #define TRIGGERSDIR       "triggers"
 #define TRIGGERSFILEFILE  "File"
 #define TRIGGERSDEFERREDFILE "Unincorp"
 #define TRIGGERSLOCKFILE  "Lock"
 #define CONTROLDIRTMP     "tmp.ci"
 #define IMPORTANTTMP      "tmp.i"
+#define SNAPSHOTFILE      "snapshot"
+#define SNAPSHOTTMP       "tmp.s"
 #define REASSEMBLETMP     "reassemble" DEBEXT
 #define IMPORTANTMAXLEN    10
 #define IMPORTANTFMT      "%04d"
@@ -99,6 +102,8 @@ DPKG_BEGIN_DECLS
 #define DEFAULTPAGER        "pager"
 
 #define MD5HASHLEN           32
+#define SHA1HASHLEN          40
+#define SHA256HASHLEN        64
 #define MAXTRIGDIRECTIVE     256
 
 #define BACKEND		"dpkg-deb"
@@ -135,6 +140,7 @@ void cu_closepipe(int argc, void **argv);
 void cu_closedir(int argc, void **argv);
 void cu_closefd(int argc, void **argv);
 void cu_filename(int argc, void **argv);
+void cu_varbuf_scratch(int argc, void **argv);
 
 /*** from mlib.c ***/
 
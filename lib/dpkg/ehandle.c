@@ -42,6 +42,10 @@ volatile int onerr_abort = 0;
 
 #define NCALLS 2
 
+/* Number of cleanup arguments stored inline, entries with up to these
+ * many arguments get recycled through the error context free list. */
+#define CLEANUP_INLINE_ARGS 4
+
 struct cleanup_entry {
   struct cleanup_entry *next;
   struct {
@@ -50,7 +54,7 @@ struct cleanup_entry {
   } calls[NCALLS];
   int cpmask, cpvalue;
   int argc;
-  void *argv[1];
+  void *argv[CLEANUP_INLINE_ARGS + 1];
 };
 
 struct error_context {
@@ -72,6 +76,7 @@ struct error_context {
   } printer;
 
   struct cleanup_entry *cleanups;
+  struct cleanup_entry *free_cleanups;
 
   char *errmsg;
 };
@@ -140,6 +145,7 @@ error_context_new(void)
     ohshite(_("out of memory for new error context"));
   necp->next= econtext;
   necp->cleanups= NULL;
+  necp->free_cleanups = NULL;
   necp->errmsg = NULL;
   econtext= necp;
 
@@ -252,6 +258,54 @@ print_cleanup_error(const char *emsg, const void *data)
   print_abort_error(_("error while cleaning up"), emsg);
 }
 
+/*
+ * The cleanup entries are pushed and popped around most per-file operations,
+ * so instead of going through the heap each time, the entries with inline
+ * arguments get recycled through a per error context free list.
+ */
+static struct cleanup_entry *
+cleanup_entry_alloc(unsigned int nargs)
+{
+  struct cleanup_entry *cep;
+  size_t size = sizeof(struct cleanup_entry);
+
+  if (nargs <= CLEANUP_INLINE_ARGS && econtext->free_cleanups) {
+    cep = econtext->free_cleanups;
+    econtext->free_cleanups = cep->next;
+    return cep;
+  }
+
+  if (nargs > CLEANUP_INLINE_ARGS)
+    size += sizeof(void *) * (nargs - CLEANUP_INLINE_ARGS);
+
+  return malloc(size);
+}
+
+static void
+cleanup_entry_release(struct error_context *econ, struct cleanup_entry *cep)
+{
+  if (cep == &emergency.ce)
+    return;
+
+  if (cep->argc <= CLEANUP_INLINE_ARGS) {
+    cep->next = econ->free_cleanups;
+    econ->free_cleanups = cep;
+  } else {
+    free(cep);
+  }
+}
+
+static void
+error_context_free_cleanups(struct error_context *econ)
+{
+  struct cleanup_entry *cep;
+
+  while ((cep = econ->free_cleanups)) {
+    econ->free_cleanups = cep->next;
+    free(cep);
+  }
+}
+
 static void
 run_cleanups(struct error_context *econ, int flagsetin)
 {
@@ -287,14 +341,16 @@ run_cleanups(struct error_context *econ, int flagsetin)
           cep->calls[i].call(cep->argc,cep->argv);
         }
         econtext= oldecontext;
+        error_context_free_cleanups(&recurserr);
       }
     }
     flagset &= cep->cpmask;
     flagset |= cep->cpvalue;
     ncep= cep->next;
-    if (cep != &emergency.ce) free(cep);
+    cleanup_entry_release(econ, cep);
     cep= ncep;
   }
+  error_context_free_cleanups(econ);
   preventrecurse--;
 }
 
@@ -311,7 +367,7 @@ void push_checkpoint(int mask, int value) {
   struct cleanup_entry *cep;
   int i;
 
-  cep = malloc(sizeof(struct cleanup_entry) + sizeof(char *));
+  cep = cleanup_entry_alloc(0);
   if (cep == NULL) {
     onerr_abort++;
     ohshite(_("out of memory for new cleanup entry"));
@@ -336,7 +392,7 @@ cleanup_entry_new(void (*call1)(int argc, void **argv), int mask1,
 
   onerr_abort++;
 
-  cep = malloc(sizeof(struct cleanup_entry) + sizeof(char *) * (nargs + 1));
+  cep = cleanup_entry_alloc(nargs);
   if (!cep) {
     if (nargs > array_count(emergency.args))
       ohshite(_("out of memory for new cleanup entry with many arguments"));
@@ -395,7 +451,7 @@ void pop_cleanup(int flagset) {
     if (cep->calls[i].call && cep->calls[i].mask & flagset)
       cep->calls[i].call(cep->argc,cep->argv);
   }
-  if (cep != &emergency.ce) free(cep);
+  cleanup_entry_release(econtext, cep);
 }
 
 /**
@@ -77,7 +77,7 @@ file_slurp_fd(int fd, const char *filename, struct varbuf *vb,
 	if (st.st_size == 0)
 		return 0;
 
-	varbuf_init(vb, st.st_size);
+	varbuf_grow(vb, st.st_size);
 	if (fd_read(fd, vb->buf, st.st_size) < 0)
 		return dpkg_put_errno(err, _("cannot read %s"), filename);
 	vb->used = st.st_size;
@@ -85,13 +85,26 @@ file_slurp_fd(int fd, const char *filename, struct varbuf *vb,
 	return 0;
 }
 
+/**
+ * Read the whole contents of a file into a varbuf.
+ *
+ * The varbuf must have been initialized, as it gets reset to reuse any
+ * storage it might already have.
+ *
+ * @param filename The filename to read.
+ * @param vb The varbuf to store the contents in.
+ * @param err The error structure to fill in on failure.
+ *
+ * @return 0 on success, -1 on error.
+ */
 int
 file_slurp(const char *filename, struct varbuf *vb, struct dpkg_error *err)
 {
 	int fd;
 	int rc;
 
-	varbuf_init(vb, 0);
+	/* Reuse any storage the varbuf might already have. */
+	varbuf_reset(vb);
 
 	fd = open(filename, O_RDONLY);
 	if (fd < 0)
@@ -52,6 +52,7 @@ filesdbinit(void)
 			fnn->oldhash = NULL;
 			fnn->newhash = EMPTYHASHFLAG;
 			fnn->file_ondisk_id = NULL;
+			fnn->file_writeback = NULL;
 		}
 	}
 }
@@ -120,7 +121,9 @@ findnamenode(const char *name, enum fnnflags flags)
 	newnode->oldhash = NULL;
 	newnode->newhash = EMPTYHASHFLAG;
 	newnode->file_ondisk_id = NULL;
+	newnode->file_writeback = NULL;
 	newnode->trig_interested = NULL;
+	newnode->file_ondisk_stat = NULL;
 	*pointerp = newnode;
 	nfiles++;
 
@@ -22,6 +22,8 @@
 #ifndef LIBDPKG_FSYS_H
 #define LIBDPKG_FSYS_H
 
+#include <sys/stat.h>
+
 #include <dpkg/file.h>
 
 /*
@@ -45,6 +47,7 @@
  */
 
 struct pkginfo;
+struct file_writeback;
 
 /**
  * Flags to findnamenode().
@@ -75,6 +78,8 @@ enum filenamenode_flags {
 	fnnf_deferred_rename		= DPKG_BIT(8),
 	/** Path being filtered. */
 	fnnf_filtered			= DPKG_BIT(9),
+	/** New file contents being written by a file writer job. */
+	fnnf_write_pending		= DPKG_BIT(10),
 };
 
 /**
@@ -85,6 +90,21 @@ struct file_ondisk_id {
 	ino_t id_ino;
 };
 
+/**
+ * Stores the cached status of an on-disk file.
+ */
+struct file_ondisk_stat {
+	/** The cache generation this entry belongs to. */
+	unsigned int generation;
+	/** Whether err and st hold the lstat() result for the pathname. */
+	bool valid;
+	/** The directory has been created anew, so it started empty. */
+	bool newdir;
+	/** The errno value if lstat() failed, or 0. */
+	int err;
+	struct stat st;
+};
+
 struct filenamenode {
 	struct filenamenode *next;
 	const char *name;
@@ -101,6 +121,9 @@ struct filenamenode {
 
 	struct trigfileint *trig_interested;
 
+	/** Cached on-disk status, only valid for its cache generation. */
+	struct file_ondisk_stat *file_ondisk_stat;
+
 	/*
 	 * Fields from here on are cleared by filesdbinit().
 	 */
@@ -114,6 +137,9 @@ struct filenamenode {
 	const char *newhash;
 
 	struct file_ondisk_id *file_ondisk_id;
+
+	/** The pending deferred fsync writeback entry, if any. */
+	struct file_writeback *file_writeback;
 };
 
 /**
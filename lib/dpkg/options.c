@@ -297,6 +297,33 @@ dpkg_options_parse_arg_int(const struct cmdinfo *cmd, const char *str)
   return value;
 }
 
+/**
+ * Parse a non-negative integer from an environment variable.
+ *
+ * @param name The environment variable name.
+ * @param def The value to use if the variable is unset or empty.
+ *
+ * @return The parsed value, or def.
+ */
+int
+dpkg_options_parse_env_int(const char *name, int def)
+{
+  const char *str;
+  long value;
+  char *end;
+
+  str = getenv(name);
+  if (str == NULL || str[0] == '\0')
+    return def;
+
+  errno = 0;
+  value = strtol(str, &end, 10);
+  if (*end || value < 0 || value > INT_MAX || errno != 0)
+    ohshit(_("invalid value '%.250s' for environment variable %s"), str, name);
+
+  return value;
+}
+
 void
 setobsolete(const struct cmdinfo *cip, const char *value)
 {
@@ -65,6 +65,7 @@ void dpkg_options_parse(const char *const **argvp,
                         const struct cmdinfo *cmdinfos, const char *help_str);
 
 long dpkg_options_parse_arg_int(const struct cmdinfo *cmd, const char *str);
+int dpkg_options_parse_env_int(const char *name, int def);
 
 struct pkginfo *
 dpkg_options_parse_pkgname(const struct cmdinfo *cmd, const char *name);
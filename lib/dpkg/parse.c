@@ -533,6 +533,7 @@ parsedb_new(const char *filename, int fd, enum parsedbflags flags)
   ps->lno = 0;
   ps->pkg = NULL;
   ps->pkgbin = NULL;
+  ps->data = ps->dataptr = ps->endptr = NULL;
 
   return ps;
 }
@@ -604,6 +605,20 @@ parsedb_load(struct parsedb_state *ps)
   ps->data = ps->dataptr;
 }
 
+/**
+ * Use a memory buffer as the data for package deb822 style parsing.
+ *
+ * The buffer is still owned by the caller, and must be kept around until
+ * the parser context has been closed.
+ */
+void
+parsedb_load_buf(struct parsedb_state *ps, char *buf, size_t size)
+{
+  ps->data = NULL;
+  ps->dataptr = buf;
+  ps->endptr = buf + size;
+}
+
 /**
  * Parse an RFC-822 style stanza.
  */
@@ -75,6 +75,8 @@ struct parsedb_state *
 parsedb_open(const char *filename, enum parsedbflags flags);
 void
 parsedb_load(struct parsedb_state *ps);
+void
+parsedb_load_buf(struct parsedb_state *ps, char *buf, size_t size);
 int
 parsedb_parse(struct parsedb_state *ps, struct pkginfo **pkgp);
 void
@@ -22,6 +22,7 @@
 #include <config.h>
 #include <compat.h>
 
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -29,6 +30,7 @@
 #include <dpkg/dpkg-db.h>
 #include <dpkg/pkg-spec.h>
 #include <dpkg/pkg-array.h>
+#include <dpkg/pkg-show.h>
 
 /**
  * Initialize a package array from package names.
@@ -101,16 +103,202 @@ pkg_array_foreach(struct pkg_array *a, pkg_array_visitor_func *pkg_visitor,
 	}
 }
 
+/*
+ * Sort key for the non-ambiguous name and architecture order. The next
+ * bytes of the name are packed in big-endian order into an integer, so that
+ * most of the ordering can be done with a radix sort on it, without having
+ * to chase any pointer.
+ */
+struct pkg_sort_key {
+	uint64_t prefix;
+	const char *name;
+	const char *arch;
+	struct pkginfo *pkg;
+	int index;
+};
+
+#define PKG_SORT_KEY_PREFIX_LEN sizeof(uint64_t)
+
+/* Runs with equal prefixes shorter than this get sorted by comparison. */
+#define PKG_SORT_KEY_RADIX_MIN 64
+
+static void
+pkg_sort_key_load(struct pkg_sort_key *key)
+{
+	const char *name = key->name;
+	size_t i;
+
+	key->prefix = 0;
+	for (i = 0; i < PKG_SORT_KEY_PREFIX_LEN; i++) {
+		key->prefix <<= 8;
+		if (*name)
+			key->prefix |= (unsigned char)*name++;
+	}
+}
+
+static void
+pkg_sort_key_init(struct pkg_sort_key *key, struct pkginfo *pkg, int index)
+{
+	key->name = pkg->set->name;
+	pkg_sort_key_load(key);
+
+	/* Packages without a qualifier sort before the qualified ones. */
+	if (pkgbin_name_needs_arch(&pkg->installed, pnaw_nonambig))
+		key->arch = pkg->installed.arch->name;
+	else
+		key->arch = NULL;
+
+	key->pkg = pkg;
+	key->index = index;
+}
+
+static bool
+pkg_sort_key_has_more(const struct pkg_sort_key *key)
+{
+	/* With equal prefixes, a name shorter than the prefix is also equal. */
+	return key->prefix & 0xff;
+}
+
+static int
+pkg_sort_key_cmp(const void *a, const void *b)
+{
+	const struct pkg_sort_key *ka = a;
+	const struct pkg_sort_key *kb = b;
+	int res;
+
+	if (ka->prefix != kb->prefix)
+		return ka->prefix < kb->prefix ? -1 : 1;
+
+	if (pkg_sort_key_has_more(ka)) {
+		res = strcmp(ka->name + PKG_SORT_KEY_PREFIX_LEN,
+		             kb->name + PKG_SORT_KEY_PREFIX_LEN);
+		if (res)
+			return res;
+	}
+
+	if (ka->pkg->installed.arch != kb->pkg->installed.arch) {
+		if (ka->arch == NULL && kb->arch != NULL)
+			return -1;
+		if (ka->arch != NULL && kb->arch == NULL)
+			return 1;
+		if (ka->arch != NULL && kb->arch != NULL)
+			return strcmp(ka->arch, kb->arch);
+	}
+
+	/* Keep the sort stable for otherwise equal keys. */
+	return ka->index - kb->index;
+}
+
+static void
+pkg_sort_key_radix(struct pkg_sort_key *keys, struct pkg_sort_key *tmp, int n)
+{
+	struct pkg_sort_key *src = keys, *dst = tmp;
+	size_t shift;
+
+	/* A least significant digit radix sort, one byte per pass. */
+	for (shift = 0; shift < PKG_SORT_KEY_PREFIX_LEN * 8; shift += 8) {
+		struct pkg_sort_key *swap;
+		int count[256] = { 0 };
+		int i, sum;
+
+		for (i = 0; i < n; i++)
+			count[(src[i].prefix >> shift) & 0xff]++;
+
+		/* Skip the pass when all keys have the same byte. */
+		if (count[(src[0].prefix >> shift) & 0xff] == n)
+			continue;
+
+		for (sum = 0, i = 0; i < 256; i++) {
+			int c = count[i];
+
+			count[i] = sum;
+			sum += c;
+		}
+		for (i = 0; i < n; i++)
+			dst[count[(src[i].prefix >> shift) & 0xff]++] = src[i];
+
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != keys)
+		memcpy(keys, src, sizeof(keys[0]) * n);
+}
+
+static void
+pkg_sort_keys(struct pkg_sort_key *keys, struct pkg_sort_key *tmp, int n)
+{
+	int i, j, k;
+
+	pkg_sort_key_radix(keys, tmp, n);
+
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n; j++)
+			if (keys[j].prefix != keys[i].prefix)
+				break;
+		if (j - i < 2)
+			continue;
+
+		/* Large runs, from names sharing long prefixes, get sorted
+		 * on the next name bytes, the rest by comparison. */
+		if (j - i >= PKG_SORT_KEY_RADIX_MIN &&
+		    pkg_sort_key_has_more(&keys[i])) {
+			for (k = i; k < j; k++) {
+				keys[k].name += PKG_SORT_KEY_PREFIX_LEN;
+				pkg_sort_key_load(&keys[k]);
+			}
+			pkg_sort_keys(&keys[i], &tmp[i], j - i);
+		} else {
+			qsort(&keys[i], j - i, sizeof(keys[0]),
+			      pkg_sort_key_cmp);
+		}
+	}
+}
+
+/*
+ * Sort the array by non-ambiguous name and architecture, computing the sort
+ * keys once per package instead of on each comparison.
+ */
+static void
+pkg_array_sort_keyed(struct pkg_array *a)
+{
+	struct pkg_sort_key *keys;
+	int i;
+
+	if (a->n_pkgs < 2)
+		return;
+
+	keys = m_malloc(sizeof(keys[0]) * a->n_pkgs * 2);
+
+	for (i = 0; i < a->n_pkgs; i++)
+		pkg_sort_key_init(&keys[i], a->pkgs[i], i);
+
+	pkg_sort_keys(keys, keys + a->n_pkgs, a->n_pkgs);
+
+	for (i = 0; i < a->n_pkgs; i++)
+		a->pkgs[i] = keys[i].pkg;
+
+	free(keys);
+}
+
 /**
  * Sort a package array.
  *
+ * The pkg_sorter_by_nonambig_name_arch() order, used for most user visible
+ * listings, gets sorted with precomputed keys, any other order uses the
+ * sorter function directly.
+ *
  * @param a The array to sort.
  * @param pkg_sort The function to sort the array.
  */
 void
 pkg_array_sort(struct pkg_array *a, pkg_sorter_func *pkg_sort)
 {
-	qsort(a->pkgs, a->n_pkgs, sizeof(a->pkgs[0]), pkg_sort);
+	if (pkg_sort == pkg_sorter_by_nonambig_name_arch)
+		pkg_array_sort_keyed(a);
+	else
+		qsort(a->pkgs, a->n_pkgs, sizeof(a->pkgs[0]), pkg_sort);
 }
 
 /**
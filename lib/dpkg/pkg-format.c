@@ -335,7 +335,13 @@ pkg_format_show(const struct pkg_format_node *head,
                 struct pkginfo *pkg, struct pkgbin *pkgbin)
 {
 	const struct pkg_format_node *node;
-	struct varbuf vb = VARBUF_INIT, fb = VARBUF_INIT, wb = VARBUF_INIT;
+	struct varbuf vb, fb, wb;
+	char vb_inline[1024], fb_inline[256], wb_inline[256];
+
+	/* This gets called for each package, avoid the heap when possible. */
+	varbuf_init_inline(&vb, vb_inline, sizeof(vb_inline));
+	varbuf_init_inline(&fb, fb_inline, sizeof(fb_inline));
+	varbuf_init_inline(&wb, wb_inline, sizeof(wb_inline));
 
 	for (node = head; node; node = node->next) {
 		bool ok;
@@ -387,7 +393,7 @@ pkg_format_show(const struct pkg_format_node *head,
 		varbuf_reset(&fb);
 	}
 
-	if (vb.buf) {
+	if (vb.used) {
 		varbuf_end_str(&vb);
 		fputs(vb.buf, stdout);
 	}
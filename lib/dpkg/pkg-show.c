@@ -30,7 +30,15 @@
 #include <dpkg/dpkg-db.h>
 #include <dpkg/pkg-show.h>
 
-static bool
+/**
+ * Return whether the package name needs an architecture qualifier.
+ *
+ * @param pkgbin  The binary package instance to consider.
+ * @param pnaw    When to display the architecture qualifier.
+ *
+ * @return Whether the architecture qualifier is needed.
+ */
+bool
 pkgbin_name_needs_arch(const struct pkgbin *pkgbin,
                        enum pkg_name_arch_when pnaw)
 {
@@ -320,6 +328,9 @@ pkg_priority_name(const struct pkginfo *pkg)
 /**
  * Compare a package to be sorted by non-ambiguous name and architecture.
  *
+ * When passed to pkg_array_sort(), the sort keys get precomputed instead,
+ * so any change here needs to be reflected in pkg_array_sort_keyed().
+ *
  * @param a A pointer of a pointer to a struct pkginfo.
  * @param b A pointer of a pointer to a struct pkginfo.
  *
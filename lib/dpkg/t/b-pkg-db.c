@@ -0,0 +1,547 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * b-pkg-db.c - benchmark package database scaling
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/ehandle.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/clock.h>
+#include <dpkg/options.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/arch.h>
+#include <dpkg/pkg-array.h>
+#include <dpkg/pkg-format.h>
+#include <dpkg/pkg-show.h>
+#include <dpkg/db-fsys.h>
+
+/*
+ * The benchmark generates a synthetic admin directory, and then times the
+ * main package database operations on it. The shape of the database can be
+ * controlled with these environment variables:
+ *
+ *   BENCH_ADMINDIR	  admin directory to generate (default: b-pkg-db.tmp)
+ *   BENCH_PACKAGES	  number of installed packages (default: 5000)
+ *   BENCH_FILES	  number of files per package (default: 20)
+ *   BENCH_DEPENDS	  number of dependencies per package (default: 4)
+ *   BENCH_DIVERSIONS	  number of diversions (default: 100)
+ *   BENCH_TRIGGERS	  number of file trigger interests (default: 100)
+ *   BENCH_NOTES	  number of status changes to record (default: 500)
+ *   BENCH_SORT_ENTRIES	  number of package array entries to sort (default: 100000)
+ *
+ * The results are printed one per line, as space separated key=value
+ * pairs, so that they can be easily tracked across versions.
+ */
+
+struct bench_params {
+	const char *admindir;
+	int packages;
+	int files;
+	int depends;
+	int diversions;
+	int triggers;
+	int notes;
+	int sort_entries;
+};
+
+static struct timespec bench_start;
+
+static void
+bench_begin(void)
+{
+	dpkg_clock_get_monotonic(&bench_start);
+}
+
+static void
+bench_end(const char *phase, long items)
+{
+	struct timespec now;
+	double elapsed;
+
+	dpkg_clock_get_monotonic(&now);
+	elapsed = dpkg_clock_elapsed(&bench_start, &now);
+
+	printf("bench=pkg-db phase=%s seconds=%.6f items=%ld items_per_second=%.0f\n",
+	       phase, elapsed, items, elapsed > 0 ? items / elapsed : 0.0);
+}
+
+/*
+ * Deterministic pseudo-random number generator, so that runs with the
+ * same parameters produce the same database.
+ */
+static unsigned long bench_seed = 1;
+
+static int
+bench_random(int max)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+
+	return (bench_seed / 65536) % max;
+}
+
+static FILE *
+bench_fopen(const char *admindir, const char *name)
+{
+	char *filename;
+	FILE *fp;
+
+	filename = str_fmt("%s/%s", admindir, name);
+	fp = fopen(filename, "w");
+	if (fp == NULL)
+		ohshite("cannot create '%s'", filename);
+	free(filename);
+
+	return fp;
+}
+
+static void
+bench_fclose(FILE *fp)
+{
+	if (ferror(fp) || fclose(fp))
+		ohshite("cannot write benchmark file");
+}
+
+static void
+bench_mkdir(const char *admindir, const char *name)
+{
+	char *dirname;
+
+	dirname = str_fmt("%s/%s", admindir, name);
+	if (mkdir(dirname, 0755) < 0 && errno != EEXIST)
+		ohshite("cannot create directory '%s'", dirname);
+	free(dirname);
+}
+
+static void
+bench_gen_status(struct bench_params *bp)
+{
+	FILE *fp;
+	int i, d;
+
+	fp = bench_fopen(bp->admindir, STATUSFILE);
+
+	for (i = 0; i < bp->packages; i++) {
+		fprintf(fp, "Package: pkg%06d\n", i);
+		fprintf(fp, "Status: install ok installed\n");
+		fprintf(fp, "Priority: optional\n");
+		fprintf(fp, "Section: misc\n");
+		fprintf(fp, "Installed-Size: %d\n", 4 * bp->files + 1);
+		fprintf(fp, "Maintainer: Dpkg Developers <debian-dpkg@lists.debian.org>\n");
+		fprintf(fp, "Architecture: all\n");
+		fprintf(fp, "Version: %d.%d-%d\n", i % 7, i % 13, i % 3 + 1);
+
+		if (bp->depends && bp->packages > 1) {
+			fprintf(fp, "Depends: ");
+			for (d = 0; d < bp->depends; d++) {
+				int dep = bench_random(bp->packages);
+
+				if (d)
+					fprintf(fp, ", ");
+				if (d % 3 == 1)
+					fprintf(fp, "pkg%06d (>= 0.0-1)", dep);
+				else if (d % 3 == 2)
+					fprintf(fp, "pkg%06d | virt%06d", dep, dep);
+				else
+					fprintf(fp, "pkg%06d", dep);
+			}
+			fprintf(fp, "\n");
+		}
+		if (i % 10 == 0)
+			fprintf(fp, "Conffiles:\n"
+			        " /etc/bench/pkg%06d.conf "
+			        "0123456789abcdef0123456789abcdef\n", i);
+		fprintf(fp, "Description: synthetic package %d\n"
+		        " This is a synthetic package generated for benchmarking\n"
+		        " the package database.\n", i);
+		fprintf(fp, "\n");
+	}
+
+	bench_fclose(fp);
+}
+
+static void
+bench_gen_filelists(struct bench_params *bp)
+{
+	int i, f;
+
+	for (i = 0; i < bp->packages; i++) {
+		char *name;
+		FILE *fp;
+
+		name = str_fmt("%s/pkg%06d.%s", INFODIR, i, LISTFILE);
+		fp = bench_fopen(bp->admindir, name);
+		free(name);
+
+		fprintf(fp, "/.\n/usr\n/usr/share\n/usr/share/bench\n");
+		fprintf(fp, "/usr/share/bench/pkg%06d\n", i);
+		for (f = 0; f < bp->files; f++)
+			fprintf(fp, "/usr/share/bench/pkg%06d/file-%d\n", i, f);
+		if (i % 10 == 0)
+			fprintf(fp, "/etc\n/etc/bench\n/etc/bench/pkg%06d.conf\n", i);
+
+		bench_fclose(fp);
+	}
+}
+
+static void
+bench_gen_diversions(struct bench_params *bp)
+{
+	FILE *fp;
+	int i;
+
+	fp = bench_fopen(bp->admindir, DIVERSIONSFILE);
+
+	for (i = 0; i < bp->diversions && bp->packages; i++) {
+		int pkg = i % bp->packages;
+		int file = i / bp->packages;
+
+		fprintf(fp, "/usr/share/bench/pkg%06d/file-%d\n", pkg, file);
+		fprintf(fp, "/usr/share/bench/pkg%06d/file-%d.distrib\n",
+		        pkg, file);
+		if (i % 2)
+			fprintf(fp, ":\n");
+		else
+			fprintf(fp, "pkg%06d\n", (pkg + 1) % bp->packages);
+	}
+
+	bench_fclose(fp);
+}
+
+static void
+bench_gen_triggers(struct bench_params *bp)
+{
+	FILE *fp;
+	int i;
+
+	fp = bench_fopen(bp->admindir, TRIGGERSDIR "/" TRIGGERSFILEFILE);
+
+	for (i = 0; i < bp->triggers && bp->packages; i++)
+		fprintf(fp, "/usr/share/bench/trigger-%d pkg%06d%s\n", i,
+		        bench_random(bp->packages), i % 2 ? "/noawait" : "");
+
+	bench_fclose(fp);
+}
+
+static void
+bench_generate(struct bench_params *bp)
+{
+	if (mkdir(bp->admindir, 0755) < 0 && errno != EEXIST)
+		ohshite("cannot create directory '%s'", bp->admindir);
+	bench_mkdir(bp->admindir, INFODIR);
+	bench_mkdir(bp->admindir, UPDATESDIR);
+	bench_mkdir(bp->admindir, TRIGGERSDIR);
+
+	bench_begin();
+	bench_gen_status(bp);
+	bench_gen_filelists(bp);
+	bench_gen_diversions(bp);
+	bench_gen_triggers(bp);
+	bench_end("generate", bp->packages);
+}
+
+static void
+bench_parsedb(struct bench_params *bp)
+{
+	char *statusfile;
+	int n;
+
+	statusfile = dpkg_db_get_path(STATUSFILE);
+
+	pkg_db_reset();
+	bench_begin();
+	n = parsedb(statusfile, pdb_parse_status, NULL);
+	bench_end("parsedb", n);
+
+	free(statusfile);
+}
+
+static void
+bench_filelists(struct bench_params *bp)
+{
+	bench_begin();
+	ensure_diversions();
+	bench_end("diversions", bp->diversions);
+
+	bench_begin();
+	ensure_allinstfiles_available_quiet();
+	bench_end("filelists", fsys_hash_entries());
+}
+
+static void
+bench_depends(struct bench_params *bp)
+{
+	struct pkgiterator *iter;
+	struct pkginfo *pkg;
+	long checks = 0;
+	long satisfied = 0;
+
+	bench_begin();
+	iter = pkg_db_iter_new();
+	while ((pkg = pkg_db_iter_next_pkg(iter))) {
+		struct dependency *dep;
+
+		for (dep = pkg->installed.depends; dep; dep = dep->next) {
+			struct deppossi *possi;
+
+			for (possi = dep->list; possi; possi = possi->next) {
+				struct pkginfo *dpkg;
+
+				checks++;
+				for (dpkg = &possi->ed->pkg; dpkg; dpkg = dpkg->arch_next) {
+					if (dpkg->status != PKG_STAT_INSTALLED)
+						continue;
+					if (!versionsatisfied(&dpkg->installed, possi))
+						continue;
+					if (!archsatisfied(&dpkg->installed, possi))
+						continue;
+					satisfied++;
+					break;
+				}
+			}
+		}
+	}
+	pkg_db_iter_free(iter);
+	bench_end("depends", checks);
+
+	if (satisfied == 0 && checks > 0)
+		ohshit("no dependency satisfied, the database is bogus");
+}
+
+static const char *const bench_formats[] = {
+	"${binary:Package}\t${Version}\n",
+	"${db:Status-Abbrev} ${binary:Package;-30} ${Version;-20} "
+	"${Architecture;-12} ${binary:Summary}\n",
+	NULL,
+};
+
+static void
+bench_formats_show(struct bench_params *bp)
+{
+	struct pkg_array array;
+	const char *const *fmt;
+	int fd_stdout, fd_null;
+	long items = 0;
+	int i;
+
+	/* Discard the formatted output, we only care about the timing. */
+	m_output(stdout, "<standard output>");
+	fd_stdout = m_dup(1);
+	fd_null = open("/dev/null", O_WRONLY);
+	if (fd_null < 0)
+		ohshite("cannot open /dev/null");
+	m_dup2(fd_null, 1);
+	close(fd_null);
+
+	bench_begin();
+	for (fmt = bench_formats; *fmt; fmt++) {
+		struct pkg_format_node *head;
+		struct dpkg_error err;
+
+		head = pkg_format_parse(*fmt, &err);
+		if (head == NULL)
+			ohshit("cannot parse format: %s", err.str);
+
+		pkg_array_init_from_db(&array);
+		pkg_array_sort(&array, pkg_sorter_by_nonambig_name_arch);
+		for (i = 0; i < array.n_pkgs; i++)
+			pkg_format_show(head, array.pkgs[i],
+			                &array.pkgs[i]->installed);
+		items += array.n_pkgs;
+		pkg_array_destroy(&array);
+
+		pkg_format_free(head);
+	}
+	m_output(stdout, "<standard output>");
+
+	m_dup2(fd_stdout, 1);
+	close(fd_stdout);
+
+	bench_end("formats", items);
+}
+
+static void
+bench_writedb(struct bench_params *bp)
+{
+	char *filename;
+
+	filename = dpkg_db_get_path(STATUSFILE "-bench");
+
+	bench_begin();
+	writedb(filename, wdb_must_sync);
+	bench_end("writedb", pkg_db_count_pkg());
+
+	if (unlink(filename) < 0)
+		ohshite("cannot remove '%s'", filename);
+	free(filename);
+}
+
+static void
+bench_notes(struct bench_params *bp)
+{
+	struct pkg_array array;
+	int i;
+
+	pkg_db_reset();
+	files_db_reset();
+
+	bench_begin();
+	modstatdb_open(msdbrw_write);
+	bench_end("open-write", pkg_db_count_pkg());
+
+	pkg_array_init_from_db(&array);
+
+	bench_begin();
+	for (i = 0; i < bp->notes && array.n_pkgs; i++) {
+		struct pkginfo *pkg = array.pkgs[i % array.n_pkgs];
+
+		pkg_set_status(pkg, PKG_STAT_HALFCONFIGURED);
+		modstatdb_note(pkg);
+		pkg_set_status(pkg, PKG_STAT_INSTALLED);
+		modstatdb_note(pkg);
+	}
+	bench_end("notes", 2L * i);
+
+	pkg_array_destroy(&array);
+
+	bench_begin();
+	modstatdb_shutdown();
+	bench_end("shutdown", 1);
+}
+
+static const char *const bench_sort_prefixes[] = {
+	"lib", "libreoffice-", "python3-", "golang-github-", "fonts-", "x",
+};
+
+static void
+bench_sort_shuffle(struct pkg_array *array)
+{
+	int i;
+
+	for (i = array->n_pkgs - 1; i > 0; i--) {
+		struct pkginfo *pkg;
+		int j = bench_random(i + 1);
+
+		pkg = array->pkgs[i];
+		array->pkgs[i] = array->pkgs[j];
+		array->pkgs[j] = pkg;
+	}
+}
+
+static void
+bench_sort(struct bench_params *bp)
+{
+	const int rounds = 5;
+	const int n_prefixes = array_count(bench_sort_prefixes);
+	struct dpkg_arch *arch_native, *arch_foreign;
+	struct pkg_array array;
+	int i;
+
+	/* Sorting needs way more entries than is sensible to parse. */
+	pkg_db_reset();
+
+	arch_native = dpkg_arch_get(DPKG_ARCH_NATIVE);
+	arch_foreign = dpkg_arch_find("bench-foreign");
+	for (i = 0; pkg_db_count_pkg() < bp->sort_entries; i++) {
+		const char *prefix;
+		struct pkginfo *pkg;
+		char *name;
+
+		prefix = bench_sort_prefixes[bench_random(n_prefixes)];
+		name = str_fmt("%s%d", prefix, bench_random(bp->sort_entries));
+		pkg = pkg_db_find_pkg(name, arch_native);
+		if (i % 10 == 0) {
+			pkg->installed.multiarch = PKG_MULTIARCH_SAME;
+			pkg = pkg_db_find_pkg(name, arch_foreign);
+			pkg->installed.multiarch = PKG_MULTIARCH_SAME;
+		}
+		free(name);
+	}
+
+	pkg_array_init_from_db(&array);
+
+	bench_begin();
+	for (i = 0; i < rounds; i++) {
+		bench_sort_shuffle(&array);
+		qsort(array.pkgs, array.n_pkgs, sizeof(array.pkgs[0]),
+		      pkg_sorter_by_nonambig_name_arch);
+	}
+	bench_end("sort-qsort", (long)rounds * array.n_pkgs);
+
+	bench_begin();
+	for (i = 0; i < rounds; i++) {
+		bench_sort_shuffle(&array);
+		pkg_array_sort(&array, pkg_sorter_by_nonambig_name_arch);
+	}
+	bench_end("sort", (long)rounds * array.n_pkgs);
+
+	pkg_array_destroy(&array);
+	pkg_db_reset();
+}
+
+int
+main(int argc, char **argv)
+{
+	struct bench_params bp;
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	push_error_context();
+
+	bp.admindir = getenv("BENCH_ADMINDIR");
+	if (bp.admindir == NULL)
+		bp.admindir = "b-pkg-db.tmp";
+	bp.packages = dpkg_options_parse_env_int("BENCH_PACKAGES", 5000);
+	bp.files = dpkg_options_parse_env_int("BENCH_FILES", 20);
+	bp.depends = dpkg_options_parse_env_int("BENCH_DEPENDS", 4);
+	bp.diversions = dpkg_options_parse_env_int("BENCH_DIVERSIONS", 100);
+	bp.triggers = dpkg_options_parse_env_int("BENCH_TRIGGERS", 100);
+	bp.notes = dpkg_options_parse_env_int("BENCH_NOTES", 500);
+	bp.sort_entries = dpkg_options_parse_env_int("BENCH_SORT_ENTRIES", 100000);
+
+	printf("bench=pkg-db packages=%d files=%d depends=%d diversions=%d "
+	       "triggers=%d notes=%d sort_entries=%d\n", bp.packages, bp.files,
+	       bp.depends, bp.diversions, bp.triggers, bp.notes,
+	       bp.sort_entries);
+
+	dpkg_db_set_dir(bp.admindir);
+
+	bench_generate(&bp);
+	bench_parsedb(&bp);
+	bench_filelists(&bp);
+	bench_depends(&bp);
+	bench_formats_show(&bp);
+	bench_writedb(&bp);
+	bench_notes(&bp);
+	bench_sort(&bp);
+
+	pop_error_context(ehflag_normaltidy);
+
+	return 0;
+}
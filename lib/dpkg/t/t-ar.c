@@ -21,7 +21,11 @@
 #include <config.h>
 #include <compat.h>
 
+#include <sys/types.h>
+
 #include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include <dpkg/test.h>
 #include <dpkg/ar.h>
@@ -52,10 +56,52 @@ test_ar_member_is_illegal(void)
 	test_fail(dpkg_ar_member_is_illegal(&arh));
 }
 
+static void
+test_ar_member_begin_end(void)
+{
+	struct dpkg_ar *ar;
+	struct dpkg_ar_member member;
+	struct dpkg_ar_hdr arh;
+	char *test_file;
+	char buf[8];
+	int fd;
+
+	test_file = test_alloc(strdup("test.XXXXXX"));
+	fd = mkstemp(test_file);
+	test_pass(fd >= 0);
+
+	ar = dpkg_ar_fdopen(test_file, fd);
+	dpkg_ar_set_mtime(ar, 0);
+	dpkg_ar_put_magic(ar);
+
+	/* Write an odd sized member, without knowing its size beforehand. */
+	dpkg_ar_member_begin(ar, &member, "member");
+	test_pass(member.offset == strlen(DPKG_AR_MAGIC));
+	test_pass(write(ar->fd, "12345", 5) == 5);
+	dpkg_ar_member_end(ar, &member);
+	test_pass(member.size == 5);
+	test_pass(lseek(ar->fd, 0, SEEK_CUR) ==
+	          (off_t)(strlen(DPKG_AR_MAGIC) + sizeof(arh) + 6));
+
+	/* Read back the patched header. */
+	test_pass(pread(ar->fd, &arh, sizeof(arh), member.offset) ==
+	          sizeof(arh));
+	test_fail(dpkg_ar_member_is_illegal(&arh));
+	test_pass(dpkg_ar_member_get_size(ar, &arh) == 5);
+	dpkg_ar_normalize_name(&arh);
+	test_mem(arh.ar_name, ==, "member", 6);
+	test_pass(pread(ar->fd, buf, 6, member.offset + sizeof(arh)) == 6);
+	test_mem(buf, ==, "12345\n", 6);
+
+	dpkg_ar_close(ar);
+	test_pass(unlink(test_file) == 0);
+}
+
 TEST_ENTRY(test)
 {
-	test_plan(4);
+	test_plan(16);
 
 	test_ar_normalize_name();
 	test_ar_member_is_illegal();
+	test_ar_member_begin_end();
 }
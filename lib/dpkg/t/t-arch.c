@@ -123,6 +123,10 @@ test_dpkg_arch_reset_list(void)
 	dpkg_arch_reset_list();
 
 	test_dpkg_arch_get_list();
+
+	/* The lookups still work after a reset. */
+	test_pass(dpkg_arch_find("foobar") == dpkg_arch_find("foobar"));
+	test_pass(dpkg_arch_find("all") == dpkg_arch_get(DPKG_ARCH_ALL));
 }
 
 static void
@@ -211,7 +215,7 @@ test_dpkg_arch_describe(void)
 
 TEST_ENTRY(test)
 {
-	test_plan(60);
+	test_plan(62);
 
 	test_dpkg_arch_name_is_illegal();
 	test_dpkg_arch_get_list();
@@ -27,14 +27,21 @@
 
 #include <sys/types.h>
 
+#include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 
 static const char str_empty[] = "";
 static const char ref_hash_empty[] = "d41d8cd98f00b204e9800998ecf8427e";
+static const char ref_sha1_empty[] = "da39a3ee5e6b4b0d3255bfef95601890afd80709";
+static const char ref_sha256_empty[] =
+	"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
 static const char str_test[] = "this is a test string\n";
 static const char ref_hash_test[] = "475aae3b885d70a9130eec23ab33f2b9";
+static const char ref_sha1_test[] = "552059c2fff2559a4048d7222ee25c0335f7dc2d";
+static const char ref_sha256_test[] =
+	"6102e76cb0b1c6f0e8ac9a1f38a093db285ae3b35c086b39eefb9a5b506c693d";
 
 static void
 test_buffer_hash(void)
@@ -48,6 +55,24 @@ test_buffer_hash(void)
 	test_str(hash, ==, ref_hash_test);
 }
 
+static void
+test_buffer_sha(void)
+{
+	char hash[SHA256HASHLEN + 1];
+
+	buffer_sha1(str_empty, hash, strlen(str_empty));
+	test_str(hash, ==, ref_sha1_empty);
+
+	buffer_sha1(str_test, hash, strlen(str_test));
+	test_str(hash, ==, ref_sha1_test);
+
+	buffer_sha256(str_empty, hash, strlen(str_empty));
+	test_str(hash, ==, ref_sha256_empty);
+
+	buffer_sha256(str_test, hash, strlen(str_test));
+	test_str(hash, ==, ref_sha256_test);
+}
+
 static void
 test_fdio_hash(void)
 {
@@ -71,10 +96,64 @@ test_fdio_hash(void)
 	test_pass(unlink(test_file) == 0);
 }
 
+static void
+test_fdio_digests(void)
+{
+	char md5[MD5HASHLEN + 1];
+	char sha1[SHA1HASHLEN + 1];
+	char sha256[SHA256HASHLEN + 1];
+	struct buffer_digests digests = {
+		.md5 = md5,
+		.sha1 = sha1,
+		.sha256 = sha256,
+	};
+	char *test_file;
+	char *buf;
+	size_t len = 100000;
+	int fd;
+
+	test_file = test_alloc(strdup("test.XXXXXX"));
+	fd = mkstemp(test_file);
+	test_pass(fd >= 0);
+
+	test_pass(fd_digests(fd, &digests, -1, NULL) == 0);
+	test_str(md5, ==, ref_hash_empty);
+	test_str(sha1, ==, ref_sha1_empty);
+	test_str(sha256, ==, ref_sha256_empty);
+
+	/* Use a size spanning several read and digest blocks. */
+	buf = test_alloc(malloc(len));
+	memset(buf, 'a', len);
+	test_pass(write(fd, buf, len) == (ssize_t)len);
+	test_pass(lseek(fd, 0, SEEK_SET) == 0);
+	free(buf);
+
+	test_pass(fd_digests(fd, &digests, -1, NULL) == (off_t)len);
+	test_str(md5, ==, "1af6d6f2f682f76f80e606aeaaee1680");
+	test_str(sha1, ==, "c4d4b30851182fc4eb8675494d42fd7f17e29c93");
+	test_str(sha256, ==,
+	         "6d1cf22d7cc09b085dfc25ee1a1f3ae0265804c607bc2074ad253bcc82fd81ee");
+
+	/* Digests not requested are left alone. */
+	test_pass(lseek(fd, 0, SEEK_SET) == 0);
+	strcpy(md5, "unset");
+	digests.md5 = NULL;
+	digests.sha1 = NULL;
+	test_pass(fd_digests(fd, &digests, -1, NULL) == (off_t)len);
+	test_str(md5, ==, "unset");
+	test_str(sha256, ==,
+	         "6d1cf22d7cc09b085dfc25ee1a1f3ae0265804c607bc2074ad253bcc82fd81ee");
+
+	test_pass(unlink(test_file) == 0);
+	free(test_file);
+}
+
 TEST_ENTRY(test)
 {
-	test_plan(10);
+	test_plan(30);
 
 	test_buffer_hash();
+	test_buffer_sha();
 	test_fdio_hash();
+	test_fdio_digests();
 }
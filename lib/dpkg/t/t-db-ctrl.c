@@ -0,0 +1,255 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * t-db-ctrl.c - test package control information database
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <dpkg/test.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/string.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/db-ctrl.h>
+
+static char *test_dir;
+static struct varbuf test_seen = VARBUF_INIT;
+
+static void
+test_touch(const char *name)
+{
+	char *filename;
+	int fd;
+
+	filename = test_alloc(str_fmt("%s/info/%s", test_dir, name));
+	fd = creat(filename, 0644);
+	test_pass(fd >= 0);
+	close(fd);
+	free(filename);
+}
+
+static void
+test_unlink(const char *name)
+{
+	char *filename;
+
+	filename = test_alloc(str_fmt("%s/info/%s", test_dir, name));
+	test_pass(unlink(filename) == 0);
+	free(filename);
+}
+
+static void
+test_foreach_file(const char *filename, const char *filetype)
+{
+	const char *basename = strrchr(filename, '/') + 1;
+
+	/* Make sure the filename and filetype match up. */
+	if (strcmp(basename + strlen(basename) - strlen(filetype), filetype))
+		test_bail("filename does not match filetype");
+
+	varbuf_add_char(&test_seen, '<');
+	varbuf_add_str(&test_seen, filetype);
+	varbuf_add_char(&test_seen, '>');
+}
+
+/* The order is unspecified, so just count the types and check each one. */
+static int
+test_foreach(struct pkginfo *pkg)
+{
+	const char *p;
+	int n = 0;
+
+	varbuf_reset(&test_seen);
+	varbuf_end_str(&test_seen);
+	pkg_infodb_foreach(pkg, &pkg->installed, test_foreach_file);
+	varbuf_end_str(&test_seen);
+
+	for (p = test_seen.buf; p && *p; p++)
+		if (*p == '<')
+			n++;
+
+	return n;
+}
+
+static bool
+test_foreach_has(const char *filetype)
+{
+	char *needle;
+	bool found;
+
+	needle = test_alloc(str_fmt("<%s>", filetype));
+	found = strstr(test_seen.buf, needle) != NULL;
+	free(needle);
+
+	return found;
+}
+
+static void
+test_db_ctrl_index(void)
+{
+	struct pkginfo *pkg;
+
+	test_touch("pkg.list");
+	test_touch("pkg.postinst");
+	test_touch("pkg.md5sums");
+	test_touch("pkg-other.list");
+	test_touch("pkg.name.list");
+	test_touch(".pkg.hidden");
+	test_touch("pkg");
+
+	pkg = pkg_db_find_singleton("pkg");
+
+	test_pass(test_foreach(pkg) == 3);
+	test_pass(test_foreach_has("list"));
+	test_pass(test_foreach_has("postinst"));
+	test_pass(test_foreach_has("md5sums"));
+
+	/* Additions and removals get recorded. */
+	test_touch("pkg.prerm");
+	pkg_infodb_index_add_file(pkg_infodb_get_file(pkg, &pkg->installed,
+	                                              "prerm"));
+	test_unlink("pkg.postinst");
+	pkg_infodb_index_remove_file(pkg_infodb_get_file(pkg, &pkg->installed,
+	                                                 "postinst"));
+	test_pass(test_foreach(pkg) == 3);
+	test_pass(test_foreach_has("prerm"));
+	test_pass(!test_foreach_has("postinst"));
+
+	/* Adding twice does not duplicate entries. */
+	pkg_infodb_index_add_file(pkg_infodb_get_file(pkg, &pkg->installed,
+	                                              "prerm"));
+	test_pass(test_foreach(pkg) == 3);
+
+	/* Removing the last file of a package leaves nothing behind. */
+	pkg = pkg_db_find_singleton("pkg.name");
+	test_pass(test_foreach(pkg) == 1);
+	test_unlink("pkg.name.list");
+	pkg_infodb_index_remove_file(pkg_infodb_get_file(pkg, &pkg->installed,
+	                                                 "list"));
+	test_pass(test_foreach(pkg) == 0);
+
+	/* Changes behind our back are only seen after a reset. */
+	pkg = pkg_db_find_singleton("pkg-other");
+	test_touch("pkg-other.conffiles");
+	test_pass(test_foreach(pkg) == 1);
+	pkg_infodb_index_reset();
+	test_pass(test_foreach(pkg) == 2);
+
+	test_unlink("pkg-other.conffiles");
+	test_unlink("pkg-other.list");
+	test_unlink("pkg.list");
+	test_unlink("pkg.prerm");
+	test_unlink("pkg.md5sums");
+	test_unlink(".pkg.hidden");
+	test_unlink("pkg");
+}
+
+static void
+test_db_ctrl_hierarchical(void)
+{
+	struct pkginfo *pkg;
+	struct stat st;
+	char *filename;
+
+	pkg_infodb_set_format(PKG_INFODB_FORMAT_HIERARCHICAL);
+
+	pkg = pkg_db_find_singleton("pkg-hier");
+
+	filename = test_alloc(str_fmt("%s/info/pkgs/pkg-hier/list", test_dir));
+	test_str(pkg_infodb_get_file(pkg, &pkg->installed, "list"), ==,
+	         filename);
+	free(filename);
+	filename = test_alloc(str_fmt("%s/info/pkgs/pkg-hier", test_dir));
+	test_str(pkg_infodb_get_pkgdir(pkg, &pkg->installed), ==, filename);
+
+	/* A package without a directory has no files. */
+	test_pass(test_foreach(pkg) == 0);
+	pkg_infodb_sync_pkgdir(pkg, &pkg->installed);
+	pkg_infodb_remove_pkgdir(pkg, &pkg->installed);
+
+	pkg_infodb_setup_pkgdir(pkg, &pkg->installed);
+	test_pass(stat(filename, &st) == 0 && S_ISDIR(st.st_mode));
+
+	test_touch("pkgs/pkg-hier/list");
+	test_touch("pkgs/pkg-hier/postinst");
+	test_touch("pkgs/pkg-hier/.hidden");
+	test_pass(test_foreach(pkg) == 2);
+	test_pass(test_foreach_has("list"));
+	test_pass(test_foreach_has("postinst"));
+	pkg_infodb_sync_pkgdir(pkg, &pkg->installed);
+
+	/* The directory is only removed when empty. */
+	pkg_infodb_remove_pkgdir(pkg, &pkg->installed);
+	test_pass(stat(filename, &st) == 0);
+
+	test_unlink("pkgs/pkg-hier/list");
+	test_unlink("pkgs/pkg-hier/postinst");
+	test_unlink("pkgs/pkg-hier/.hidden");
+	pkg_infodb_remove_pkgdir(pkg, &pkg->installed);
+	test_pass(stat(filename, &st) < 0);
+	free(filename);
+
+	filename = test_alloc(str_fmt("%s/info/pkgs", test_dir));
+	test_pass(rmdir(filename) == 0);
+	free(filename);
+}
+
+static void
+test_db_ctrl_setup(void)
+{
+	char *filename;
+
+	test_dir = test_alloc(strdup("test.XXXXXX"));
+	test_pass(mkdtemp(test_dir) != NULL);
+	filename = test_alloc(str_fmt("%s/info", test_dir));
+	test_pass(mkdir(filename, 0755) == 0);
+	free(filename);
+
+	dpkg_db_set_dir(test_dir);
+	pkg_infodb_reset_dir();
+}
+
+static void
+test_db_ctrl_teardown(void)
+{
+	char *filename;
+
+	filename = test_alloc(str_fmt("%s/info", test_dir));
+	test_pass(rmdir(filename) == 0);
+	free(filename);
+	test_pass(rmdir(test_dir) == 0);
+
+	varbuf_destroy(&test_seen);
+	free(test_dir);
+}
+
+TEST_ENTRY(test)
+{
+	test_plan(50);
+
+	test_db_ctrl_setup();
+	test_db_ctrl_index();
+	test_db_ctrl_hierarchical();
+	test_db_ctrl_teardown();
+}
@@ -0,0 +1,280 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * t-dbmodify.c - test database modification and read snapshots
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/test.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/string.h>
+#include <dpkg/subproc.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/pkg.h>
+
+static char *test_dir;
+
+static const char stanza_fmt[] =
+	"Package: pkg-a\n"
+	"Status: install ok %s\n"
+	"Maintainer: Test <test@example.org>\n"
+	"Architecture: all\n"
+	"Version: %s\n"
+	"Description: test package\n";
+
+static char *
+test_path(const char *name)
+{
+	return test_alloc(str_fmt("%s/%s", test_dir, name));
+}
+
+static void
+test_write(const char *name, const char *data)
+{
+	char *filename = test_path(name);
+	FILE *fp;
+
+	fp = fopen(filename, "w");
+	if (fp == NULL)
+		test_bail("cannot create test file");
+	fputs(data, fp);
+	fclose(fp);
+	free(filename);
+}
+
+static void
+test_write_stanza(const char *name, const char *status, const char *version)
+{
+	char *data;
+
+	data = test_alloc(str_fmt(stanza_fmt, status, version));
+	test_write(name, data);
+	free(data);
+}
+
+static void
+test_write_snapshot(int generation, intmax_t ino_offset, const char *version)
+{
+	char *filename, *header, *stanza, *data;
+	struct stat st;
+
+	filename = test_path("status");
+	if (stat(filename, &st) < 0)
+		test_bail("cannot stat status file");
+	free(filename);
+
+	header = test_alloc(str_fmt("dpkg-snapshot 1 %d %jd %jd %jd\n",
+	                            generation,
+	                            (intmax_t)st.st_ino + ino_offset,
+	                            (intmax_t)st.st_size,
+	                            (intmax_t)st.st_mtime));
+	stanza = test_alloc(str_fmt(stanza_fmt, "installed", version));
+	data = test_alloc(str_fmt("%s%s", header, stanza));
+	test_write("updates/snapshot", data);
+	free(data);
+	free(stanza);
+	free(header);
+}
+
+static void
+test_unlink(const char *name)
+{
+	char *filename = test_path(name);
+
+	if (unlink(filename) < 0 && errno != ENOENT)
+		test_bail("cannot remove test file");
+	free(filename);
+}
+
+static bool
+test_exists(const char *name)
+{
+	char *filename = test_path(name);
+	bool exists;
+
+	exists = access(filename, F_OK) == 0;
+	free(filename);
+
+	return exists;
+}
+
+static const char *
+test_read_version(void)
+{
+	static char version[64];
+	struct pkginfo *pkg;
+
+	modstatdb_open(msdbrw_readonly);
+	pkg = pkg_db_find_singleton("pkg-a");
+	snprintf(version, sizeof(version), "%s",
+	         versiondescribe(&pkg->installed.version, vdew_nonambig));
+	modstatdb_shutdown();
+
+	return version;
+}
+
+static void
+test_snapshot_reader(void)
+{
+	/* Without a snapshot, the journal gets replayed. */
+	test_write_stanza("updates/0000", "installed", "2.0");
+	test_str(test_read_version(), ==, "2.0");
+
+	/* A valid snapshot is used instead of the journal. */
+	test_write_snapshot(1, 0, "3.0");
+	test_str(test_read_version(), ==, "3.0");
+
+	/* A snapshot older than the journal is ignored. */
+	test_write_snapshot(0, 0, "3.0");
+	test_str(test_read_version(), ==, "2.0");
+
+	/* A snapshot for another status file is ignored. */
+	test_write_snapshot(1, 1, "3.0");
+	test_str(test_read_version(), ==, "2.0");
+
+	/* A corrupt snapshot is ignored. */
+	test_write("updates/snapshot", "garbage\n");
+	test_str(test_read_version(), ==, "2.0");
+
+	test_unlink("updates/snapshot");
+	test_unlink("updates/0000");
+}
+
+static void
+test_snapshot_writer(void)
+{
+	struct pkginfo *pkg;
+	char *journal, *aside;
+	pid_t pid;
+
+	modstatdb_open(msdbrw_write);
+	test_pass(!test_exists("updates/snapshot"));
+
+	pkg = pkg_db_find_singleton("pkg-a");
+	pkg_set_status(pkg, PKG_STAT_HALFCONFIGURED);
+	modstatdb_note(pkg);
+	test_pass(test_exists("updates/0000"));
+	test_pass(test_exists("updates/snapshot"));
+
+	/* Move the journal aside, so that the reader can only see the change
+	 * through the snapshot. */
+	journal = test_path("updates/0000");
+	aside = test_path("journal");
+	test_pass(rename(journal, aside) == 0);
+
+	pid = subproc_fork();
+	if (pid == 0) {
+		struct pkginfo *reader_pkg;
+
+		pkg_db_reset();
+		modstatdb_open(msdbrw_readonly);
+		reader_pkg = pkg_db_find_singleton("pkg-a");
+		exit(reader_pkg->status == PKG_STAT_HALFCONFIGURED ? 0 : 1);
+	}
+	test_pass(subproc_reap(pid, "reader", SUBPROC_RETERROR) == 0);
+
+	test_pass(rename(aside, journal) == 0);
+	free(aside);
+	free(journal);
+
+	/* The snapshot goes away with the journal on checkpoint. */
+	modstatdb_shutdown();
+	test_pass(!test_exists("updates/snapshot"));
+	test_pass(!test_exists("updates/0000"));
+	test_str(test_read_version(), ==, "1.0");
+}
+
+static void
+test_journal_replay(void)
+{
+	/* All journal entries get replayed in order. */
+	test_write_stanza("updates/0000", "installed", "2.0");
+	test_write_stanza("updates/0001", "installed", "2.1");
+	test_str(test_read_version(), ==, "2.1");
+	test_pass(test_exists("updates/0000"));
+	test_pass(test_exists("updates/0001"));
+
+	/* And get incorporated and removed on write access. */
+	modstatdb_open(msdbrw_write);
+	test_pass(!test_exists("updates/0000"));
+	test_pass(!test_exists("updates/0001"));
+	modstatdb_shutdown();
+	test_str(test_read_version(), ==, "2.1");
+}
+
+static void
+test_dbmodify_setup(void)
+{
+	char *dirname;
+
+	test_dir = test_alloc(strdup("test.XXXXXX"));
+	test_pass(mkdtemp(test_dir) != NULL);
+	dirname = test_path("updates");
+	test_pass(mkdir(dirname, 0755) == 0);
+	free(dirname);
+
+	test_write_stanza("status", "installed", "1.0");
+
+	dpkg_db_set_dir(test_dir);
+}
+
+static void
+test_dbmodify_teardown(void)
+{
+	static const char *const files[] = {
+		"status", "status-old", "available", "lock", "lock-frontend",
+		"updates/tmp.i", "updates/tmp.s", "triggers/Unincorp",
+		"triggers/Lock", NULL,
+	};
+	static const char *const dirs[] = {
+		"updates", "triggers", NULL,
+	};
+	int i;
+
+	for (i = 0; files[i]; i++)
+		test_unlink(files[i]);
+	for (i = 0; dirs[i]; i++) {
+		char *dirname = test_path(dirs[i]);
+
+		rmdir(dirname);
+		free(dirname);
+	}
+	test_pass(rmdir(test_dir) == 0);
+
+	free(test_dir);
+}
+
+TEST_ENTRY(test)
+{
+	test_plan(23);
+
+	test_dbmodify_setup();
+	test_snapshot_reader();
+	test_snapshot_writer();
+	test_journal_replay();
+	test_dbmodify_teardown();
+}
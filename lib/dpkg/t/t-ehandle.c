@@ -22,8 +22,10 @@
 #include <compat.h>
 
 #include <stdbool.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdlib.h>
 
 #include <dpkg/test.h>
 #include <dpkg/ehandle.h>
@@ -111,11 +113,68 @@ test_cleanup_error(void)
 	test_pass(pass);
 }
 
+static void **cleanup_seen_argv[8];
+static int cleanup_seen;
+
+static void
+cleanup_record(int argc, void **argv)
+{
+	if (argc != 2 || argv[0] != cleanup_seen_argv)
+		test_bail("cleanup called with bogus arguments");
+
+	cleanup_seen_argv[cleanup_seen++ % array_count(cleanup_seen_argv)] = argv;
+}
+
+static void
+test_cleanup_reuse(void)
+{
+	void **argv_first[array_count(cleanup_seen_argv)];
+	void *hold[array_count(cleanup_seen_argv) * 16];
+	int round, i, n = array_count(cleanup_seen_argv);
+	int reused = 0, recycled = 0;
+
+	push_error_context();
+
+	for (round = 0; round < 100; round++) {
+		cleanup_seen = 0;
+		for (i = 0; i < n; i++)
+			push_cleanup(cleanup_record, ehflag_normaltidy, 2,
+			             cleanup_seen_argv, NULL);
+		push_checkpoint(~0, 0);
+		pop_cleanup(ehflag_normaltidy);
+		for (i = 0; i < n; i++)
+			pop_cleanup(ehflag_normaltidy);
+
+		/* Grab any memory released to the heap, so that entries
+		 * allocated anew cannot end up at the same addresses. */
+		for (i = 0; i < (int)array_count(hold); i++)
+			hold[i] = test_alloc(malloc(16 + (i % 16) * 16));
+
+		if (round == 0) {
+			memcpy(argv_first, cleanup_seen_argv, sizeof(argv_first));
+		} else {
+			/* After the first round, all entries must come from
+			 * the free list, which means no new allocations. */
+			for (i = 0; i < n; i++)
+				if (cleanup_seen_argv[i] == argv_first[i])
+					reused++;
+			recycled++;
+		}
+
+		for (i = 0; i < (int)array_count(hold); i++)
+			free(hold[i]);
+	}
+	test_pass(cleanup_seen == n);
+	test_pass(reused == recycled * n);
+
+	pop_error_context(ehflag_normaltidy);
+}
+
 TEST_ENTRY(test)
 {
 	int fd;
 
-	test_plan(3);
+	test_plan(5);
 
 	/* XXX: Shut up stderr, we don't want the error output. */
 	fd = open("/dev/null", O_RDWR);
@@ -126,4 +185,5 @@ TEST_ENTRY(test)
 	test_error_handler_func();
 	test_error_handler_jump();
 	test_cleanup_error();
+	test_cleanup_reuse();
 }
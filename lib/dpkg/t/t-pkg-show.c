@@ -21,9 +21,13 @@
 #include <config.h>
 #include <compat.h>
 
+#include <stdlib.h>
+
 #include <dpkg/test.h>
 #include <dpkg/dpkg-db.h>
 #include <dpkg/arch.h>
+#include <dpkg/pkg-array.h>
+#include <dpkg/pkg-show.h>
 
 static void
 test_pkg_show_name(void)
@@ -53,9 +57,64 @@ test_pkg_show_name(void)
 	test_str(pkgname, ==, "test:arch");
 }
 
+static void
+test_pkg_show_sort(void)
+{
+	static const struct {
+		const char *name;
+		const char *arch;
+		enum pkgmultiarch multiarch;
+	} pkgs[] = {
+		{ "libfoo-dev", "arch-c", PKG_MULTIARCH_SAME },
+		{ "a", "all", PKG_MULTIARCH_NO },
+		{ "abcdefghj", "all", PKG_MULTIARCH_NO },
+		{ "libfoo-dev", "arch-a", PKG_MULTIARCH_SAME },
+		{ "abcdefgh", "all", PKG_MULTIARCH_NO },
+		{ "z", "all", PKG_MULTIARCH_NO },
+		{ "abcdefghi", "all", PKG_MULTIARCH_NO },
+		{ "libfoo", "arch-b", PKG_MULTIARCH_FOREIGN },
+		{ "libfoo", "arch-a", PKG_MULTIARCH_SAME },
+		{ "ab", "all", PKG_MULTIARCH_NO },
+		{ "libfoo-dev", "arch-b", PKG_MULTIARCH_SAME },
+		{ "libfoo-de", "all", PKG_MULTIARCH_NO },
+	};
+	static const char *const sorted[] = {
+		"a", "ab", "abcdefgh", "abcdefghi", "abcdefghj",
+		"libfoo:arch-a", "libfoo:arch-b", "libfoo-de",
+		"libfoo-dev:arch-a", "libfoo-dev:arch-b", "libfoo-dev:arch-c", "z",
+	};
+	struct pkg_array array, ref;
+	size_t i;
+
+	array.n_pkgs = ref.n_pkgs = array_count(pkgs);
+	array.pkgs = test_alloc(malloc(sizeof(array.pkgs[0]) * array.n_pkgs));
+	ref.pkgs = test_alloc(malloc(sizeof(ref.pkgs[0]) * ref.n_pkgs));
+	for (i = 0; i < array_count(pkgs); i++) {
+		struct pkginfo *pkg;
+
+		pkg = pkg_db_find_pkg(pkgs[i].name, dpkg_arch_find(pkgs[i].arch));
+		pkg->installed.multiarch = pkgs[i].multiarch;
+		array.pkgs[i] = ref.pkgs[i] = pkg;
+	}
+
+	/* The precomputed keys must sort as the comparison function. */
+	pkg_array_sort(&array, pkg_sorter_by_nonambig_name_arch);
+	qsort(ref.pkgs, ref.n_pkgs, sizeof(ref.pkgs[0]),
+	      pkg_sorter_by_nonambig_name_arch);
+
+	for (i = 0; i < array_count(sorted); i++) {
+		test_pass(array.pkgs[i] == ref.pkgs[i]);
+		test_str(pkg_name(array.pkgs[i], pnaw_nonambig), ==, sorted[i]);
+	}
+
+	pkg_array_destroy(&array);
+	pkg_array_destroy(&ref);
+}
+
 TEST_ENTRY(test)
 {
-	test_plan(10);
+	test_plan(34);
 
 	test_pkg_show_name();
+	test_pkg_show_sort();
 }
@@ -368,9 +368,75 @@ test_varbuf_detach(void)
 	free(str);
 }
 
+static void
+test_varbuf_inline(void)
+{
+	struct varbuf vb;
+	char storage[8];
+	char *str;
+
+	varbuf_init_inline(&vb, storage, sizeof(storage));
+	test_pass(vb.used == 0);
+	test_pass(vb.size == sizeof(storage));
+	test_pass(vb.buf == storage);
+
+	/* Test that we use the inline storage while it fits. */
+	varbuf_add_str(&vb, "1234567");
+	varbuf_end_str(&vb);
+	test_pass(vb.buf == storage);
+	test_str(vb.buf, ==, "1234567");
+
+	/* Test that we spill to the heap when it does not. */
+	varbuf_add_str(&vb, "890");
+	varbuf_end_str(&vb);
+	test_pass(vb.buf != storage);
+	test_pass(vb.size >= 11);
+	test_str(vb.buf, ==, "1234567890");
+
+	varbuf_destroy(&vb);
+	test_pass(vb.buf == NULL);
+
+	/* Test that detaching always gives back heap memory. */
+	varbuf_init_inline(&vb, storage, sizeof(storage));
+	varbuf_add_buf(&vb, "1234", 4);
+	str = varbuf_detach(&vb);
+	test_pass(str != storage);
+	test_mem(str, ==, "1234", 4);
+	test_pass(str[4] == '\0');
+	test_pass(vb.buf == NULL);
+	free(str);
+
+	varbuf_destroy(&vb);
+}
+
+static void
+test_varbuf_scratch(void)
+{
+	struct varbuf *vb, *vb_nested;
+	const char *buf;
+
+	vb = varbuf_scratch_get();
+	test_pass(vb->used == 0);
+	varbuf_add_str(vb, "scratch");
+	buf = vb->buf;
+
+	vb_nested = varbuf_scratch_get();
+	test_pass(vb_nested != vb);
+	test_pass(vb_nested->used == 0);
+	varbuf_scratch_put(vb_nested);
+
+	varbuf_scratch_put(vb);
+
+	/* Test that the storage gets reused. */
+	vb = varbuf_scratch_get();
+	test_pass(vb->used == 0);
+	test_pass(vb->buf == buf);
+	varbuf_scratch_put(vb);
+}
+
 TEST_ENTRY(test)
 {
-	test_plan(128);
+	test_plan(146);
 
 	test_varbuf_init();
 	test_varbuf_prealloc();
@@ -387,6 +453,8 @@ TEST_ENTRY(test)
 	test_varbuf_reset();
 	test_varbuf_snapshot();
 	test_varbuf_detach();
+	test_varbuf_inline();
+	test_varbuf_scratch();
 
 	/* FIXME: Complete. */
 }
@@ -22,6 +22,7 @@
 #include <config.h>
 #include <compat.h>
 
+#include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -30,6 +31,9 @@
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
 
+/* Minimum size for the first heap allocation. */
+#define VARBUF_SIZE_MIN 64
+
 void
 varbuf_add_char(struct varbuf *v, int c)
 {
@@ -131,12 +135,32 @@ varbuf_init(struct varbuf *v, size_t size)
 {
   v->used = 0;
   v->size = size;
+  v->buf_inline = NULL;
   if (size)
     v->buf = m_malloc(size);
   else
     v->buf = NULL;
 }
 
+/**
+ * Initialize a varbuf with caller provided storage.
+ *
+ * The storage is used until it gets too small, at which point the contents
+ * get moved to the heap. The storage must outlive the varbuf.
+ *
+ * @param v The varbuf to initialize.
+ * @param buf The storage to use.
+ * @param size The size of the storage.
+ */
+void
+varbuf_init_inline(struct varbuf *v, char *buf, size_t size)
+{
+  v->used = 0;
+  v->size = size;
+  v->buf = buf;
+  v->buf_inline = buf;
+}
+
 void
 varbuf_reset(struct varbuf *v)
 {
@@ -146,6 +170,8 @@ varbuf_reset(struct varbuf *v)
 void
 varbuf_grow(struct varbuf *v, size_t need_size)
 {
+  size_t new_size;
+
   /* Make sure the varbuf is in a sane state. */
   if (v->size < v->used)
     internerr("varbuf used(%zu) > size(%zu)", v->used, v->size);
@@ -154,8 +180,20 @@ varbuf_grow(struct varbuf *v, size_t need_size)
   if ((v->size - v->used) >= need_size)
     return;
 
-  v->size = (v->size + need_size) * 2;
-  v->buf = m_realloc(v->buf, v->size);
+  /* Size the first allocation to fit, as it is commonly for the whole
+   * content, and double it afterwards. */
+  if (v->size == 0)
+    new_size = max(need_size, VARBUF_SIZE_MIN);
+  else
+    new_size = max(v->size * 2, v->used + need_size);
+
+  if (v->buf != NULL && v->buf == v->buf_inline) {
+    v->buf = m_malloc(new_size);
+    memcpy(v->buf, v->buf_inline, v->used);
+  } else {
+    v->buf = m_realloc(v->buf, new_size);
+  }
+  v->size = new_size;
 }
 
 void
@@ -185,6 +223,12 @@ varbuf_detach(struct varbuf *v)
 {
   char *buf = v->buf;
 
+  if (buf != NULL && buf == v->buf_inline) {
+    buf = m_malloc(v->used + 1);
+    memcpy(buf, v->buf_inline, v->used);
+    buf[v->used] = '\0';
+  }
+
   v->buf = NULL;
   v->size = 0;
   v->used = 0;
@@ -195,12 +239,78 @@ varbuf_detach(struct varbuf *v)
 void
 varbuf_destroy(struct varbuf *v)
 {
-  free(v->buf); v->buf=NULL; v->size=0; v->used=0;
+  if (v->buf != v->buf_inline)
+    free(v->buf);
+  v->buf = NULL;
+  v->buf_inline = NULL;
+  v->size = 0;
+  v->used = 0;
 }
 
 void
 varbuf_free(struct varbuf *v)
 {
-  free(v->buf);
+  varbuf_destroy(v);
   free(v);
 }
+
+/*
+ * Scratch varbufs, to be reused by code needing a temporary buffer on each
+ * call. The pool is not locked, so it must not be used concurrently.
+ */
+#define VARBUF_SCRATCH_MAX 4
+#define VARBUF_SCRATCH_KEEP (1024 * 1024)
+
+static struct {
+  struct varbuf vb;
+  bool used;
+} scratch[VARBUF_SCRATCH_MAX];
+
+/**
+ * Get a scratch varbuf.
+ *
+ * The varbuf is empty, but might keep the storage from previous uses.
+ * It must be returned with varbuf_scratch_put(), and not be destroyed,
+ * also on error unwinding, for example with cu_varbuf_scratch().
+ * When all scratch varbufs are in use, a new one gets allocated instead.
+ *
+ * @return The scratch varbuf.
+ */
+struct varbuf *
+varbuf_scratch_get(void)
+{
+  int i;
+
+  for (i = 0; i < VARBUF_SCRATCH_MAX; i++) {
+    if (!scratch[i].used) {
+      scratch[i].used = true;
+      varbuf_reset(&scratch[i].vb);
+      return &scratch[i].vb;
+    }
+  }
+
+  return varbuf_new(0);
+}
+
+/**
+ * Return a scratch varbuf.
+ *
+ * @param v The varbuf obtained with varbuf_scratch_get().
+ */
+void
+varbuf_scratch_put(struct varbuf *v)
+{
+  int i;
+
+  for (i = 0; i < VARBUF_SCRATCH_MAX; i++) {
+    if (v == &scratch[i].vb) {
+      /* Do not hold on to unusually big buffers. */
+      if (v->size > VARBUF_SCRATCH_KEEP)
+        varbuf_destroy(v);
+      scratch[i].used = false;
+      return;
+    }
+  }
+
+  varbuf_free(v);
+}
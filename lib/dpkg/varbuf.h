@@ -51,10 +51,16 @@ DPKG_BEGIN_DECLS
  * varbuf again.
  *
  * Callers using C++ need not worry about any of this.
+ *
+ * A varbuf can also be set up with varbuf_init_inline() to start off with
+ * caller provided storage, usually on the stack, which only gets replaced
+ * by heap storage when it is not big enough. It still needs varbuf_destroy.
  */
 struct varbuf {
 	size_t used, size;
 	char *buf;
+	/* Caller provided storage, not owned by the varbuf. */
+	char *buf_inline;
 
 #ifdef __cplusplus
 	varbuf(size_t _size = 0);
@@ -70,10 +76,11 @@ struct varbuf {
 #endif
 };
 
-#define VARBUF_INIT { 0, 0, NULL }
+#define VARBUF_INIT { 0, 0, NULL, NULL }
 
 struct varbuf *varbuf_new(size_t size);
 void varbuf_init(struct varbuf *v, size_t size);
+void varbuf_init_inline(struct varbuf *v, char *buf, size_t size);
 void varbuf_grow(struct varbuf *v, size_t need_size);
 void varbuf_trunc(struct varbuf *v, size_t used_size);
 char *varbuf_detach(struct varbuf *v);
@@ -81,6 +88,9 @@ void varbuf_reset(struct varbuf *v);
 void varbuf_destroy(struct varbuf *v);
 void varbuf_free(struct varbuf *v);
 
+struct varbuf *varbuf_scratch_get(void);
+void varbuf_scratch_put(struct varbuf *v);
+
 void varbuf_add_char(struct varbuf *v, int c);
 void varbuf_dup_char(struct varbuf *v, int c, size_t n);
 void varbuf_map_char(struct varbuf *v, int c_src, int c_dst);
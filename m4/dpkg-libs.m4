@@ -12,6 +12,7 @@ AC_DEFUN([DPKG_LIB_MD], [
       [use libmd library for message digest functions])],
     [], [with_libmd=check])
   have_libmd="no"
+  have_libmd_sha2="no"
   AS_IF([test "x$with_libmd" != "xno"], [
     AC_CHECK_HEADERS([md5.h], [
       dpkg_save_libmd_LIBS=$LIBS
@@ -27,8 +28,16 @@ AC_DEFUN([DPKG_LIB_MD], [
     AS_IF([test "x$with_libmd" = "xyes" && test "x$have_libmd" = "xno"], [
       AC_MSG_FAILURE([md5 digest functions not found])
     ])
+    dnl The builtin digest functions on some systems only cover md5.
+    AS_IF([test "x$have_libmd" != "xno"], [
+      AC_CHECK_HEADERS([sha1.h sha2.h], [have_libmd_sha2="yes"], [
+        have_libmd_sha2="no"
+        break
+      ])
+    ])
   ])
   AM_CONDITIONAL([HAVE_LIBMD_MD5], [test "x$have_libmd" != "xno"])
+  AM_CONDITIONAL([HAVE_LIBMD_SHA2], [test "x$have_libmd_sha2" = "xyes"])
 ])# DPKG_LIB_MD
 
 # DPKG_WITH_COMPRESS_LIB(NAME, HEADER, FUNC)
@@ -130,6 +139,26 @@ AC_DEFUN([DPKG_LIB_SELINUX], [
     [test "x$ac_cv_lib_selinux_setexecfilecon" = "xyes"])
 ])# DPKG_LIB_SELINUX
 
+# DPKG_LIB_PTHREAD
+# ----------------
+# Check for POSIX threads library.
+AC_DEFUN([DPKG_LIB_PTHREAD], [
+  AC_ARG_VAR([PTHREAD_LIBS], [linker flags for pthread library])dnl
+  have_libpthread="no"
+  AC_CHECK_HEADER([pthread.h], [
+    dpkg_save_pthread_LIBS=$LIBS
+    AC_SEARCH_LIBS([pthread_create], [pthread], [
+      AC_DEFINE([HAVE_PTHREAD], [1],
+        [Define to 1 if POSIX threads are available])
+      have_libpthread="yes"
+      AS_IF([test "x$ac_cv_search_pthread_create" != "xnone required"], [
+        PTHREAD_LIBS="${PTHREAD_LIBS:+$PTHREAD_LIBS }$ac_cv_search_pthread_create"
+      ])
+    ])
+    LIBS=$dpkg_save_pthread_LIBS
+  ])
+])# DPKG_LIB_PTHREAD
+
 # _DPKG_CHECK_LIB_CURSES_NARROW
 # -----------------------------
 # Check for narrow curses library.
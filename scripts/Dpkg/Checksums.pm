@@ -20,7 +20,7 @@ package Dpkg::Checksums;
 use strict;
 use warnings;
 
-our $VERSION = '1.03';
+our $VERSION = '1.04';
 our @EXPORT = qw(
     checksums_is_supported
     checksums_get_list
@@ -30,6 +30,7 @@ our @EXPORT = qw(
 use Exporter qw(import);
 use Digest;
 
+use Dpkg ();
 use Dpkg::Gettext;
 use Dpkg::ErrorHandling;
 
@@ -69,6 +70,13 @@ my $CHECKSUMS = {
     },
 };
 
+# Helper computing all the digests in a single pass over each file, and
+# handling several files concurrently.
+my $DIGEST = $ENV{DPKG_DIGEST} // "$Dpkg::LIBDIR/dpkg-digest";
+
+# Maximum number of files to pass to a single dpkg-digest invocation.
+use constant DIGEST_BATCH_SIZE => 512;
+
 =item @list = checksums_get_list()
 
 Returns the list of supported checksums algorithms.
@@ -172,29 +180,119 @@ updated with the boolean "update" option.
 sub add_from_file {
     my ($self, $file, %opts) = @_;
     my $key = exists $opts{key} ? $opts{key} : $file;
-    my @alg;
+    my @alg = _get_wanted_list(%opts);
+
+    (my @s = stat($file)) or syserr(g_('cannot fstat file %s'), $file);
+
+    my %digest = map { $_ => Digest->new($CHECKSUMS->{$_}{name}) } @alg;
+    open my $fh, '<', $file or syserr(g_('cannot open file %s'), $file);
+    while (1) {
+        my $n = read $fh, my $buf, 65536;
+        syserr(g_('cannot read file %s'), $file) if not defined $n;
+        last if $n == 0;
+        $_->add($buf) foreach values %digest;
+    }
+    close $fh;
+
+    my %sums = map { $_ => $digest{$_}->hexdigest } @alg;
+
+    $self->_add_checksums($file, $key, $s[7], \%sums, %opts);
+}
+
+=item $ck->add_from_files($files, %opts)
+
+Add or verify checksums information for all the files in the $files array
+reference, as if add_from_file() had been called for each one in turn,
+but processing them faster, by reading each file only once and handling
+several files in parallel when possible. The options are the same as for
+add_from_file(), except that instead of "key" the "keys" option can be
+set to an array reference with the public name of each file.
+
+=cut
+
+sub add_from_files {
+    my ($self, $files, %opts) = @_;
+    my @keys = exists $opts{keys} ? @{$opts{keys}} : @{$files};
+    my @alg = _get_wanted_list(%opts);
+    delete $opts{keys};
+
+    my $info = _compute_checksums(\@alg, @{$files});
+
+    foreach my $i (0 .. $#{$files}) {
+        my $file = $files->[$i];
+        my $key = $keys[$i];
+
+        if (exists $info->{$file}) {
+            my ($size, $sums) = @{$info->{$file}};
+
+            $self->_add_checksums($file, $key, $size, $sums, %opts);
+        } else {
+            # Let the error handling or unusual filenames be done the slow
+            # way, which takes care of reporting any problem.
+            $self->add_from_file($file, %opts, key => $key);
+        }
+    }
+}
+
+sub _get_wanted_list {
+    my %opts = @_;
+
     if (exists $opts{checksums}) {
-	push @alg, map { lc } @{$opts{checksums}};
+        return map { lc } @{$opts{checksums}};
     } else {
-	push @alg, checksums_get_list();
+        return checksums_get_list();
+    }
+}
+
+sub _compute_checksums {
+    my ($alg, @files) = @_;
+    my %info;
+
+    return \%info unless length $DIGEST and -x $DIGEST;
+
+    # The output records are line and tab based, so skip any pathname that
+    # would break them.
+    @files = grep { not m/[\t\n]/ } @files;
+
+    local $ENV{LC_ALL} = 'C';
+    while (my @batch = splice @files, 0, DIGEST_BATCH_SIZE) {
+        open my $digest, '-|', $DIGEST, '--digests=' . join(',', @{$alg}),
+                                        '--', @batch
+            or syserr(g_('cannot fork for %s'), $DIGEST);
+
+        while (my $line = <$digest>) {
+            chomp $line;
+            my ($status, @fields) = split /\t/, $line, -1;
+            next if $status ne 'ok' or @fields != @{$alg} + 2;
+
+            my ($size, @sums) = @fields;
+            my $file = pop @sums;
+            my %sums;
+            @sums{@{$alg}} = @sums;
+
+            $info{$file} = [ $size, \%sums ];
+        }
+
+        # On failure we simply fall back to computing the missing ones.
+        close $digest;
     }
 
+    return \%info;
+}
+
+sub _add_checksums {
+    my ($self, $file, $key, $size, $sums, %opts) = @_;
+
     push @{$self->{files}}, $key unless exists $self->{size}{$key};
-    (my @s = stat($file)) or syserr(g_('cannot fstat file %s'), $file);
     if (not $opts{update} and exists $self->{size}{$key} and
-        $self->{size}{$key} != $s[7]) {
+        $self->{size}{$key} != $size) {
 	error(g_('file %s has size %u instead of expected %u'),
-	      $file, $s[7], $self->{size}{$key});
+	      $file, $size, $self->{size}{$key});
     }
-    $self->{size}{$key} = $s[7];
-
-    foreach my $alg (@alg) {
-        my $digest = Digest->new($CHECKSUMS->{$alg}{name});
-        open my $fh, '<', $file or syserr(g_('cannot open file %s'), $file);
-        $digest->addfile($fh);
-        close $fh;
+    $self->{size}{$key} = $size;
 
-        my $newsum = $digest->hexdigest;
+    foreach my $alg (sort keys %{$sums}) {
+        my $newsum = $sums->{$alg};
         if (not $opts{update} and exists $self->{checksums}{$key}{$alg} and
             $self->{checksums}{$key}{$alg} ne $newsum) {
             error(g_('file %s has checksum %s instead of expected %s (algorithm %s)'),
@@ -400,6 +498,10 @@ sub export_to_control {
 
 =head1 CHANGES
 
+=head2 Version 1.04 (dpkg 1.19.3)
+
+New method: $ck->add_from_files().
+
 =head2 Version 1.03 (dpkg 1.18.5)
 
 New property: Add new 'strong' property.
@@ -0,0 +1,183 @@
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+package Dpkg::Shlibs::Cache;
+
+use strict;
+use warnings;
+
+our $VERSION = '0.01';
+
+use Time::HiRes ();
+use File::Temp qw(tempfile);
+use Storable qw(nstore retrieve freeze thaw);
+
+use Dpkg::Gettext;
+use Dpkg::ErrorHandling;
+
+# Persistent cache for dpkg-shlibdeps, shared by all its invocations during
+# a package build. It holds the parsed symbols files and the library to
+# package ownership, each entry keyed by the pathname and validated against
+# a stamp made of the inode, size and modification time of the file. The
+# ownership entries are also dropped in bulk whenever any of the dpkg
+# database files they depend on (the status and diversions files) change.
+
+use constant CACHE_FORMAT => 1;
+
+sub new {
+    my ($this, %opts) = @_;
+    my $class = ref($this) || $this;
+    my $self = {
+        file => $opts{file},
+        dbstamp => join(';', map { get_stamp($_) } @{$opts{dbfiles} // []}),
+        symfiles => {},
+        pkgmatch => {},
+        dirty => 0,
+    };
+    bless $self, $class;
+
+    $self->load() if defined $self->{file};
+
+    return $self;
+}
+
+sub get_stamp {
+    my $file = shift;
+
+    my @st = Time::HiRes::stat($file);
+    return '' unless @st;
+    return "$st[1]:$st[7]:$st[9]";
+}
+
+sub read_cache {
+    my $file = shift;
+
+    return unless -e $file;
+
+    # A corrupt or truncated cache is no worse than a missing one.
+    my $data = eval { retrieve($file) };
+    return unless ref $data eq 'HASH';
+    return unless ($data->{format} // 0) == CACHE_FORMAT;
+
+    return $data;
+}
+
+sub load {
+    my $self = shift;
+
+    my $data = read_cache($self->{file});
+    return unless defined $data;
+
+    $self->{symfiles} = $data->{symfiles};
+    if ($data->{dbstamp} eq $self->{dbstamp}) {
+        $self->{pkgmatch} = $data->{pkgmatch};
+    }
+}
+
+sub save {
+    my $self = shift;
+
+    return unless defined $self->{file} and $self->{dirty};
+
+    my %data = (
+        format => CACHE_FORMAT,
+        dbstamp => $self->{dbstamp},
+        symfiles => $self->{symfiles},
+        pkgmatch => $self->{pkgmatch},
+    );
+
+    # Preserve any entries stored by concurrent invocations since we loaded
+    # the cache, but prefer our own as these are the most recent ones.
+    my $old = read_cache($self->{file});
+    if (defined $old) {
+        $data{symfiles} = { %{$old->{symfiles}}, %{$data{symfiles}} };
+        if ($old->{dbstamp} eq $self->{dbstamp}) {
+            $data{pkgmatch} = { %{$old->{pkgmatch}}, %{$data{pkgmatch}} };
+        }
+    }
+
+    my ($fh, $tmpfile) = eval { tempfile("$self->{file}.XXXXXX") };
+    if (not defined $fh) {
+        warning(g_('cannot create cache file %s'), $self->{file});
+        return;
+    }
+    close $fh;
+    if (not eval { nstore(\%data, $tmpfile) } or
+        not rename $tmpfile, $self->{file}) {
+        warning(g_('cannot write cache file %s'), $self->{file});
+        unlink $tmpfile;
+        return;
+    }
+
+    $self->{dirty} = 0;
+}
+
+sub get_symfile {
+    my ($self, $file, $arch) = @_;
+
+    my $entry = $self->{symfiles}{$file};
+    return unless defined $entry;
+    return unless $entry->{arch} eq $arch;
+    return unless $entry->{stamp} eq get_stamp($file);
+
+    return thaw($entry->{data});
+}
+
+sub set_symfile {
+    my ($self, $file, $arch, $symfile) = @_;
+
+    my $stamp = get_stamp($file);
+    return if $stamp eq '';
+
+    # We only track the stamp for the top-level file, so do not cache
+    # files pulling others, which could change behind our back.
+    open my $fh, '<', $file or return;
+    while (<$fh>) {
+        return if m/^(?:\(.*\))?#include\s/;
+    }
+    close $fh;
+
+    # Storable before 3.08 cannot serialize the compiled regex patterns,
+    # so skip any symbols file that cannot be frozen.
+    my $data = eval { freeze($symfile) };
+    return unless defined $data;
+
+    $self->{symfiles}{$file} = {
+        stamp => $stamp,
+        arch => $arch,
+        data => $data,
+    };
+    $self->{dirty} = 1;
+}
+
+sub get_pkgmatch {
+    my ($self, $file) = @_;
+
+    my $entry = $self->{pkgmatch}{$file};
+    return unless defined $entry;
+    return unless $entry->{stamp} eq get_stamp($file);
+
+    return [ @{$entry->{pkgs}} ];
+}
+
+sub set_pkgmatch {
+    my ($self, $file, $pkgs) = @_;
+
+    $self->{pkgmatch}{$file} = {
+        stamp => get_stamp($file),
+        pkgs => [ @{$pkgs} ],
+    };
+    $self->{dirty} = 1;
+}
+
+1;
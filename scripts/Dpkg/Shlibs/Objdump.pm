@@ -21,6 +21,7 @@ use feature qw(state);
 
 our $VERSION = '0.01';
 
+use Dpkg ();
 use Dpkg::Gettext;
 use Dpkg::ErrorHandling;
 use Dpkg::Path qw(find_command);
@@ -34,6 +35,15 @@ if (get_build_arch() ne get_host_arch()) {
     $OBJDUMP = $od if find_command($od);
 }
 
+# The native ELF scanner, which handles any architecture, and is used in
+# preference to objdump when available.
+our $ELFDUMP = $ENV{DPKG_ELFDUMP} // "$Dpkg::LIBDIR/dpkg-elfdump";
+
+# Maximum number of files to pass to a single dpkg-elfdump invocation.
+use constant ELFDUMP_BATCH_SIZE => 512;
+
+my %elfdump_cache;
+
 
 sub new {
     my $this = shift;
@@ -229,6 +239,57 @@ sub get_format {
     return $format{$file};
 }
 
+sub has_elfdump {
+    state $usable = length $ELFDUMP && -x $ELFDUMP;
+
+    return $usable;
+}
+
+sub scan_files {
+    my @files = @_;
+
+    return unless has_elfdump();
+
+    # The output records are line based, so skip any pathname that would
+    # break them, these will be analyzed by objdump instead.
+    @files = grep { not exists $elfdump_cache{$_} and not m/\n/ } @files;
+
+    local $ENV{LC_ALL} = 'C';
+    while (my @batch = splice @files, 0, ELFDUMP_BATCH_SIZE) {
+        open my $elfdump, '-|', $ELFDUMP, '--', @batch
+            or syserr(g_('cannot fork for %s'), $ELFDUMP);
+
+        my ($file, $output, $failed);
+        while (<$elfdump>) {
+            if (m/^file\t/) {
+                $file = shift @batch;
+                $output = '';
+                $failed = 0;
+            } elsif (m/^end$/) {
+                $elfdump_cache{$file} = $failed ? undef : $output
+                    if defined $file;
+                $file = undef;
+            } elsif (m/^error\t/) {
+                $failed = 1;
+            } else {
+                $output .= $_;
+            }
+        }
+        close $elfdump;
+    }
+    return;
+}
+
+sub get_elfdump_output {
+    my $file = shift;
+
+    return unless has_elfdump();
+
+    scan_files($file) if not exists $elfdump_cache{$file};
+
+    return delete $elfdump_cache{$file};
+}
+
 sub is_elf {
     my $file = shift;
     open(my $file_fh, '<', $file) or syserr(g_('cannot read %s'), $file);
@@ -298,6 +359,15 @@ sub analyze {
         return;
     }
 
+    my $output = Dpkg::Shlibs::Objdump::get_elfdump_output($file);
+    if (defined $output) {
+        open my $elfdump, '<', \$output
+            or syserr(g_('cannot read %s'), $file);
+        my $ret = $self->parse_elfdump_output($elfdump);
+        close $elfdump;
+        return $ret;
+    }
+
     local $ENV{LC_ALL} = 'C';
     open(my $objdump, '-|', $OBJDUMP, '-w', '-f', '-p', '-T', '-R', $file)
         or syserr(g_('cannot fork for %s'), $OBJDUMP);
@@ -389,6 +459,80 @@ sub parse_objdump_output {
     return $section ne 'none';
 }
 
+# Output format of dpkg-elfdump, one tab-separated record per line
+#
+# format	elf64-little
+# flags	EXEC_P, HAS_SYMS, D_PAGED
+# interp
+# needed	libc.so.6
+# soname	libfoo.so.1
+# rpath	/usr/lib/foo
+# runpath	/usr/lib/foo
+# sym	g    DF 	.text	GLIBC_2.2			getwchar
+# sym	      D 	*UND*	GLIBC_2.2.5	1		free
+# sym	g    DF 	.text	Base		protected	xine_close
+# reloc	R_X86_64_COPY	stdout
+#
+# The sym fields are the objdump symbol flags, the section name, the
+# version string, whether the version is hidden, the symbol visibility,
+# and the symbol name.
+
+sub parse_elfdump_output {
+    my ($self, $fh) = @_;
+
+    my $parsed = 0;
+    while (<$fh>) {
+        chomp;
+        my ($tag, @field) = split /\t/;
+
+        if ($tag eq 'sym') {
+            my ($flags, $sect, $ver, $hidden, $vis, $name) = @field;
+
+            $self->add_dynamic_symbol({
+                name => $name,
+                version => $ver // '',
+                section => $sect,
+                dynamic => substr($flags, 5, 1) eq 'D',
+                debug => substr($flags, 5, 1) eq 'd',
+                type => substr($flags, 6, 1),
+                weak => substr($flags, 1, 1) eq 'w',
+                local => substr($flags, 0, 1) eq 'l',
+                global => substr($flags, 0, 1) eq 'g',
+                visibility => $vis // '',
+                hidden => $hidden // '',
+                defined => $sect ne '*UND*',
+            });
+        } elsif ($tag eq 'reloc') {
+            $self->{dynrelocs}{$field[1]} = $field[0];
+        } elsif ($tag eq 'needed') {
+            push @{$self->{NEEDED}}, $field[0];
+        } elsif ($tag eq 'soname') {
+            $self->{SONAME} = $field[0];
+        } elsif ($tag eq 'hash') {
+            $self->{HASH} = $field[0];
+        } elsif ($tag eq 'gnu-hash') {
+            $self->{GNU_HASH} = $field[0];
+        } elsif ($tag eq 'runpath') {
+            # See parse_objdump_output() for the precedence rules.
+            $self->{RPATH} = [ split /:/, $field[0] ];
+        } elsif ($tag eq 'rpath') {
+            unless (scalar(@{$self->{RPATH}})) {
+                $self->{RPATH} = [ split /:/, $field[0] ];
+            }
+        } elsif ($tag eq 'interp') {
+            $self->{INTERP} = 1;
+        } elsif ($tag eq 'flags') {
+            $self->{flags}{$_} = 1 foreach (split(/,\s*/, $field[0] // ''));
+        } elsif ($tag eq 'format') {
+            $self->{format} = $field[0];
+            $parsed = 1;
+        }
+    }
+    $self->apply_relocations();
+
+    return $parsed;
+}
+
 # Output format of objdump -w -T
 #
 # /lib/libc.so.6:     file format elf32-i386
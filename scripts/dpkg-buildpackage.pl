@@ -560,6 +560,14 @@ if (build_has_any(BUILD_SOURCE)) {
 
 run_hook('build', build_has_any(BUILD_BINARY));
 
+# Let all dpkg-shlibdeps invocations during the build share their cache,
+# which gets removed at exit.
+if (not exists $ENV{DPKG_SHLIBDEPS_CACHE}) {
+    my $cachedir = tempdir('dpkg-shlibdeps.XXXXXXXX', TMPDIR => 1,
+                           CLEANUP => 1);
+    $ENV{DPKG_SHLIBDEPS_CACHE} = "$cachedir/cache";
+}
+
 my $build_types = get_build_options_from_type();
 
 if (build_has_any(BUILD_BINARY)) {
@@ -381,18 +381,22 @@ if (build_has_any(BUILD_BINARY)) {
     error(g_('binary build with no binary artifacts found; .buildinfo is meaningless'))
         if $dist_count == 0;
 
+    my @dist_files;
+
     foreach my $file ($dist->get_files()) {
         # Make us a bit idempotent.
         next if $file->{filename} =~ m/\.buildinfo$/;
 
-        my $path = "$uploadfilesdir/$file->{filename}";
-        $checksums->add_from_file($path, key => $file->{filename});
+        push @dist_files, $file->{filename};
 
         if (defined $file->{package_type} and $file->{package_type} =~ m/^u?deb$/) {
             push @archvalues, $file->{arch}
                 if defined $file->{arch} and not $archadded{$file->{arch}}++;
         }
     }
+
+    $checksums->add_from_files([ map { "$uploadfilesdir/$_" } @dist_files ],
+                               keys => \@dist_files);
 }
 
 $fields->{'Format'} = $buildinfo_format;
@@ -308,6 +308,7 @@ if (build_has_any(BUILD_SOURCE)) {
 }
 
 my $dist_binaries = 0;
+my @dist_files;
 
 $dist->load($fileslistfile) if -e $fileslistfile;
 
@@ -316,7 +317,7 @@ foreach my $file ($dist->get_files()) {
 
     if (defined $file->{package} && $file->{package_type} eq 'buildinfo') {
         # We always distribute the .buildinfo file.
-        $checksums->add_from_file("$uploadfilesdir/$f", key => $f);
+        push @dist_files, $f;
         next;
     }
 
@@ -336,10 +337,13 @@ foreach my $file ($dist->get_files()) {
         push @{$p2f{$file->{package}}}, $file->{filename};
     }
 
-    $checksums->add_from_file("$uploadfilesdir/$f", key => $f);
+    push @dist_files, $f;
     $dist_binaries++;
 }
 
+$checksums->add_from_files([ map { "$uploadfilesdir/$_" } @dist_files ],
+                           keys => \@dist_files);
+
 error(g_('binary build with no binary artifacts found; cannot distribute'))
     if build_has_any(BUILD_BINARY) && $dist_binaries == 0;
 
@@ -209,6 +209,7 @@ if (not scalar @files) {
 
 # Merge symbol information
 my $od = Dpkg::Shlibs::Objdump->new();
+Dpkg::Shlibs::Objdump::scan_files(@files);
 foreach my $file (@files) {
     debug(1, "Scanning $file for symbol information");
     my $objid = $od->analyze($file);
@@ -38,6 +38,7 @@ use Dpkg::Version;
 use Dpkg::Shlibs qw(find_library get_library_paths);
 use Dpkg::Shlibs::Objdump;
 use Dpkg::Shlibs::SymbolFile;
+use Dpkg::Shlibs::Cache;
 use Dpkg::Substvars;
 use Dpkg::Arch qw(get_host_arch);
 use Dpkg::Deps;
@@ -177,9 +178,20 @@ my %symfile_cache;
 my %objdump_cache;
 my %symfile_has_soname_cache;
 
+# Persistent cache shared by all invocations within a package build.
+my $cache;
+if (length($ENV{DPKG_SHLIBDEPS_CACHE} // '')) {
+    $cache = Dpkg::Shlibs::Cache->new(file => $ENV{DPKG_SHLIBDEPS_CACHE},
+                                      dbfiles => [ "$admindir/status",
+                                                   "$admindir/diversions" ]);
+}
+
 # Used to count errors due to missing libraries
 my $error_count = 0;
 
+# Scan all binaries at once, which is faster than doing it one by one.
+Dpkg::Shlibs::Objdump::scan_files(keys %exec);
+
 my $cur_field;
 foreach my $file (keys %exec) {
     $cur_field = $exec{$file};
@@ -269,9 +281,7 @@ foreach my $file (keys %exec) {
             if (defined($symfile_path)) {
                 # Load symbol information
                 debug(1, "Using symbols file $symfile_path for $soname");
-                $symfile_cache{$symfile_path} //=
-                   Dpkg::Shlibs::SymbolFile->new(file => $symfile_path);
-                $symfile->merge_object_from_symfile($symfile_cache{$symfile_path}, $soname);
+                $symfile->merge_object_from_symfile(load_symfile($symfile_path), $soname);
             }
 	    if (defined($symfile_path) && $symfile->has_object($soname)) {
 		# Initialize dependencies with the smallest minimal version
@@ -463,6 +473,8 @@ foreach my $file (keys %exec) {
     }
 }
 
+$cache->save() if defined $cache;
+
 # Warn of unneeded libraries at the "package" level (i.e. over all
 # binaries that we have inspected)
 foreach my $soname (keys %global_soname_needed) {
@@ -801,6 +813,29 @@ sub find_symbols_file {
     return;
 }
 
+sub get_cached_symfile {
+    my $file = shift;
+
+    if (not exists $symfile_cache{$file} and defined $cache) {
+        my $symfile = $cache->get_symfile($file, $host_arch);
+        $symfile_cache{$file} = $symfile if defined $symfile;
+    }
+    return $symfile_cache{$file};
+}
+
+sub load_symfile {
+    my $file = shift;
+
+    my $symfile = get_cached_symfile($file);
+    return $symfile if defined $symfile;
+
+    $symfile = Dpkg::Shlibs::SymbolFile->new(file => $file);
+    $cache->set_symfile($file, $host_arch, $symfile) if defined $cache;
+    $symfile_cache{$file} = $symfile;
+
+    return $symfile;
+}
+
 sub symfile_has_soname {
     my ($file, $soname) = @_;
 
@@ -808,6 +843,14 @@ sub symfile_has_soname {
         return $symfile_has_soname_cache{$file}{$soname};
     }
 
+    # Avoid scanning the file if we have already parsed it.
+    my $symfile = get_cached_symfile($file);
+    if (defined $symfile) {
+        my $result = $symfile->has_object($soname) ? 1 : 0;
+        $symfile_has_soname_cache{$file}{$soname} = $result;
+        return $result;
+    }
+
     open(my $symfile_fh, '<', $file)
         or syserr(g_('cannot open file %s'), $file);
     my $result = 0;
@@ -885,6 +928,10 @@ sub find_packages {
     my $pkgmatch = {};
 
     foreach my $path (@_) {
+	if (not exists $cached_pkgmatch{$path} and defined $cache) {
+	    my $pkgs = $cache->get_pkgmatch($path);
+	    $cached_pkgmatch{$path} = $pkgs if defined $pkgs;
+	}
 	if (exists $cached_pkgmatch{$path}) {
 	    $pkgmatch->{$path} = $cached_pkgmatch{$path};
 	} else {
@@ -922,5 +969,10 @@ sub find_packages {
 	}
     }
     close($dpkg_fh);
+
+    if (defined $cache) {
+	$cache->set_pkgmatch($_, $cached_pkgmatch{$_}) foreach @files;
+    }
+
     return $pkgmatch;
 }
@@ -16,10 +16,14 @@
 use strict;
 use warnings;
 
-use Test::More tests => 59;
+use Test::More tests => 71;
 use Test::Dpkg qw(:paths);
 
 BEGIN {
+    # Use the helper from the build tree, if available.
+    my $helper = "$ENV{builddir}/../src/dpkg-digest";
+    $ENV{DPKG_DIGEST} = -x $helper ? $helper : '';
+
     use_ok('Dpkg::Checksums');
 }
 
@@ -109,6 +113,25 @@ foreach my $alg (keys %str_checksum) {
 
 test_checksums($ck);
 
+# Check add_from_files()
+
+my $ck_files = Dpkg::Checksums->new();
+$ck_files->add_from_files([ map { "$datadir/$_->{file}" } @data ],
+                          keys => [ map { $_->{file} } @data ]);
+test_checksums($ck_files);
+
+$ck_files = Dpkg::Checksums->new();
+$ck_files->add_from_files([ "$datadir/data-1" ], checksums => [ 'SHA256' ]);
+is_deeply($ck_files->get_checksum("$datadir/data-1"),
+          { sha256 => $data[1]{sums}{sha256} },
+          'Only the wanted checksums get computed');
+
+$ck_files->add_from_string('md5', "$data[2]{sums}{md5} 14 data-1");
+eval {
+    $ck_files->add_from_files([ "$datadir/data-1" ], keys => [ 'data-1' ]);
+};
+ok($@, 'Mismatched checksums from files are detected');
+
 # Check add_from_string()
 
 foreach my $alg (keys %str_checksum) {
@@ -21,7 +21,7 @@ use Test::Dpkg qw(:needs :paths);
 
 use Cwd;
 
-plan tests => 150;
+plan tests => 157;
 
 use Dpkg::Path qw(find_command);
 
@@ -134,6 +134,29 @@ is( scalar @syms, 2231, 'defined && dynamic' );
 @syms = $obj->get_undefined_dynamic_symbols;
 is( scalar @syms, 9, 'undefined && dynamic' );
 
+open my $elfdump, '<', "$datadir/elfdump.ls"
+  or die "$datadir/elfdump.ls: $!";
+my $obj_elf = Dpkg::Shlibs::Objdump::Object->new;
+ok($obj_elf->parse_elfdump_output($elfdump), 'parsed dpkg-elfdump output');
+close $elfdump;
+
+ok(!$obj_elf->is_public_library(), 'ls is not a public library (elfdump)');
+ok($obj_elf->is_executable(), 'ls is an executable (elfdump)');
+is_deeply($obj_elf->{NEEDED}, [ 'libselinux.so.1', 'libc.so.6' ],
+          'NEEDED (elfdump)');
+is_deeply($obj_elf->{RPATH}, [ '/usr/lib/ls', '/usr/lib/ls/extra' ],
+          'RUNPATH takes precedence over RPATH (elfdump)');
+
+my $sym_elf = $obj_elf->get_symbol('optarg@GLIBC_2.0');
+ok(!$sym_elf->{defined}, 'R_*_COPY relocations are taken into account (elfdump)');
+$sym_elf = $obj_elf->get_symbol('_IO_stdin_used');
+is_deeply( $sym_elf, { name => '_IO_stdin_used', version => 'Base',
+		   soname => '', objid => '',
+		   section => '.rodata', dynamic => 1,
+		   debug => '', type => 'O', weak => '',
+		   local => '', global => 1, visibility => 'protected',
+		   hidden => '', defined => 1 }, 'Symbol (elfdump)' );
+
 
 my $obj_old = Dpkg::Shlibs::Objdump::Object->new;
 
@@ -0,0 +1,164 @@
+#!/usr/bin/perl
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+use strict;
+use warnings;
+
+use Test::More tests => 20;
+use Test::Dpkg qw(:paths);
+
+BEGIN {
+    use_ok('Dpkg::Shlibs::Cache');
+    use_ok('Dpkg::Shlibs::SymbolFile');
+}
+
+sub file_dump {
+    my ($file, $data) = @_;
+
+    open my $fh, '>', $file or die "cannot create $file: $!";
+    print { $fh } $data;
+    close $fh;
+}
+
+sub file_copy {
+    my ($src, $dst) = @_;
+
+    open my $fh, '<', $src or die "cannot open $src: $!";
+    local $/;
+    file_dump($dst, <$fh>);
+    close $fh;
+}
+
+my $datadir = test_get_data_path('t/Dpkg_Shlibs');
+my $tmpdir = test_get_temp_path();
+my $cachefile = "$tmpdir/cache";
+my $dbfile = "$tmpdir/status";
+my $divfile = "$tmpdir/diversions";
+my @dbfiles = ($dbfile, $divfile);
+my $libfile = "$tmpdir/libfake.so.1";
+
+unlink $cachefile;
+file_dump($dbfile, "Package: fake\n");
+file_dump($divfile, '');
+file_dump($libfile, "fake library\n");
+file_copy("$datadir/symbols.fake-3", "$tmpdir/fake.symbols");
+file_dump("$tmpdir/include.symbols", "#include \"fake.symbols\"\n");
+
+my $arch = 'amd64';
+my $symfile = Dpkg::Shlibs::SymbolFile->new(file => "$tmpdir/fake.symbols",
+                                             arch => $arch);
+
+my $cache = Dpkg::Shlibs::Cache->new(file => $cachefile, dbfiles => \@dbfiles);
+ok(!defined $cache->get_symfile("$tmpdir/fake.symbols", $arch),
+   'empty cache has no symbols file');
+
+$cache->set_symfile("$tmpdir/fake.symbols", $arch, $symfile);
+$cache->set_symfile("$tmpdir/include.symbols", $arch, $symfile);
+$cache->set_pkgmatch($libfile, [ 'libfake1' ]);
+$cache->save();
+ok(-e $cachefile, 'cache file saved');
+
+$cache = Dpkg::Shlibs::Cache->new(file => $cachefile, dbfiles => \@dbfiles);
+is_deeply($cache->get_symfile("$tmpdir/fake.symbols", $arch), $symfile,
+          'symbols file retrieved from the saved cache');
+ok(!defined $cache->get_symfile("$tmpdir/fake.symbols", 'i386'),
+   'symbols file parsed for another arch is not used');
+ok(!defined $cache->get_symfile("$tmpdir/include.symbols", $arch),
+   'symbols file with includes is not cached');
+is_deeply($cache->get_pkgmatch($libfile), [ 'libfake1' ],
+          'library ownership retrieved from the saved cache');
+ok(!defined $cache->get_pkgmatch("$tmpdir/libother.so.1"),
+   'unknown library has no ownership');
+
+# Entries from concurrent users get merged on save.
+my $other = Dpkg::Shlibs::Cache->new(file => $cachefile, dbfiles => \@dbfiles);
+$other->set_pkgmatch("$tmpdir/libother.so.1", [ '' ]);
+$other->save();
+$cache->set_pkgmatch($dbfile, [ 'dpkg' ]);
+$cache->save();
+$cache = Dpkg::Shlibs::Cache->new(file => $cachefile, dbfiles => \@dbfiles);
+is_deeply($cache->get_pkgmatch("$tmpdir/libother.so.1"), [ '' ],
+          'library ownership from a concurrent user preserved');
+is_deeply($cache->get_pkgmatch($dbfile), [ 'dpkg' ],
+          'library ownership merged on save');
+
+# Modified files get invalidated.
+file_copy("$datadir/symbols.fake-3", "$tmpdir/fake.symbols");
+open my $fh, '>>', "$tmpdir/fake.symbols" or die;
+print { $fh } " symbol_new\@Base 2.0\n";
+close $fh;
+ok(!defined $cache->get_symfile("$tmpdir/fake.symbols", $arch),
+   'modified symbols file is invalidated');
+file_dump($libfile, "fake library, version 2\n");
+ok(!defined $cache->get_pkgmatch($libfile),
+   'modified library ownership is invalidated');
+
+# Database changes invalidate all ownership entries.
+file_dump($dbfile, "Package: fake\nStatus: install ok installed\n");
+$cache = Dpkg::Shlibs::Cache->new(file => $cachefile, dbfiles => \@dbfiles);
+ok(!defined $cache->get_pkgmatch("$tmpdir/libother.so.1"),
+   'library ownership invalidated on database changes');
+
+$cache->set_pkgmatch($libfile, [ 'libfake1' ]);
+$cache->save();
+file_dump($divfile, "/usr/lib/libfake.so.1\n/usr/lib/libfake.so.1.distrib\n:\n");
+$cache = Dpkg::Shlibs::Cache->new(file => $cachefile, dbfiles => \@dbfiles);
+ok(!defined $cache->get_pkgmatch($libfile),
+   'library ownership invalidated on diversions changes');
+
+# Symbols files with regex patterns get cached if they can be serialized.
+file_copy("$datadir/patterns.symbols", "$tmpdir/patterns.symbols");
+my $regex_symfile = Dpkg::Shlibs::SymbolFile->new(
+    file => "$tmpdir/patterns.symbols", arch => $arch);
+$cache->set_symfile("$tmpdir/patterns.symbols", $arch, $regex_symfile);
+$cache->save();
+$cache = Dpkg::Shlibs::Cache->new(file => $cachefile, dbfiles => \@dbfiles);
+my $cached_symfile = $cache->get_symfile("$tmpdir/patterns.symbols", $arch);
+if (defined $cached_symfile) {
+    is_deeply($cached_symfile, $regex_symfile,
+              'symbols file with regex patterns retrieved from the cache');
+} else {
+    pass('symbols file with regex patterns skipped by the cache');
+}
+
+# Symbols files that cannot be serialized are not cached.
+{
+    no warnings qw(redefine);
+    local *Dpkg::Shlibs::Cache::freeze = sub { die "cannot freeze\n" };
+
+    $cache = Dpkg::Shlibs::Cache->new(file => $cachefile,
+                                      dbfiles => \@dbfiles);
+    file_copy("$datadir/patterns.symbols", "$tmpdir/nofreeze.symbols");
+    eval {
+        $cache->set_symfile("$tmpdir/nofreeze.symbols", $arch,
+                            $regex_symfile);
+    };
+    is($@, '', 'symbols file failing to serialize does not die');
+    ok(!exists $cache->{symfiles}{"$tmpdir/nofreeze.symbols"},
+       'symbols file failing to serialize is not cached');
+}
+
+# Corrupt caches are ignored.
+file_dump($cachefile, "garbage\n");
+$cache = Dpkg::Shlibs::Cache->new(file => $cachefile, dbfiles => \@dbfiles);
+ok(!defined $cache->get_symfile("$tmpdir/fake.symbols", $arch),
+   'corrupt cache is ignored');
+$cache->set_pkgmatch($libfile, [ 'libfake1' ]);
+$cache->save();
+$cache = Dpkg::Shlibs::Cache->new(file => $cachefile, dbfiles => \@dbfiles);
+is_deeply($cache->get_pkgmatch($libfile), [ 'libfake1' ],
+          'corrupt cache is replaced on save');
+
+1;
@@ -27,6 +27,7 @@
 
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 
 #include <errno.h>
@@ -46,6 +47,8 @@
 #include <dpkg/dpkg-db.h>
 #include <dpkg/pkg.h>
 #include <dpkg/path.h>
+#include <dpkg/dir.h>
+#include <dpkg/clock.h>
 #include <dpkg/fdio.h>
 #include <dpkg/buffer.h>
 #include <dpkg/subproc.h>
@@ -61,6 +64,7 @@
 #include "main.h"
 #include "archives.h"
 #include "filters.h"
+#include "file-writer.h"
 
 static inline void
 fd_writeback_init(int fd)
@@ -75,6 +79,422 @@ fd_writeback_init(int fd)
 #endif
 }
 
+/*
+ * When requested, small files get synced to disk with a single syncfs() per
+ * file system before the deferred renames, instead of one fsync() per file,
+ * so we keep a descriptor for each file system they have been extracted
+ * into.
+ */
+#define TAR_SYNCFS_MAX 8
+
+static int tar_syncfs_fd[TAR_SYNCFS_MAX];
+static dev_t tar_syncfs_dev[TAR_SYNCFS_MAX];
+static int tar_syncfs_nfds;
+
+static bool
+tar_syncfs_add(int fd)
+{
+#ifdef HAVE_SYNCFS
+  struct stat st;
+  int i;
+
+  if (!small_file_syncfs)
+    return false;
+
+  if (fstat(fd, &st) < 0)
+    return false;
+
+  for (i = 0; i < tar_syncfs_nfds; i++)
+    if (tar_syncfs_dev[i] == st.st_dev)
+      return true;
+
+  if (tar_syncfs_nfds == TAR_SYNCFS_MAX)
+    return false;
+
+  fd = dup(fd);
+  if (fd < 0)
+    return false;
+  setcloexec(fd, _("<file system sync descriptor>"));
+
+  tar_syncfs_fd[tar_syncfs_nfds] = fd;
+  tar_syncfs_dev[tar_syncfs_nfds] = st.st_dev;
+  tar_syncfs_nfds++;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+static void
+tar_syncfs_done(void)
+{
+#ifdef HAVE_SYNCFS
+  int i;
+
+  for (i = 0; i < tar_syncfs_nfds; i++) {
+    debug(dbg_eachfiledetail, "deferred extract needs syncfs");
+
+    if (syncfs(tar_syncfs_fd[i]))
+      ohshite(_("unable to sync file system for unpacked files"));
+    close(tar_syncfs_fd[i]);
+  }
+  tar_syncfs_nfds = 0;
+#endif
+}
+
+void
+tar_syncfs_reset(void)
+{
+  int i;
+
+  for (i = 0; i < tar_syncfs_nfds; i++)
+    close(tar_syncfs_fd[i]);
+  tar_syncfs_nfds = 0;
+}
+
+/*
+ * Writeback manager for the files with a deferred fsync. Their descriptors
+ * are kept open until the deferred extract, and the amount of dirty data
+ * extracted is tracked across files. Writeback is started for whole
+ * windows of dirty data at once, and we only wait for the oldest windows
+ * when too much is in flight. The window size is adjusted so that each
+ * window takes roughly the same time to hit the disk, from the throughput
+ * measured when waiting for previous windows.
+ *
+ * Each tracked file is reachable from its filenamenode, and the number of
+ * descriptors kept open is bounded by a fraction of RLIMIT_NOFILE, leaving
+ * the rest for the archive, the file writer jobs and any subprocesses.
+ */
+#define TAR_WRITEBACK_FILES_MIN 16
+#define TAR_WRITEBACK_FILES_MAX 4096
+#define TAR_WRITEBACK_WINDOW_MIN (1 << 20)
+#define TAR_WRITEBACK_WINDOW_MAX (64 << 20)
+#define TAR_WRITEBACK_WINDOW_INIT (8 << 20)
+/* The time in milliseconds we want a window to take to get written back. */
+#define TAR_WRITEBACK_WINDOW_MSEC 250
+
+enum tar_writeback_state {
+  TAR_WRITEBACK_DIRTY,
+  TAR_WRITEBACK_STARTED,
+  TAR_WRITEBACK_DONE,
+};
+
+struct file_writeback {
+  struct file_writeback *next, *prev;
+  struct filenamenode *namenode;
+  int fd;
+  off_t size;
+  enum tar_writeback_state state;
+  unsigned int window;
+};
+
+struct tar_writeback_list {
+  struct file_writeback *head, *tail;
+};
+
+struct tar_writeback_window {
+  struct timespec start;
+  off_t size;
+};
+
+/* The files are kept in extraction order, the oldest first. The pending
+ * list holds the started files, followed by the dirty ones. */
+static struct tar_writeback_list tar_writeback_pending;
+static struct tar_writeback_list tar_writeback_done;
+static struct file_writeback *tar_writeback_dirty_head;
+static struct tar_writeback_window *tar_writeback_windows;
+static int tar_writeback_files_max;
+static int tar_writeback_nfiles;
+static unsigned int tar_writeback_nwindows;
+static off_t tar_writeback_dirty;
+static off_t tar_writeback_inflight;
+static off_t tar_writeback_window_size = TAR_WRITEBACK_WINDOW_INIT;
+/* The measured throughput in bytes per second, 0 if unknown. */
+static double tar_writeback_rate;
+
+static void
+tar_writeback_init(void)
+{
+  struct rlimit rlim;
+  rlim_t files_max = TAR_WRITEBACK_FILES_MAX;
+
+  if (tar_writeback_windows)
+    return;
+
+  if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY)
+    files_max = rlim.rlim_cur / 4;
+  if (files_max < TAR_WRITEBACK_FILES_MIN)
+    files_max = TAR_WRITEBACK_FILES_MIN;
+  else if (files_max > TAR_WRITEBACK_FILES_MAX)
+    files_max = TAR_WRITEBACK_FILES_MAX;
+  tar_writeback_files_max = files_max;
+
+  /* Each window in flight has at least one file. */
+  tar_writeback_windows = m_malloc(tar_writeback_files_max *
+                                   sizeof(*tar_writeback_windows));
+
+  debug(dbg_eachfiledetail, "writeback files max=%d",
+        tar_writeback_files_max);
+}
+
+static void
+tar_writeback_list_append(struct tar_writeback_list *list,
+                          struct file_writeback *file)
+{
+  file->next = NULL;
+  file->prev = list->tail;
+  if (list->tail)
+    list->tail->next = file;
+  else
+    list->head = file;
+  list->tail = file;
+}
+
+static void
+tar_writeback_list_unlink(struct tar_writeback_list *list,
+                          struct file_writeback *file)
+{
+  if (file->prev)
+    file->prev->next = file->next;
+  else
+    list->head = file->next;
+  if (file->next)
+    file->next->prev = file->prev;
+  else
+    list->tail = file->prev;
+}
+
+static double
+tar_writeback_elapsed(const struct timespec *start)
+{
+  struct timespec now;
+
+  dpkg_clock_get_monotonic(&now);
+
+  return dpkg_clock_elapsed(start, &now);
+}
+
+static void
+tar_writeback_adjust(off_t size, double elapsed, bool blocked)
+{
+  double sample;
+  off_t window;
+
+  if (elapsed <= 0)
+    return;
+  sample = size / elapsed;
+
+  /* If we had to block, the device was the bottleneck and the sample is
+   * its throughput, otherwise it is only a lower bound. */
+  if (tar_writeback_rate == 0)
+    tar_writeback_rate = sample;
+  else if (blocked)
+    tar_writeback_rate = (tar_writeback_rate + sample) / 2;
+  else if (sample > tar_writeback_rate)
+    tar_writeback_rate = sample;
+
+  window = tar_writeback_rate * TAR_WRITEBACK_WINDOW_MSEC / 1000;
+  if (window < TAR_WRITEBACK_WINDOW_MIN)
+    window = TAR_WRITEBACK_WINDOW_MIN;
+  else if (window > TAR_WRITEBACK_WINDOW_MAX)
+    window = TAR_WRITEBACK_WINDOW_MAX;
+  tar_writeback_window_size = window;
+
+  debug(dbg_eachfiledetail, "writeback rate=%.0f window=%jd",
+        tar_writeback_rate, (intmax_t)tar_writeback_window_size);
+}
+
+static struct tar_writeback_window *
+tar_writeback_get_window(unsigned int n)
+{
+  return &tar_writeback_windows[n % tar_writeback_files_max];
+}
+
+static void
+tar_writeback_start(void)
+{
+  struct tar_writeback_window *window;
+  struct file_writeback *file;
+
+  if (tar_writeback_dirty == 0)
+    return;
+
+  window = tar_writeback_get_window(tar_writeback_nwindows);
+  dpkg_clock_get_monotonic(&window->start);
+  window->size = 0;
+
+  for (file = tar_writeback_dirty_head; file; file = file->next) {
+    fd_writeback_init(file->fd);
+    file->state = TAR_WRITEBACK_STARTED;
+    file->window = tar_writeback_nwindows;
+    window->size += file->size;
+  }
+  tar_writeback_dirty_head = NULL;
+
+  debug(dbg_eachfiledetail, "writeback start window=%u size=%jd",
+        tar_writeback_nwindows, (intmax_t)window->size);
+
+  tar_writeback_nwindows++;
+  tar_writeback_inflight += tar_writeback_dirty;
+  tar_writeback_dirty = 0;
+}
+
+static void
+tar_writeback_wait_oldest(void)
+{
+  struct tar_writeback_window *window;
+  struct file_writeback *file;
+  struct timespec wait_start;
+  unsigned int n;
+  double blocked;
+
+  file = tar_writeback_pending.head;
+  if (file == NULL || file->state != TAR_WRITEBACK_STARTED)
+    return;
+  n = file->window;
+  window = tar_writeback_get_window(n);
+
+  dpkg_clock_get_monotonic(&wait_start);
+
+  while ((file = tar_writeback_pending.head) &&
+         file->state == TAR_WRITEBACK_STARTED && file->window == n) {
+    /* Ignore the return code, we are doing an fsync() later on anyway. */
+#if defined(SYNC_FILE_RANGE_WRITE)
+    sync_file_range(file->fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE |
+                                    SYNC_FILE_RANGE_WRITE |
+                                    SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+    file->state = TAR_WRITEBACK_DONE;
+    tar_writeback_inflight -= file->size;
+
+    tar_writeback_list_unlink(&tar_writeback_pending, file);
+    tar_writeback_list_append(&tar_writeback_done, file);
+  }
+
+  /* Consider anything under a millisecond as not having blocked. */
+  blocked = tar_writeback_elapsed(&wait_start);
+  tar_writeback_adjust(window->size, tar_writeback_elapsed(&window->start),
+                       blocked > 0.001);
+}
+
+static void
+tar_writeback_remove(struct file_writeback *file)
+{
+  if (file->state == TAR_WRITEBACK_DONE) {
+    tar_writeback_list_unlink(&tar_writeback_done, file);
+  } else {
+    if (file->state == TAR_WRITEBACK_DIRTY)
+      tar_writeback_dirty -= file->size;
+    else
+      tar_writeback_inflight -= file->size;
+    if (file == tar_writeback_dirty_head)
+      tar_writeback_dirty_head = file->next;
+    tar_writeback_list_unlink(&tar_writeback_pending, file);
+  }
+
+  file->namenode->file_writeback = NULL;
+  tar_writeback_nfiles--;
+  free(file);
+}
+
+static void
+tar_writeback_add(struct filenamenode *namenode, int fd, off_t size)
+{
+  struct file_writeback *file;
+
+  tar_writeback_init();
+
+  /* A pathname might appear more than once in the archive, and then the
+   * old descriptor refers to a file that has been replaced. */
+  if (namenode->file_writeback) {
+    close(namenode->file_writeback->fd);
+    tar_writeback_remove(namenode->file_writeback);
+  }
+
+  /* Make room, the deferred extract will reopen the file. Prefer the
+   * oldest file already written back, otherwise complete the oldest
+   * window, or start the writeback of the oldest dirty file. */
+  if (tar_writeback_nfiles == tar_writeback_files_max) {
+    file = tar_writeback_pending.head;
+    if (tar_writeback_done.head == NULL &&
+        file->state == TAR_WRITEBACK_STARTED)
+      tar_writeback_wait_oldest();
+    if (tar_writeback_done.head)
+      file = tar_writeback_done.head;
+    else
+      fd_writeback_init(file->fd);
+    if (close(file->fd))
+      ohshite(_("error closing/writing '%.255s'"), file->namenode->name);
+    tar_writeback_remove(file);
+  }
+
+  /* Do not leak the descriptor into any maintainer script run on error
+   * unwinding. */
+  setcloexec(fd, namenode->name);
+
+  file = m_malloc(sizeof(*file));
+  file->namenode = namenode;
+  file->fd = fd;
+  file->size = size;
+  file->state = TAR_WRITEBACK_DIRTY;
+  tar_writeback_list_append(&tar_writeback_pending, file);
+  if (tar_writeback_dirty_head == NULL)
+    tar_writeback_dirty_head = file;
+  namenode->file_writeback = file;
+  tar_writeback_nfiles++;
+
+  tar_writeback_dirty += size;
+  if (tar_writeback_dirty < tar_writeback_window_size)
+    return;
+
+  tar_writeback_start();
+  while (tar_writeback_inflight > tar_writeback_window_size * 2)
+    tar_writeback_wait_oldest();
+}
+
+static int
+tar_writeback_take(struct filenamenode *namenode)
+{
+  struct file_writeback *file = namenode->file_writeback;
+  int fd;
+
+  if (file == NULL)
+    return -1;
+
+  fd = file->fd;
+  tar_writeback_remove(file);
+
+  return fd;
+}
+
+void
+tar_writeback_reset(void)
+{
+  struct tar_writeback_list *lists[] = {
+    &tar_writeback_pending, &tar_writeback_done,
+  };
+  size_t i;
+
+  for (i = 0; i < array_count(lists); i++) {
+    struct file_writeback *file, *next;
+
+    for (file = lists[i]->head; file; file = next) {
+      next = file->next;
+      close(file->fd);
+      file->namenode->file_writeback = NULL;
+      free(file);
+    }
+    lists[i]->head = lists[i]->tail = NULL;
+  }
+  tar_writeback_dirty_head = NULL;
+  tar_writeback_nfiles = 0;
+  tar_writeback_dirty = 0;
+  tar_writeback_inflight = 0;
+
+  tar_syncfs_reset();
+}
+
 static struct obstack tar_pool;
 static bool tar_pool_init = false;
 
@@ -340,7 +760,278 @@ does_replace(struct pkginfo *new_pkg, struct pkgbin *new_pkgbin,
   return false;
 }
 
+/*
+ * Copy a small file by reading it whole, and writing it with a single
+ * write().
+ */
+static off_t
+tarobject_copy_small(int fd_in, int fd_out, char *hash, off_t size,
+                     struct dpkg_error *err)
+{
+  static struct varbuf buf;
+  ssize_t r;
+
+  varbuf_reset(&buf);
+  varbuf_grow(&buf, size);
+
+  r = fd_read(fd_in, buf.buf, size);
+  if (r < 0)
+    return dpkg_put_errno(err, _("failed to read"));
+  if (r != size)
+    return dpkg_put_error(err, _("unexpected end of file or stream"));
+
+  buffer_md5(buf.buf, hash, size);
+
+  if (fd_write(fd_out, buf.buf, size) < 0)
+    return dpkg_put_errno(err, _("failed to write"));
+
+  return size;
+}
+
+/*
+ * Finish a regular file once its contents and metadata have been written.
+ */
+static void
+tarobject_extract_done(struct filenamenode *namenode, int fd, off_t size,
+                       bool small, const char *name)
+{
+  /* Postpone the fsync, to try to avoid massive I/O degradation. */
+  if (!fc_unsafe_io && !(small && tar_syncfs_add(fd)))
+    namenode->flags |= fnnf_deferred_fsync;
+
+  if (!small) {
+    if (namenode->flags & fnnf_deferred_fsync) {
+      /* The writeback manager keeps the descriptor until the fsync. */
+      tar_writeback_add(namenode, fd, size);
+      return;
+    }
+    fd_writeback_init(fd);
+  }
+  if (close(fd))
+    ohshite(_("error closing/writing '%.255s'"), name);
+}
+
+/*
+ * Regular files can be written by parallel file writer jobs, with the main
+ * thread still reading the archive and doing all the checks and the
+ * bookkeeping in order. Only files up to TAR_WRITER_FILE_MAX get handed
+ * over, and the contents waiting to be written are bounded by
+ * TAR_WRITER_BUDGET.
+ */
+#define TAR_WRITER_FILE_MAX (1 << 20)
+#define TAR_WRITER_BUDGET (16 << 20)
+
+struct tar_writer_file {
+  struct file_writer_job job;
+  struct filenamenode *namenode;
+  char *name;
+  char *matchpath;
+  mode_t mode;
+  bool small;
+};
+
+static off_t tar_writer_inflight;
+
+static bool
+tar_writer_enabled(void)
+{
+  static int jobs = -1;
+
+  if (jobs < 0) {
+    jobs = file_writer_init(unpack_jobs);
+    if (jobs == 0 && unpack_jobs > 1)
+      warning(_("parallel file writers not supported, ignoring --%s"),
+              "unpack-jobs");
+  }
+
+  return jobs > 0;
+}
+
+static void
+tar_writer_free(struct tar_writer_file *file)
+{
+  tar_writer_inflight -= file->job.size;
+  file->namenode->flags &= ~fnnf_write_pending;
+
+  free(file->job.data);
+  free((char *)file->job.path);
+  free(file->name);
+  free(file->matchpath);
+  free(file);
+}
+
+static void
+tar_writer_complete(struct file_writer_job *job)
+{
+  struct tar_writer_file *file = job->arg;
+  char fnamebuf[256];
+  char fnamenewbuf[256];
+  struct dpkg_error err;
+
+  if (job->error != FILE_WRITER_OK) {
+    if (job->fd >= 0)
+      close(job->fd);
+
+    errno = job->errnum;
+    switch (job->error) {
+    case FILE_WRITER_ERR_OPEN:
+      ohshite(_("unable to create '%.255s' (while processing '%.255s')"),
+              job->path, file->name);
+    case FILE_WRITER_ERR_WRITE:
+      dpkg_put_errno(&err, _("failed to write"));
+      ohshit(_("cannot copy extracted data for '%.255s' to '%.255s': %s"),
+             path_quote_filename(fnamebuf, file->name, 256),
+             path_quote_filename(fnamenewbuf, job->path, 256), err.str);
+    case FILE_WRITER_ERR_TIMES:
+      ohshite(_("error setting timestamps of '%.255s'"), job->path);
+    default:
+      internerr("unknown file writer error %d", job->error);
+    }
+  }
+
+  errno = job->chown_errnum;
+  if (job->chown_errnum && forcible_nonroot_error(-1))
+    ohshite(_("error setting ownership of '%.255s'"), file->name);
+  errno = job->chmod_errnum;
+  if (job->chmod_errnum && forcible_nonroot_error(-1))
+    ohshite(_("error setting permissions of '%.255s'"), file->name);
+  dpkg_selabel_set_context_fd(file->matchpath, job->fd, job->path,
+                              file->mode);
+
+  tarobject_extract_done(file->namenode, job->fd, job->size, file->small,
+                         file->name);
+
+  tar_writer_free(file);
+}
+
+static bool
+tar_writer_collect(bool wait)
+{
+  struct file_writer_job *job;
+
+  job = file_writer_collect(wait);
+  if (job == NULL)
+    return false;
+
+  tar_writer_complete(job);
+
+  return true;
+}
+
 static void
+tar_writer_wait(struct filenamenode *namenode)
+{
+  while (namenode->flags & fnnf_write_pending)
+    tar_writer_collect(true);
+}
+
+static void
+tar_writer_drain(void)
+{
+  while (tar_writer_collect(true))
+    ;
+  file_writer_done();
+}
+
+/*
+ * Wait for any pending file writer job, discarding its outcome, so that
+ * the cleanup can proceed on a quiescent file system.
+ */
+void
+tar_writer_abort(void)
+{
+  struct file_writer_job *job;
+
+  while ((job = file_writer_collect(true))) {
+    if (job->fd >= 0)
+      close(job->fd);
+    tar_writer_free(job->arg);
+  }
+  file_writer_done();
+}
+
+static bool
+tar_writer_submit(struct tarcontext *tc, struct tar_entry *te,
+                  const char *path, struct file_stat *st,
+                  struct filenamenode *namenode)
+{
+  struct tar_writer_file *file;
+  struct file_writer_job *job;
+  struct dpkg_error err;
+  char fnamebuf[256];
+  char fnamenewbuf[256];
+  char *newhash;
+  ssize_t r;
+
+  if (te->size > TAR_WRITER_FILE_MAX || !tar_writer_enabled())
+    return false;
+
+  /* Process the completed jobs, and keep within the memory budget. */
+  while (tar_writer_collect(false))
+    ;
+  while (tar_writer_inflight + te->size > TAR_WRITER_BUDGET)
+    tar_writer_collect(true);
+
+  file = m_malloc(sizeof(*file));
+  job = &file->job;
+  job->data = te->size ? m_malloc(te->size) : NULL;
+  job->size = te->size;
+
+  r = fd_read(tc->backendpipe, job->data, te->size);
+  if (r < 0)
+    dpkg_put_errno(&err, _("failed to read"));
+  else if (r != te->size)
+    dpkg_put_error(&err, _("unexpected end of file or stream"));
+  if (r != te->size)
+    ohshit(_("cannot copy extracted data for '%.255s' to '%.255s': %s"),
+           path_quote_filename(fnamebuf, te->name, 256),
+           path_quote_filename(fnamenewbuf, path, 256), err.str);
+
+  newhash = nfmalloc(MD5HASHLEN + 1);
+  buffer_md5(job->data, newhash, te->size);
+  namenode->newhash = newhash;
+  debug(dbg_eachfiledetail, "tarobject file hash=%s", namenode->newhash);
+
+  tarobject_skip_padding(tc, te);
+
+  if (namenode->statoverride)
+    debug(dbg_eachfile, "tarobject ... stat override, uid=%d, gid=%d, mode=%04o",
+          namenode->statoverride->uid,
+          namenode->statoverride->gid,
+          namenode->statoverride->mode);
+
+  job->path = m_strdup(path);
+  job->uid = st->uid;
+  job->gid = st->gid;
+  job->mode = st->mode & ~S_IFMT;
+  job->times[0].tv_sec = currenttime;
+  job->times[0].tv_usec = 0;
+  job->times[1].tv_sec = te->mtime;
+  job->times[1].tv_usec = 0;
+  job->arg = file;
+
+  file->namenode = namenode;
+  file->name = m_strdup(te->name);
+  file->matchpath = m_strdup(fnamevb.buf);
+  file->mode = st->mode;
+  file->small = small_file_size > 0 && te->size <= small_file_size;
+  job->allocate = !file->small;
+
+  debug(dbg_eachfiledetail, "tarobject file queued size=%jd",
+        (intmax_t)te->size);
+
+  namenode->flags |= fnnf_write_pending;
+  tar_writer_inflight += te->size;
+  file_writer_submit(job);
+
+  return true;
+}
+
+/*
+ * Returns true if the regular file has been handed over to a file writer
+ * job, which takes care of its metadata too.
+ */
+static bool
 tarobject_extract(struct tarcontext *tc, struct tar_entry *te,
                   const char *path, struct file_stat *st,
                   struct filenamenode *namenode)
@@ -353,10 +1044,15 @@ tarobject_extract(struct tarcontext *tc, struct tar_entry *te,
   char fnamebuf[256];
   char fnamenewbuf[256];
   char *newhash;
+  bool small;
+  off_t r;
   int rc;
 
   switch (te->type) {
   case TAR_FILETYPE_FILE:
+    if (tar_writer_submit(tc, te, path, st, namenode))
+      return true;
+
     /* We create the file with mode 0 to make sure nobody can do anything with
      * it until we apply the proper mode, which might be a statoverride. */
     fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0);
@@ -367,13 +1063,22 @@ tarobject_extract(struct tarcontext *tc, struct tar_entry *te,
     debug(dbg_eachfiledetail, "tarobject file open size=%jd",
           (intmax_t)te->size);
 
+    /* Small files are written in one go, and are not worth the syscalls
+     * for the preallocation nor the writeback hints. */
+    small = small_file_size > 0 && te->size <= small_file_size;
+
     /* We try to tell the filesystem how much disk space we are going to
      * need to let it reduce fragmentation and possibly improve performance,
      * as we do know the size beforehand. */
-    fd_allocate_size(fd, 0, te->size);
+    if (!small)
+      fd_allocate_size(fd, 0, te->size);
 
     newhash = nfmalloc(MD5HASHLEN + 1);
-    if (fd_fd_copy_and_md5(tc->backendpipe, fd, newhash, te->size, &err) < 0)
+    if (small)
+      r = tarobject_copy_small(tc->backendpipe, fd, newhash, te->size, &err);
+    else
+      r = fd_fd_copy_and_md5(tc->backendpipe, fd, newhash, te->size, &err);
+    if (r < 0)
       ohshit(_("cannot copy extracted data for '%.255s' to '%.255s': %s"),
              path_quote_filename(fnamebuf, te->name, 256),
              path_quote_filename(fnamenewbuf, fnamenewvb.buf, 256), err.str);
@@ -382,8 +1087,6 @@ tarobject_extract(struct tarcontext *tc, struct tar_entry *te,
 
     tarobject_skip_padding(tc, te);
 
-    fd_writeback_init(fd);
-
     if (namenode->statoverride)
       debug(dbg_eachfile, "tarobject ... stat override, uid=%d, gid=%d, mode=%04o",
             namenode->statoverride->uid,
@@ -395,14 +1098,11 @@ tarobject_extract(struct tarcontext *tc, struct tar_entry *te,
     rc = fchmod(fd, st->mode & ~S_IFMT);
     if (forcible_nonroot_error(rc))
       ohshite(_("error setting permissions of '%.255s'"), te->name);
-
-    /* Postpone the fsync, to try to avoid massive I/O degradation. */
-    if (!fc_unsafe_io)
-      namenode->flags |= fnnf_deferred_fsync;
+    dpkg_selabel_set_context_fd(fnamevb.buf, fd, path, st->mode);
 
     pop_cleanup(ehflag_normaltidy); /* fd = open(path) */
-    if (close(fd))
-      ohshite(_("error closing/writing '%.255s'"), te->name);
+
+    tarobject_extract_done(namenode, fd, te->size, small, te->name);
     break;
   case TAR_FILETYPE_FIFO:
     if (mkfifo(path, 0))
@@ -423,6 +1123,7 @@ tarobject_extract(struct tarcontext *tc, struct tar_entry *te,
     varbuf_reset(&hardlinkfn);
     varbuf_add_str(&hardlinkfn, instdir);
     linknode = findnamenode(te->linkname, 0);
+    tar_writer_wait(linknode);
     varbuf_add_str(&hardlinkfn,
                    namenodetouse(linknode, tc->pkg, &tc->pkg->available)->name);
     if (linknode->flags & (fnnf_deferred_rename | fnnf_new_conff))
@@ -448,6 +1149,8 @@ tarobject_extract(struct tarcontext *tc, struct tar_entry *te,
   default:
     internerr("unknown tar type '%d', but already checked", te->type);
   }
+
+  return false;
 }
 
 static void
@@ -614,6 +1317,134 @@ void setupfnamevbs(const char *filename) {
         fnamevb.buf, fnametmpvb.buf, fnamenewvb.buf);
 }
 
+/*
+ * The on-disk status cache.
+ *
+ * It holds the lstat() result for the pathnames of the filenamenodes looked
+ * up while unpacking a package, so that the conflict checks, the shared
+ * file matching and the removal of old files do not need to hit the
+ * filesystem again for the same pathname. Any of our own modifications on
+ * a pathname invalidate its entry, and the whole cache gets flushed by
+ * bumping its generation whenever something else might have modified the
+ * filesystem, such as when running maintainer scripts.
+ *
+ * Directories we create anew start empty, and all their contents come from
+ * ourselves afterwards, so lookups for pathnames under these which have no
+ * entry yet are known not to exist, without any syscall.
+ */
+static unsigned int ondisk_stat_generation = 1;
+static bool ondisk_stat_deferred_flush;
+
+void
+ondisk_stat_flush(void)
+{
+  ondisk_stat_generation++;
+  ondisk_stat_deferred_flush = false;
+}
+
+static struct file_ondisk_stat *
+ondisk_stat_get(struct filenamenode *namenode)
+{
+  struct file_ondisk_stat *ondisk = namenode->file_ondisk_stat;
+
+  if (ondisk == NULL) {
+    ondisk = nfmalloc(sizeof(*ondisk));
+    ondisk->generation = 0;
+    namenode->file_ondisk_stat = ondisk;
+  }
+  if (ondisk->generation != ondisk_stat_generation) {
+    ondisk->generation = ondisk_stat_generation;
+    ondisk->valid = false;
+    ondisk->newdir = false;
+  }
+
+  return ondisk;
+}
+
+static bool
+ondisk_stat_current(struct filenamenode *namenode)
+{
+  return namenode->file_ondisk_stat &&
+         namenode->file_ondisk_stat->generation == ondisk_stat_generation;
+}
+
+static bool
+ondisk_stat_in_newdir(struct filenamenode *namenode)
+{
+  static struct varbuf dirname;
+  struct filenamenode *dirnode;
+  const char *slash;
+
+  slash = strrchr(namenode->name, '/');
+  if (slash == NULL || slash == namenode->name)
+    return false;
+
+  varbuf_reset(&dirname);
+  varbuf_add_buf(&dirname, namenode->name, slash - namenode->name);
+  varbuf_end_str(&dirname);
+
+  dirnode = findnamenode(dirname.buf, fnn_nonew);
+  if (dirnode == NULL || !ondisk_stat_current(dirnode))
+    return false;
+
+  return dirnode->file_ondisk_stat->newdir;
+}
+
+/**
+ * Get the lstat() information for the pathname of a filenamenode.
+ *
+ * The path must be the on-disk pathname for the namenode. If namenode is
+ * NULL the information is not cached.
+ */
+int
+ondisk_lstat(struct filenamenode *namenode, const char *path, struct stat *st)
+{
+  struct file_ondisk_stat *ondisk;
+
+  if (namenode == NULL)
+    return lstat(path, st);
+
+  if (!ondisk_stat_current(namenode) && ondisk_stat_in_newdir(namenode)) {
+    ondisk = ondisk_stat_get(namenode);
+    ondisk->valid = true;
+    ondisk->err = ENOENT;
+  } else {
+    ondisk = ondisk_stat_get(namenode);
+  }
+
+  if (!ondisk->valid) {
+    if (lstat(path, &ondisk->st) < 0)
+      ondisk->err = errno;
+    else
+      ondisk->err = 0;
+    ondisk->valid = true;
+  }
+
+  if (ondisk->err) {
+    errno = ondisk->err;
+    return -1;
+  }
+  *st = ondisk->st;
+
+  return 0;
+}
+
+/**
+ * Invalidate the cached on-disk status for a pathname we have modified.
+ */
+void
+ondisk_stat_invalidate(struct filenamenode *namenode)
+{
+  struct file_ondisk_stat *ondisk;
+
+  if (namenode == NULL)
+    return;
+
+  ondisk = ondisk_stat_get(namenode);
+  ondisk->valid = false;
+  ondisk->newdir = false;
+}
+
 static bool
 linktosameexistingdir(const struct tar_entry *ti, const char *fname,
                       struct varbuf *symlinkfn)
@@ -665,12 +1496,13 @@ tarobject(void *ctx, struct tar_entry *ti)
 {
   static struct varbuf conffderefn, symlinkfn;
   const char *usename;
-  struct filenamenode *usenode;
+  struct filenamenode *usenode, *statnode;
 
   struct conffile *conff;
   struct tarcontext *tc = ctx;
   bool existingdir, keepexisting;
   bool refcounting;
+  bool queued = false;
   char oldhash[MD5HASHLEN + 1];
   int statr;
   ssize_t r;
@@ -745,7 +1577,14 @@ tarobject(void *ctx, struct tar_entry *ti)
 
   setupfnamevbs(usename);
 
-  statr= lstat(fnamevb.buf,&stab);
+  /* We can only cache the on-disk status if the pathname is the one from
+   * the namenode, and not a dereferenced conffile. */
+  if (usename == usenode->name)
+    statnode = usenode;
+  else
+    statnode = NULL;
+
+  statr = ondisk_lstat(statnode, fnamevb.buf, &stab);
   if (statr) {
     /* The lstat failed. */
     if (errno != ENOENT && errno != ENOTDIR)
@@ -754,15 +1593,18 @@ tarobject(void *ctx, struct tar_entry *ti)
     /* OK, so it doesn't exist.
      * However, it's possible that we were in the middle of some other
      * backup/restore operation and were rudely interrupted.
-     * So, we see if we have .dpkg-tmp, and if so we restore it. */
-    if (rename(fnametmpvb.buf,fnamevb.buf)) {
+     * So, we see if we have .dpkg-tmp, and if so we restore it. This
+     * cannot be the case inside a directory we have just created. */
+    if ((statnode && ondisk_stat_in_newdir(statnode)) ||
+        rename(fnametmpvb.buf, fnamevb.buf)) {
       if (errno != ENOENT && errno != ENOTDIR)
         ohshite(_("unable to clean up mess surrounding '%.255s' before "
                   "installing another version"), ti->name);
       debug(dbg_eachfiledetail,"tarobject nonexistent");
     } else {
       debug(dbg_eachfiledetail,"tarobject restored tmp to main");
-      statr= lstat(fnamevb.buf,&stab);
+      ondisk_stat_invalidate(statnode);
+      statr = ondisk_lstat(statnode, fnamevb.buf, &stab);
       if (statr)
         ohshite(_("unable to stat restored '%.255s' before installing"
                   " another version"), ti->name);
@@ -787,10 +1629,15 @@ tarobject(void *ctx, struct tar_entry *ti)
     }
     break;
   case TAR_FILETYPE_DIR:
-    /* If it's already an existing directory, do nothing. */
-    if (!stat(fnamevb.buf,&stabtmp) && S_ISDIR(stabtmp.st_mode)) {
+    /* If it's already an existing directory, or a symlink to one, do
+     * nothing. */
+    if (!statr && S_ISDIR(stab.st_mode)) {
       debug(dbg_eachfiledetail, "tarobject directory exists");
       existingdir = true;
+    } else if (!statr && S_ISLNK(stab.st_mode) &&
+               !stat(fnamevb.buf, &stabtmp) && S_ISDIR(stabtmp.st_mode)) {
+      debug(dbg_eachfiledetail, "tarobject directory exists as symlink");
+      existingdir = true;
     }
     break;
   case TAR_FILETYPE_FILE:
@@ -891,38 +1738,46 @@ tarobject(void *ctx, struct tar_entry *ti)
         }
       }
 
-      if (does_replace(tc->pkg, &tc->pkg->available,
-                       otherpkg, &otherpkg->installed)) {
-        printf(_("Replacing files in old package %s (%s) ...\n"),
-               pkg_name(otherpkg, pnaw_nonambig),
-               versiondescribe(&otherpkg->installed.version, vdew_nonambig));
-        otherpkg->clientdata->replacingfilesandsaid = 1;
-      } else if (does_replace(otherpkg, &otherpkg->installed,
-                              tc->pkg, &tc->pkg->available)) {
-        printf(_("Replaced by files in installed package %s (%s) ...\n"),
-               pkg_name(otherpkg, pnaw_nonambig),
-               versiondescribe(&otherpkg->installed.version, vdew_nonambig));
-        otherpkg->clientdata->replacingfilesandsaid = 2;
-        nifd->namenode->flags &= ~fnnf_new_inarchive;
-        keepexisting = true;
-      } else {
-        /* At this point we are replacing something without a Replaces. */
-        if (!statr && S_ISDIR(stab.st_mode)) {
-          forcibleerr(fc_overwritedir,
-                      _("trying to overwrite directory '%.250s' "
-                        "in package %.250s %.250s with nondirectory"),
-                      nifd->namenode->name, pkg_name(otherpkg, pnaw_nonambig),
-                      versiondescribe(&otherpkg->installed.version,
-                                      vdew_nonambig));
+      /* Evaluate the Replaces between both packages only once, as it
+       * does not change during the unpack. */
+      if (otherpkg->clientdata->replacingfilesandsaid == 0) {
+        if (does_replace(tc->pkg, &tc->pkg->available,
+                         otherpkg, &otherpkg->installed)) {
+          printf(_("Replacing files in old package %s (%s) ...\n"),
+                 pkg_name(otherpkg, pnaw_nonambig),
+                 versiondescribe(&otherpkg->installed.version, vdew_nonambig));
+          otherpkg->clientdata->replacingfilesandsaid = 1;
+          continue;
+        } else if (does_replace(otherpkg, &otherpkg->installed,
+                                tc->pkg, &tc->pkg->available)) {
+          printf(_("Replaced by files in installed package %s (%s) ...\n"),
+                 pkg_name(otherpkg, pnaw_nonambig),
+                 versiondescribe(&otherpkg->installed.version, vdew_nonambig));
+          otherpkg->clientdata->replacingfilesandsaid = 2;
+          nifd->namenode->flags &= ~fnnf_new_inarchive;
+          keepexisting = true;
+          continue;
         } else {
-          forcibleerr(fc_overwrite,
-                      _("trying to overwrite '%.250s', "
-                        "which is also in package %.250s %.250s"),
-                      nifd->namenode->name, pkg_name(otherpkg, pnaw_nonambig),
-                      versiondescribe(&otherpkg->installed.version,
-                                      vdew_nonambig));
+          otherpkg->clientdata->replacingfilesandsaid = 3;
         }
       }
+
+      /* At this point we are replacing something without a Replaces. */
+      if (!statr && S_ISDIR(stab.st_mode)) {
+        forcibleerr(fc_overwritedir,
+                    _("trying to overwrite directory '%.250s' "
+                      "in package %.250s %.250s with nondirectory"),
+                    nifd->namenode->name, pkg_name(otherpkg, pnaw_nonambig),
+                    versiondescribe(&otherpkg->installed.version,
+                                    vdew_nonambig));
+      } else {
+        forcibleerr(fc_overwrite,
+                    _("trying to overwrite '%.250s', "
+                      "which is also in package %.250s %.250s"),
+                    nifd->namenode->name, pkg_name(otherpkg, pnaw_nonambig),
+                    versiondescribe(&otherpkg->installed.version,
+                                    vdew_nonambig));
+      }
     }
     filepackages_iter_free(iter);
   }
@@ -967,6 +1822,7 @@ tarobject(void *ctx, struct tar_entry *ti)
   } else {
     /* Now, at this stage we want to make sure neither of .dpkg-new and
      * .dpkg-tmp are hanging around. */
+    tar_writer_wait(nifd->namenode);
     path_remove_tree(fnamenewvb.buf);
     path_remove_tree(fnametmpvb.buf);
 
@@ -981,7 +1837,8 @@ tarobject(void *ctx, struct tar_entry *ti)
      */
 
     /* Extract whatever it is as .dpkg-new ... */
-    tarobject_extract(tc, ti, fnamenewvb.buf, &nodestat, nifd->namenode);
+    queued = tarobject_extract(tc, ti, fnamenewvb.buf, &nodestat,
+                               nifd->namenode);
   }
 
   /* For shared files, check now if the object matches. */
@@ -994,8 +1851,11 @@ tarobject(void *ctx, struct tar_entry *ti)
     return 0;
 
   tarobject_set_perms(ti, fnamenewvb.buf, &nodestat);
-  tarobject_set_mtime(ti, fnamenewvb.buf);
-  tarobject_set_se_context(fnamevb.buf, fnamenewvb.buf, nodestat.mode);
+  if (!queued)
+    tarobject_set_mtime(ti, fnamenewvb.buf);
+  /* Regular files have already been handled using the file descriptor. */
+  if (ti->type != TAR_FILETYPE_FILE)
+    tarobject_set_se_context(fnamevb.buf, fnamenewvb.buf, nodestat.mode);
 
   /*
    * CLEANUP: Now we have extracted the new object in .dpkg-new (or,
@@ -1027,6 +1887,8 @@ tarobject(void *ctx, struct tar_entry *ti)
       if (rename(fnamevb.buf,fnametmpvb.buf))
         ohshite(_("unable to move aside '%.255s' to install new version"),
                 ti->name);
+      /* Any cached pathname under it is now stale. */
+      ondisk_stat_flush();
     } else if (S_ISLNK(stab.st_mode)) {
       int rc;
 
@@ -1069,11 +1931,22 @@ tarobject(void *ctx, struct tar_entry *ti)
       ti->type == TAR_FILETYPE_SYMLINK) {
     nifd->namenode->flags |= fnnf_deferred_rename;
 
+    /* Placing or replacing a symlink changes what any pathname through
+     * it refers to. */
+    if (ti->type == TAR_FILETYPE_SYMLINK || (!statr && S_ISLNK(stab.st_mode)))
+      ondisk_stat_deferred_flush = true;
+
     debug(dbg_eachfiledetail, "tarobject done and installation deferred");
   } else {
     if (rename(fnamenewvb.buf, fnamevb.buf))
       ohshite(_("unable to install new version of '%.255s'"), ti->name);
 
+    if (!statr && S_ISLNK(stab.st_mode))
+      ondisk_stat_flush();
+    ondisk_stat_invalidate(statnode);
+    if (statnode && ti->type == TAR_FILETYPE_DIR)
+      statnode->file_ondisk_stat->newdir = true;
+
     /*
      * CLEANUP: Now the new file is in the destination file, and the
      * old file is in .dpkg-tmp to be cleaned up later. We now need
@@ -1090,48 +1963,62 @@ tarobject(void *ctx, struct tar_entry *ti)
   return 0;
 }
 
-#if defined(SYNC_FILE_RANGE_WAIT_BEFORE)
 static void
-tar_writeback_barrier(struct fileinlist *files, struct pkginfo *pkg)
+tar_deferred_sync(struct fileinlist *files, struct pkginfo *pkg)
 {
   struct fileinlist *cfile;
+  struct filenamenode *usenode;
 
   for (cfile = files; cfile; cfile = cfile->next) {
-    struct filenamenode *usenode;
     int fd;
 
-    if (!(cfile->namenode->flags & fnnf_deferred_fsync))
+    if (!(cfile->namenode->flags & fnnf_deferred_rename) ||
+        !(cfile->namenode->flags & fnnf_deferred_fsync))
       continue;
 
+    debug(dbg_eachfiledetail, "deferred extract of '%.255s' needs fsync",
+          cfile->namenode->name);
+
     usenode = namenodetouse(cfile->namenode, pkg, &pkg->available);
 
     setupfnamevbs(usenode->name);
 
-    fd = open(fnamenewvb.buf, O_WRONLY);
+    fd = tar_writeback_take(cfile->namenode);
+    if (fd < 0)
+      fd = open(fnamenewvb.buf, O_WRONLY);
     if (fd < 0)
       ohshite(_("unable to open '%.255s'"), fnamenewvb.buf);
-    /* Ignore the return code as it should be considered equivalent to an
-     * asynchronous hint for the kernel, we are doing an fsync() later on
-     * anyway. */
-    sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE);
+    if (fsync(fd))
+      ohshite(_("unable to sync file '%.255s'"), fnamenewvb.buf);
     if (close(fd))
       ohshite(_("error closing/writing '%.255s'"), fnamenewvb.buf);
+
+    cfile->namenode->flags &= ~fnnf_deferred_fsync;
   }
 }
-#else
-static void
-tar_writeback_barrier(struct fileinlist *files, struct pkginfo *pkg)
-{
-}
-#endif
 
 void
 tar_deferred_extract(struct fileinlist *files, struct pkginfo *pkg)
 {
   struct fileinlist *cfile;
   struct filenamenode *usenode;
+  struct timespec start, end;
+  int nrenames = 0;
+
+  tar_writer_drain();
+
+  /* Start the writeback for any remaining dirty data, so that all the new
+   * files are already being written out by the time the file systems and
+   * files get synced below, ahead of the rename burst. */
+  tar_writeback_start();
+  tar_syncfs_done();
 
-  tar_writeback_barrier(files, pkg);
+  /* Get all the new files onto the disk before putting any of them in
+   * place, so that the renames can be done in a single burst, keeping the
+   * window during which the package is half upgraded as short as possible. */
+  tar_deferred_sync(files, pkg);
+
+  dpkg_clock_get_monotonic(&start);
 
   for (cfile = files; cfile; cfile = cfile->next) {
     debug(dbg_eachfile, "deferred extract of '%.255s'", cfile->namenode->name);
@@ -1143,27 +2030,14 @@ tar_deferred_extract(struct fileinlist *files, struct pkginfo *pkg)
 
     setupfnamevbs(usenode->name);
 
-    if (cfile->namenode->flags & fnnf_deferred_fsync) {
-      int fd;
-
-      debug(dbg_eachfiledetail, "deferred extract needs fsync");
-
-      fd = open(fnamenewvb.buf, O_WRONLY);
-      if (fd < 0)
-        ohshite(_("unable to open '%.255s'"), fnamenewvb.buf);
-      if (fsync(fd))
-        ohshite(_("unable to sync file '%.255s'"), fnamenewvb.buf);
-      if (close(fd))
-        ohshite(_("error closing/writing '%.255s'"), fnamenewvb.buf);
-
-      cfile->namenode->flags &= ~fnnf_deferred_fsync;
-    }
-
     debug(dbg_eachfiledetail, "deferred extract needs rename");
 
     if (rename(fnamenewvb.buf, fnamevb.buf))
       ohshite(_("unable to install new version of '%.255s'"),
               cfile->namenode->name);
+    nrenames++;
+
+    ondisk_stat_invalidate(usenode);
 
     cfile->namenode->flags &= ~fnnf_deferred_rename;
 
@@ -1179,6 +2053,17 @@ tar_deferred_extract(struct fileinlist *files, struct pkginfo *pkg)
 
     debug(dbg_eachfiledetail, "deferred extract done and installed");
   }
+
+  dpkg_clock_get_monotonic(&end);
+  debug(dbg_general, "deferred extract renamed %d files in %.6fs", nrenames,
+        dpkg_clock_elapsed(&start, &end));
+
+  /* Close the descriptors for the files not synced here, such as the new
+   * conffiles. */
+  tar_writeback_reset();
+
+  if (ondisk_stat_deferred_flush)
+    ondisk_stat_flush();
 }
 
 void
@@ -1449,6 +2334,46 @@ void cu_fileslist(int argc, void **argv) {
   tar_pool_release();
 }
 
+/*
+ * In bootstrap mode we unpack into a fresh database, such as when building
+ * a system image, trading the durability of each file and database update
+ * for a single sync of the file systems at the end.
+ */
+static void
+bootstrap_init(void)
+{
+  struct pkgiterator *iter;
+  struct pkginfo *pkg;
+
+  iter = pkg_db_iter_new();
+  while ((pkg = pkg_db_iter_next_pkg(iter))) {
+    if (pkg->status != PKG_STAT_NOTINSTALLED)
+      ohshit(_("cannot bootstrap, package %s is already installed"),
+             pkg_name(pkg, pnaw_nonambig));
+  }
+  pkg_db_iter_free(iter);
+
+  if (f_noact)
+    return;
+
+  fc_unsafe_io = 1;
+  dpkg_db_set_sync_deferred(true);
+}
+
+static void
+bootstrap_done(void)
+{
+  if (f_noact)
+    return;
+
+  /* The maintainer scripts might have written to any file system, not just
+   * the ones holding the installation and administrative directories. */
+  debug(dbg_general, "bootstrap syncing file systems");
+  sync();
+
+  dpkg_db_set_sync_deferred(false);
+}
+
 int
 archivefiles(const char *const *argv)
 {
@@ -1474,6 +2399,9 @@ archivefiles(const char *const *argv)
   checkpath();
   pkg_infodb_upgrade();
 
+  if (f_bootstrap)
+    bootstrap_init();
+
   log_message("startup archives %s", cipaction->olong);
 
   if (f_recursive) {
@@ -1589,6 +2517,9 @@ archivefiles(const char *const *argv)
   trigproc_run_deferred();
   modstatdb_shutdown();
 
+  if (f_bootstrap)
+    bootstrap_done();
+
   return 0;
 }
 
@@ -57,6 +57,7 @@ void cu_fileslist(int argc, void **argv);
 void cu_backendpipe(int argc, void **argv);
 
 void cu_installnew(int argc, void **argv);
+void cu_writeback(int argc, void **argv);
 
 void cu_prermupgrade(int argc, void **argv);
 void cu_prerminfavour(int argc, void **argv);
@@ -70,9 +71,16 @@ void ok_prermdeconfigure(int argc, void **argv);
 
 void setupfnamevbs(const char *filename);
 
+int ondisk_lstat(struct filenamenode *namenode, const char *path,
+                 struct stat *st);
+void ondisk_stat_invalidate(struct filenamenode *namenode);
+
 int tarobject(void *ctx, struct tar_entry *ti);
 int tarfileread(void *ud, char *buf, int len);
 void tar_deferred_extract(struct fileinlist *files, struct pkginfo *pkg);
+void tar_syncfs_reset(void);
+void tar_writeback_reset(void);
+void tar_writer_abort(void);
 
 struct fileinlist *
 tar_filenamenode_queue_push(struct filenamenode_queue *queue,
@@ -71,6 +71,9 @@ void cu_installnew(int argc, void **argv) {
 
   cleanup_pkg_failed++; cleanup_conflictor_failed++;
 
+  /* Make sure no file writer job is still creating files behind us. */
+  tar_writer_abort();
+
   debug(dbg_eachfile, "cu_installnew '%s' flags=%o",
         namenode->name, namenode->flags);
 
@@ -109,9 +112,19 @@ void cu_installnew(int argc, void **argv) {
     ohshite(_("unable to remove newly-extracted version of '%.250s'"),
             namenode->name);
 
+  ondisk_stat_flush();
+
   cleanup_pkg_failed--; cleanup_conflictor_failed--;
 }
 
+/*
+ * Release the descriptors kept for the deferred syncs of a package whose
+ * unpacking failed.
+ */
+void cu_writeback(int argc, void **argv) {
+  tar_writeback_reset();
+}
+
 void cu_prermupgrade(int argc, void **argv) {
   struct pkginfo *pkg= (struct pkginfo*)argv[0];
 
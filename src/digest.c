@@ -0,0 +1,265 @@
+/*
+ * dpkg-digest - compute file message digests
+ *
+ * Copyright © 2018 Guillem Jover <guillem@debian.org>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/i18n.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/error.h>
+#include <dpkg/fdio.h>
+#include <dpkg/buffer.h>
+#include <dpkg/options.h>
+
+#include "file-jobs.h"
+
+enum digest_type {
+	DIGEST_MD5,
+	DIGEST_SHA1,
+	DIGEST_SHA256,
+	DIGEST_MAX,
+};
+
+static const char *const digest_names[DIGEST_MAX] = {
+	[DIGEST_MD5] = "md5",
+	[DIGEST_SHA1] = "sha1",
+	[DIGEST_SHA256] = "sha256",
+};
+
+/* The digests to print, in the requested order. */
+static enum digest_type digest_list[DIGEST_MAX] = {
+	DIGEST_MD5, DIGEST_SHA1, DIGEST_SHA256,
+};
+static int digest_nlist = DIGEST_MAX;
+
+static int opt_jobs;
+
+static const char printforhelp[] = N_(
+"Use --help for help about computing file digests.");
+
+static void DPKG_ATTR_NORET
+printversion(const struct cmdinfo *ci, const char *value)
+{
+	printf(_("Debian %s version %s.\n"), dpkg_get_progname(),
+	       PACKAGE_RELEASE);
+
+	printf(_(
+"This is free software; see the GNU General Public License version 2 or\n"
+"later for copying conditions. There is NO warranty.\n"));
+
+	m_output(stdout, _("<standard output>"));
+
+	exit(0);
+}
+
+static void DPKG_ATTR_NORET
+usage(const struct cmdinfo *ci, const char *value)
+{
+	printf(_(
+"Usage: %s [<option>...] <file>...\n"
+"\n"), dpkg_get_progname());
+
+	printf(_(
+"Computes the message digests needed by Dpkg::Checksums, reading each\n"
+"file once, one tab-separated record per line.\n"
+"\n"));
+
+	printf(_(
+"Options:\n"
+"  --digests=<list>             Comma-separated list of digests to compute\n"
+"                                 (md5, sha1, sha256; default is all).\n"
+"  --jobs=<n>                   Process files using up to <n> parallel jobs.\n"
+"  -?, --help                   Show this help message.\n"
+"      --version                Show the version.\n"
+"\n"));
+
+	m_output(stdout, _("<standard output>"));
+
+	exit(0);
+}
+
+static void
+set_digests(const struct cmdinfo *cip, const char *value)
+{
+	char *list, *name, *next;
+	unsigned int seen = 0;
+
+	digest_nlist = 0;
+
+	list = m_strdup(value);
+	for (name = list; name; name = next) {
+		enum digest_type type;
+
+		next = strchr(name, ',');
+		if (next)
+			*next++ = '\0';
+
+		for (type = 0; type < DIGEST_MAX; type++)
+			if (strcmp(name, digest_names[type]) == 0)
+				break;
+		if (type == DIGEST_MAX)
+			badusage(_("unknown digest '%s' for --%s"),
+			         name, cip->olong);
+		if (seen & (1U << type))
+			badusage(_("duplicate digest '%s' for --%s"),
+			         name, cip->olong);
+
+		seen |= 1U << type;
+		digest_list[digest_nlist++] = type;
+	}
+	free(list);
+}
+
+static off_t
+digest_file(const char *filename, char hashes[DIGEST_MAX][SHA256HASHLEN + 1],
+            struct dpkg_error *err)
+{
+	struct buffer_digests digests = { 0 };
+	off_t size;
+	int fd;
+	int i;
+
+	for (i = 0; i < digest_nlist; i++) {
+		switch (digest_list[i]) {
+		case DIGEST_MD5:
+			digests.md5 = hashes[DIGEST_MD5];
+			break;
+		case DIGEST_SHA1:
+			digests.sha1 = hashes[DIGEST_SHA1];
+			break;
+		case DIGEST_SHA256:
+			digests.sha256 = hashes[DIGEST_SHA256];
+			break;
+		default:
+			internerr("unknown digest type %d", digest_list[i]);
+		}
+	}
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return dpkg_put_errno(err, _("cannot open file"));
+
+#ifdef HAVE_POSIX_FADVISE
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	size = fd_digests(fd, &digests, -1, err);
+	close(fd);
+
+	return size;
+}
+
+/*
+ * Print one record per file, either «ok», the size and the digests in the
+ * requested order, or «error» and the reason; the filename always comes
+ * last.
+ */
+static void
+digest_files(const char *const *files, int nfiles, FILE *out)
+{
+	int i;
+
+	for (i = 0; i < nfiles; i++) {
+		struct dpkg_error err = DPKG_ERROR_INIT;
+		char hashes[DIGEST_MAX][SHA256HASHLEN + 1];
+		off_t size;
+		int j;
+
+		size = digest_file(files[i], hashes, &err);
+		if (size < 0) {
+			fprintf(out, "error\t%s\t%s\n", err.str, files[i]);
+			dpkg_error_destroy(&err);
+			continue;
+		}
+
+		fprintf(out, "ok\t%jd", (intmax_t)size);
+		for (j = 0; j < digest_nlist; j++)
+			fprintf(out, "\t%s", hashes[digest_list[j]]);
+		fprintf(out, "\t%s\n", files[i]);
+	}
+}
+
+/*
+ * Get the file sizes, so that the parallel jobs get chunks of roughly the
+ * same total size.
+ */
+static off_t *
+digest_get_sizes(const char *const *files, int nfiles)
+{
+	off_t *sizes;
+	int i;
+
+	sizes = m_malloc(nfiles * sizeof(*sizes));
+	for (i = 0; i < nfiles; i++) {
+		struct stat st;
+
+		/* Any error will get reported by the job handling the file. */
+		if (stat(files[i], &st) == 0 && S_ISREG(st.st_mode))
+			sizes[i] = st.st_size;
+		else
+			sizes[i] = 0;
+	}
+
+	return sizes;
+}
+
+static const struct cmdinfo cmdinfos[] = {
+	{ "digests", 0,   1, NULL, NULL, set_digests  },
+	{ "jobs",    0,   1, NULL, NULL, file_jobs_set_option, 0, &opt_jobs },
+	{ "help",    '?', 0, NULL, NULL, usage        },
+	{ "version", 0,   0, NULL, NULL, printversion },
+	{ NULL,      0,   0, NULL, NULL, NULL         }
+};
+
+int
+main(int argc, const char *const *argv)
+{
+	off_t *sizes;
+	int nfiles;
+
+	dpkg_locales_init(PACKAGE);
+	dpkg_program_init("dpkg-digest");
+	dpkg_options_parse(&argv, cmdinfos, printforhelp);
+
+	if (!*argv)
+		badusage(_("need at least one file argument"));
+
+	for (nfiles = 0; argv[nfiles]; nfiles++)
+		;
+
+	sizes = digest_get_sizes(argv, nfiles);
+	file_jobs_run(argv, nfiles, opt_jobs, sizes, digest_files,
+	              _("digest job"));
+	free(sizes);
+
+	dpkg_program_done();
+
+	return 0;
+}
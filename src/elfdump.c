@@ -0,0 +1,1078 @@
+/*
+ * dpkg-elfdump - dump ELF dynamic linking information
+ *
+ * Copyright © 2018 Guillem Jover <guillem@debian.org>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/i18n.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/error.h>
+#include <dpkg/options.h>
+
+#include "file-jobs.h"
+
+/*
+ * The ELF structures are decoded by hand from the raw file contents, so
+ * that we can handle objects for any class and byte order, regardless of
+ * what the build system <elf.h> supports.
+ */
+
+#define ELF_EI_CLASS		4
+#define ELF_EI_DATA		5
+#define ELF_EI_VERSION		6
+#define ELF_EI_NIDENT		16
+
+#define ELF_CLASS_32		1
+#define ELF_CLASS_64		2
+#define ELF_DATA_2LSB		1
+#define ELF_DATA_2MSB		2
+
+#define ELF_ET_REL		1
+#define ELF_ET_EXEC		2
+#define ELF_ET_DYN		3
+
+#define ELF_PT_INTERP		3
+
+#define ELF_SHN_UNDEF		0
+#define ELF_SHN_LORESERVE	0xff00
+#define ELF_SHN_ABS		0xfff1
+#define ELF_SHN_COMMON		0xfff2
+#define ELF_SHN_XINDEX		0xffff
+
+#define ELF_SHT_SYMTAB		2
+#define ELF_SHT_RELA		4
+#define ELF_SHT_DYNAMIC		6
+#define ELF_SHT_REL		9
+#define ELF_SHT_DYNSYM		11
+#define ELF_SHT_GNU_VERDEF	0x6ffffffd
+#define ELF_SHT_GNU_VERNEED	0x6ffffffe
+#define ELF_SHT_GNU_VERSYM	0x6fffffff
+
+#define ELF_DT_NULL		0
+#define ELF_DT_NEEDED		1
+#define ELF_DT_HASH		4
+#define ELF_DT_SONAME		14
+#define ELF_DT_RPATH		15
+#define ELF_DT_RUNPATH		29
+#define ELF_DT_GNU_HASH		0x6ffffef5
+
+#define ELF_STB_LOCAL		0
+#define ELF_STB_GLOBAL		1
+#define ELF_STB_WEAK		2
+#define ELF_STB_GNU_UNIQUE	10
+
+#define ELF_STT_OBJECT		1
+#define ELF_STT_FUNC		2
+#define ELF_STT_SECTION		3
+#define ELF_STT_FILE		4
+#define ELF_STT_GNU_IFUNC	10
+
+#define ELF_STV_INTERNAL	1
+#define ELF_STV_HIDDEN		2
+#define ELF_STV_PROTECTED	3
+
+#define ELF_VER_FLG_BASE	0x1
+#define ELF_VERSYM_HIDDEN	0x8000
+#define ELF_VERSYM_VERSION	0x7fff
+
+#define ELF_EM_SPARC		2
+#define ELF_EM_386		3
+#define ELF_EM_68K		4
+#define ELF_EM_MIPS		8
+#define ELF_EM_SPARC32PLUS	18
+#define ELF_EM_PPC		20
+#define ELF_EM_PPC64		21
+#define ELF_EM_S390		22
+#define ELF_EM_ARM		40
+#define ELF_EM_SH		42
+#define ELF_EM_SPARCV9		43
+#define ELF_EM_X86_64		62
+#define ELF_EM_AARCH64		183
+#define ELF_EM_RISCV		243
+#define ELF_EM_LOONGARCH	258
+#define ELF_EM_ALPHA		0x9026
+
+struct elf_file {
+	const unsigned char *data;
+	size_t size;
+
+	bool is64;
+	bool msb;
+	unsigned int type;
+	unsigned int machine;
+
+	uint64_t phoff;
+	unsigned int phnum;
+	unsigned int phentsize;
+
+	uint64_t shoff;
+	unsigned int shnum;
+	unsigned int shentsize;
+	unsigned int shstrndx;
+};
+
+struct elf_shdr {
+	uint32_t name;
+	uint32_t type;
+	uint64_t offset;
+	uint64_t size;
+	uint32_t link;
+	uint32_t info;
+	uint64_t entsize;
+};
+
+struct elf_version {
+	const char *name;
+	unsigned int flags;
+};
+
+struct elf_versions {
+	/* Version definitions, indexed by vd_ndx - 1. */
+	struct elf_version *def;
+	unsigned int ndefs;
+
+	/* Version requirements, indexed by vna_other. */
+	const char **need;
+	unsigned int nneeds;
+};
+
+struct elf_reloc_copy {
+	unsigned int machine;
+	unsigned int type;
+	const char *name;
+};
+
+/*
+ * The copy relocation type for each supported machine, the only dynamic
+ * relocations we care about, as these turn defined symbols in executables
+ * into references to the library ones.
+ */
+static const struct elf_reloc_copy elf_reloc_copy[] = {
+	{ ELF_EM_SPARC,		19,	"R_SPARC_COPY" },
+	{ ELF_EM_386,		5,	"R_386_COPY" },
+	{ ELF_EM_68K,		19,	"R_68K_COPY" },
+	{ ELF_EM_MIPS,		126,	"R_MIPS_COPY" },
+	{ ELF_EM_SPARC32PLUS,	19,	"R_SPARC_COPY" },
+	{ ELF_EM_PPC,		19,	"R_PPC_COPY" },
+	{ ELF_EM_PPC64,		19,	"R_PPC64_COPY" },
+	{ ELF_EM_S390,		9,	"R_390_COPY" },
+	{ ELF_EM_ARM,		20,	"R_ARM_COPY" },
+	{ ELF_EM_SH,		162,	"R_SH_COPY" },
+	{ ELF_EM_SPARCV9,	19,	"R_SPARC_COPY" },
+	{ ELF_EM_X86_64,	5,	"R_X86_64_COPY" },
+	{ ELF_EM_AARCH64,	1024,	"R_AARCH64_COPY" },
+	{ ELF_EM_RISCV,		4,	"R_RISCV_COPY" },
+	{ ELF_EM_LOONGARCH,	4,	"R_LARCH_COPY" },
+	{ ELF_EM_ALPHA,		24,	"R_ALPHA_COPY" },
+	{ 0,			0,	NULL },
+};
+
+static int opt_jobs;
+
+static const char printforhelp[] = N_(
+"Use --help for help about dumping ELF objects.");
+
+static void DPKG_ATTR_NORET
+printversion(const struct cmdinfo *ci, const char *value)
+{
+	printf(_("Debian %s version %s.\n"), dpkg_get_progname(),
+	       PACKAGE_RELEASE);
+
+	printf(_(
+"This is free software; see the GNU General Public License version 2 or\n"
+"later for copying conditions. There is NO warranty.\n"));
+
+	m_output(stdout, _("<standard output>"));
+
+	exit(0);
+}
+
+static void DPKG_ATTR_NORET
+usage(const struct cmdinfo *ci, const char *value)
+{
+	printf(_(
+"Usage: %s [<option>...] <file>...\n"
+"\n"), dpkg_get_progname());
+
+	printf(_(
+"Dumps the ELF dynamic linking information needed by dpkg-shlibdeps and\n"
+"dpkg-gensymbols, one tab-separated record per line.\n"
+"\n"));
+
+	printf(_(
+"Options:\n"
+"  --jobs=<n>                   Scan using up to <n> parallel jobs.\n"
+"  -?, --help                   Show this help message.\n"
+"      --version                Show the version.\n"
+"\n"));
+
+	m_output(stdout, _("<standard output>"));
+
+	exit(0);
+}
+
+static uint16_t
+elf_get16(const struct elf_file *ef, const unsigned char *p)
+{
+	if (ef->msb)
+		return (uint16_t)p[0] << 8 | p[1];
+	else
+		return (uint16_t)p[1] << 8 | p[0];
+}
+
+static uint32_t
+elf_get32(const struct elf_file *ef, const unsigned char *p)
+{
+	if (ef->msb)
+		return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+		       (uint32_t)p[2] << 8 | p[3];
+	else
+		return (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 |
+		       (uint32_t)p[1] << 8 | p[0];
+}
+
+static uint64_t
+elf_get64(const struct elf_file *ef, const unsigned char *p)
+{
+	if (ef->msb)
+		return (uint64_t)elf_get32(ef, p) << 32 | elf_get32(ef, p + 4);
+	else
+		return (uint64_t)elf_get32(ef, p + 4) << 32 | elf_get32(ef, p);
+}
+
+/* Get a class sized word, that is an Elf32_Addr or an Elf64_Addr. */
+static uint64_t
+elf_getword(const struct elf_file *ef, const unsigned char *p)
+{
+	if (ef->is64)
+		return elf_get64(ef, p);
+	else
+		return elf_get32(ef, p);
+}
+
+static const unsigned char *
+elf_ptr(const struct elf_file *ef, uint64_t offset, uint64_t size)
+{
+	if (offset > ef->size || size > ef->size - offset)
+		return NULL;
+
+	return ef->data + offset;
+}
+
+static int
+elf_parse_header(struct elf_file *ef, struct dpkg_error *err)
+{
+	const unsigned char *eh = ef->data;
+
+	if (ef->size < ELF_EI_NIDENT || memcmp(eh, "\177ELF", 4) != 0)
+		return dpkg_put_error(err, _("not an ELF file"));
+
+	if (eh[ELF_EI_CLASS] == ELF_CLASS_32)
+		ef->is64 = false;
+	else if (eh[ELF_EI_CLASS] == ELF_CLASS_64)
+		ef->is64 = true;
+	else
+		return dpkg_put_error(err, _("unknown ELF class %d"),
+		                      eh[ELF_EI_CLASS]);
+
+	if (eh[ELF_EI_DATA] == ELF_DATA_2LSB)
+		ef->msb = false;
+	else if (eh[ELF_EI_DATA] == ELF_DATA_2MSB)
+		ef->msb = true;
+	else
+		return dpkg_put_error(err, _("unknown ELF byte order %d"),
+		                      eh[ELF_EI_DATA]);
+
+	if (ef->size < (ef->is64 ? 64U : 52U))
+		return dpkg_put_error(err, _("truncated ELF header"));
+
+	ef->type = elf_get16(ef, eh + 16);
+	ef->machine = elf_get16(ef, eh + 18);
+
+	if (ef->is64) {
+		ef->phoff = elf_get64(ef, eh + 32);
+		ef->shoff = elf_get64(ef, eh + 40);
+		eh += 54;
+	} else {
+		ef->phoff = elf_get32(ef, eh + 28);
+		ef->shoff = elf_get32(ef, eh + 32);
+		eh += 42;
+	}
+	ef->phentsize = elf_get16(ef, eh + 0);
+	ef->phnum = elf_get16(ef, eh + 2);
+	ef->shentsize = elf_get16(ef, eh + 4);
+	ef->shnum = elf_get16(ef, eh + 6);
+	ef->shstrndx = elf_get16(ef, eh + 8);
+
+	if (ef->phnum && ef->phentsize < (ef->is64 ? 56U : 32U))
+		return dpkg_put_error(err, _("invalid program header size"));
+	if (ef->shoff && ef->shentsize < (ef->is64 ? 64U : 40U))
+		return dpkg_put_error(err, _("invalid section header size"));
+
+	return 0;
+}
+
+static int
+elf_get_shdr(const struct elf_file *ef, unsigned int idx,
+             struct elf_shdr *sh)
+{
+	const unsigned char *p;
+
+	if (ef->shoff == 0)
+		return -1;
+	p = elf_ptr(ef, ef->shoff + (uint64_t)idx * ef->shentsize,
+	            ef->shentsize);
+	if (p == NULL)
+		return -1;
+
+	sh->name = elf_get32(ef, p + 0);
+	sh->type = elf_get32(ef, p + 4);
+	if (ef->is64) {
+		sh->offset = elf_get64(ef, p + 24);
+		sh->size = elf_get64(ef, p + 32);
+		sh->link = elf_get32(ef, p + 40);
+		sh->info = elf_get32(ef, p + 44);
+		sh->entsize = elf_get64(ef, p + 56);
+	} else {
+		sh->offset = elf_get32(ef, p + 16);
+		sh->size = elf_get32(ef, p + 20);
+		sh->link = elf_get32(ef, p + 24);
+		sh->info = elf_get32(ef, p + 28);
+		sh->entsize = elf_get32(ef, p + 36);
+	}
+
+	return 0;
+}
+
+static int
+elf_parse_sections(struct elf_file *ef, struct dpkg_error *err)
+{
+	struct elf_shdr sh;
+
+	if (ef->shoff == 0)
+		return 0;
+
+	/* Handle the extended section numbering. */
+	if (ef->shnum == 0 || ef->shstrndx == ELF_SHN_XINDEX) {
+		if (elf_get_shdr(ef, 0, &sh) < 0)
+			return dpkg_put_error(err, _("truncated section headers"));
+		if (ef->shnum == 0)
+			ef->shnum = sh.size;
+		if (ef->shstrndx == ELF_SHN_XINDEX)
+			ef->shstrndx = sh.link;
+	}
+
+	if (elf_ptr(ef, ef->shoff, (uint64_t)ef->shnum * ef->shentsize) == NULL)
+		return dpkg_put_error(err, _("truncated section headers"));
+
+	return 0;
+}
+
+/*
+ * Get a NUL-terminated string from a string table section, or NULL if it
+ * is out of bounds.
+ */
+static const char *
+elf_get_str(const struct elf_file *ef, const struct elf_shdr *strtab,
+            uint64_t offset)
+{
+	const unsigned char *str;
+
+	if (offset >= strtab->size)
+		return NULL;
+	str = elf_ptr(ef, strtab->offset + offset, strtab->size - offset);
+	if (str == NULL)
+		return NULL;
+	if (memchr(str, '\0', strtab->size - offset) == NULL)
+		return NULL;
+
+	return (const char *)str;
+}
+
+static int
+elf_get_strtab(const struct elf_file *ef, const struct elf_shdr *sh,
+               struct elf_shdr *strtab, struct dpkg_error *err)
+{
+	if (sh->link >= ef->shnum || elf_get_shdr(ef, sh->link, strtab) < 0)
+		return dpkg_put_error(err, _("invalid string table link %u"),
+		                      sh->link);
+
+	return 0;
+}
+
+static const char *
+elf_get_section_name(const struct elf_file *ef, unsigned int idx)
+{
+	struct elf_shdr shstrtab, sh;
+	const char *name;
+
+	if (idx >= ef->shnum || elf_get_shdr(ef, idx, &sh) < 0)
+		return "*ABS*";
+	if (ef->shstrndx >= ef->shnum ||
+	    elf_get_shdr(ef, ef->shstrndx, &shstrtab) < 0)
+		return "*ABS*";
+	name = elf_get_str(ef, &shstrtab, sh.name);
+	if (name == NULL || name[0] == '\0')
+		return "*ABS*";
+
+	return name;
+}
+
+static bool
+elf_has_interp(const struct elf_file *ef)
+{
+	unsigned int i;
+
+	for (i = 0; i < ef->phnum; i++) {
+		const unsigned char *p;
+
+		p = elf_ptr(ef, ef->phoff + (uint64_t)i * ef->phentsize,
+		            ef->phentsize);
+		if (p == NULL)
+			break;
+		if (elf_get32(ef, p) == ELF_PT_INTERP)
+			return true;
+	}
+
+	return false;
+}
+
+static int
+elf_dump_dynamic(const struct elf_file *ef, const struct elf_shdr *sh,
+                 FILE *out, struct dpkg_error *err)
+{
+	struct elf_shdr strtab;
+	unsigned int entsize = ef->is64 ? 16 : 8;
+	uint64_t i;
+
+	if (elf_get_strtab(ef, sh, &strtab, err) < 0)
+		return -1;
+	if (elf_ptr(ef, sh->offset, sh->size) == NULL)
+		return dpkg_put_error(err, _("truncated dynamic section"));
+
+	for (i = 0; i + entsize <= sh->size; i += entsize) {
+		const unsigned char *p = ef->data + sh->offset + i;
+		const char *field, *str;
+		uint64_t tag, val;
+
+		tag = elf_getword(ef, p);
+		val = elf_getword(ef, p + entsize / 2);
+
+		if (tag == ELF_DT_NULL)
+			break;
+
+		switch (tag) {
+		case ELF_DT_NEEDED:
+			field = "needed";
+			break;
+		case ELF_DT_SONAME:
+			field = "soname";
+			break;
+		case ELF_DT_RPATH:
+			field = "rpath";
+			break;
+		case ELF_DT_RUNPATH:
+			field = "runpath";
+			break;
+		case ELF_DT_HASH:
+			/* Print addresses zero-padded like objdump does. */
+			fprintf(out, "hash\t0x%0*llx\n", ef->is64 ? 16 : 8,
+			        (unsigned long long)val);
+			continue;
+		case ELF_DT_GNU_HASH:
+			fprintf(out, "gnu-hash\t0x%0*llx\n", ef->is64 ? 16 : 8,
+			        (unsigned long long)val);
+			continue;
+		default:
+			continue;
+		}
+
+		str = elf_get_str(ef, &strtab, val);
+		if (str == NULL)
+			return dpkg_put_error(err, _("invalid dynamic string "
+			                             "offset %llu"),
+			                      (unsigned long long)val);
+		fprintf(out, "%s\t%s\n", field, str);
+	}
+
+	return 0;
+}
+
+static void
+elf_versions_destroy(struct elf_versions *vers)
+{
+	free(vers->def);
+	free(vers->need);
+}
+
+static int
+elf_parse_verdef(const struct elf_file *ef, const struct elf_shdr *sh,
+                 struct elf_versions *vers, struct dpkg_error *err)
+{
+	struct elf_shdr strtab;
+	uint64_t offset = 0;
+	unsigned int n;
+
+	if (elf_get_strtab(ef, sh, &strtab, err) < 0)
+		return -1;
+
+	for (n = 0; n < sh->info; n++) {
+		const unsigned char *vd, *vda;
+		unsigned int ndx;
+
+		vd = elf_ptr(ef, sh->offset + offset, 20);
+		if (vd == NULL || offset + 20 > sh->size)
+			return dpkg_put_error(err, _("truncated version "
+			                             "definitions"));
+
+		ndx = elf_get16(ef, vd + 4) & ELF_VERSYM_VERSION;
+		if (ndx == 0)
+			return dpkg_put_error(err, _("invalid version "
+			                             "definition index"));
+		if (ndx > vers->ndefs) {
+			vers->def = m_realloc(vers->def,
+			                      ndx * sizeof(*vers->def));
+			memset(vers->def + vers->ndefs, 0,
+			       (ndx - vers->ndefs) * sizeof(*vers->def));
+			vers->ndefs = ndx;
+		}
+		vers->def[ndx - 1].flags = elf_get16(ef, vd + 2);
+
+		if (elf_get16(ef, vd + 6) > 0) {
+			vda = elf_ptr(ef, sh->offset + offset +
+			              elf_get32(ef, vd + 12), 8);
+			if (vda == NULL)
+				return dpkg_put_error(err, _("truncated version "
+				                             "definitions"));
+			vers->def[ndx - 1].name =
+				elf_get_str(ef, &strtab, elf_get32(ef, vda));
+		}
+
+		if (elf_get32(ef, vd + 16) == 0)
+			break;
+		offset += elf_get32(ef, vd + 16);
+	}
+
+	return 0;
+}
+
+static int
+elf_parse_verneed(const struct elf_file *ef, const struct elf_shdr *sh,
+                  struct elf_versions *vers, struct dpkg_error *err)
+{
+	struct elf_shdr strtab;
+	uint64_t offset = 0;
+	unsigned int n;
+
+	if (elf_get_strtab(ef, sh, &strtab, err) < 0)
+		return -1;
+
+	for (n = 0; n < sh->info; n++) {
+		const unsigned char *vn;
+		uint64_t auxoffset;
+		unsigned int i, cnt;
+
+		vn = elf_ptr(ef, sh->offset + offset, 16);
+		if (vn == NULL || offset + 16 > sh->size)
+			return dpkg_put_error(err, _("truncated version "
+			                             "requirements"));
+
+		cnt = elf_get16(ef, vn + 2);
+		auxoffset = offset + elf_get32(ef, vn + 8);
+		for (i = 0; i < cnt; i++) {
+			const unsigned char *vna;
+			unsigned int other;
+
+			vna = elf_ptr(ef, sh->offset + auxoffset, 16);
+			if (vna == NULL)
+				return dpkg_put_error(err, _("truncated version "
+				                             "requirements"));
+
+			other = elf_get16(ef, vna + 6) & ELF_VERSYM_VERSION;
+			if (other >= vers->nneeds) {
+				vers->need = m_realloc(vers->need,
+				                       (other + 1) * sizeof(*vers->need));
+				memset(vers->need + vers->nneeds, 0,
+				       (other + 1 - vers->nneeds) * sizeof(*vers->need));
+				vers->nneeds = other + 1;
+			}
+			vers->need[other] = elf_get_str(ef, &strtab,
+			                                elf_get32(ef, vna + 8));
+
+			if (elf_get32(ef, vna + 12) == 0)
+				break;
+			auxoffset += elf_get32(ef, vna + 12);
+		}
+
+		if (elf_get32(ef, vn + 12) == 0)
+			break;
+		offset += elf_get32(ef, vn + 12);
+	}
+
+	return 0;
+}
+
+/*
+ * Resolve the symbol version string, following the same rules as the
+ * binutils BFD library, so that the output matches «objdump -T».
+ */
+static const char *
+elf_get_symbol_version(const struct elf_versions *vers, unsigned int versym,
+                       bool *hidden)
+{
+	unsigned int vernum = versym & ELF_VERSYM_VERSION;
+
+	*hidden = (versym & ELF_VERSYM_HIDDEN) != 0;
+
+	if (vernum == 0)
+		return "";
+	if (vernum == 1 &&
+	    (vernum > vers->ndefs || vers->def[0].flags == ELF_VER_FLG_BASE))
+		return "Base";
+	if (vernum <= vers->ndefs)
+		return vers->def[vernum - 1].name ? vers->def[vernum - 1].name : "";
+	if (vernum < vers->nneeds && vers->need[vernum]) {
+		*hidden = true;
+		return vers->need[vernum];
+	}
+
+	return "<corrupt>";
+}
+
+static void
+elf_symbol_flags(unsigned int info, unsigned int shndx, char *flags)
+{
+	unsigned int bind = info >> 4;
+	unsigned int type = info & 0xf;
+
+	memset(flags, ' ', 7);
+	flags[7] = '\0';
+
+	if (bind == ELF_STB_LOCAL)
+		flags[0] = 'l';
+	else if (bind == ELF_STB_GLOBAL &&
+	         shndx != ELF_SHN_UNDEF && shndx != ELF_SHN_COMMON)
+		flags[0] = 'g';
+	else if (bind == ELF_STB_GNU_UNIQUE)
+		flags[0] = 'u';
+	else if (bind == ELF_STB_WEAK)
+		flags[1] = 'w';
+
+	if (type == ELF_STT_GNU_IFUNC)
+		flags[4] = 'i';
+
+	if (type == ELF_STT_SECTION || type == ELF_STT_FILE)
+		flags[5] = 'd';
+	else
+		flags[5] = 'D';
+
+	if (type == ELF_STT_FUNC)
+		flags[6] = 'F';
+	else if (type == ELF_STT_FILE)
+		flags[6] = 'f';
+	else if (type == ELF_STT_OBJECT)
+		flags[6] = 'O';
+}
+
+static int
+elf_dump_symbols(const struct elf_file *ef, const struct elf_shdr *sh,
+                 const struct elf_shdr *versym,
+                 const struct elf_versions *vers,
+                 FILE *out, struct dpkg_error *err)
+{
+	struct elf_shdr strtab;
+	unsigned int entsize = ef->is64 ? 24 : 16;
+	uint64_t nsyms, i;
+
+	if (elf_get_strtab(ef, sh, &strtab, err) < 0)
+		return -1;
+	if (elf_ptr(ef, sh->offset, sh->size) == NULL)
+		return dpkg_put_error(err, _("truncated dynamic symbol table"));
+	if (versym && elf_ptr(ef, versym->offset, versym->size) == NULL)
+		versym = NULL;
+
+	nsyms = sh->size / entsize;
+	for (i = 1; i < nsyms; i++) {
+		const unsigned char *p = ef->data + sh->offset + i * entsize;
+		const char *name, *section, *version, *visibility;
+		unsigned int info, other, shndx;
+		char vis[8];
+		char flags[8];
+		bool hidden = false;
+
+		if (ef->is64) {
+			info = p[4];
+			other = p[5];
+			shndx = elf_get16(ef, p + 6);
+		} else {
+			info = p[12];
+			other = p[13];
+			shndx = elf_get16(ef, p + 14);
+		}
+
+		elf_symbol_flags(info, shndx, flags);
+
+		if (shndx == ELF_SHN_UNDEF)
+			section = "*UND*";
+		else if (shndx == ELF_SHN_COMMON)
+			section = "*COM*";
+		else if (shndx >= ELF_SHN_LORESERVE)
+			section = "*ABS*";
+		else
+			section = elf_get_section_name(ef, shndx);
+
+		name = elf_get_str(ef, &strtab, elf_get32(ef, p));
+		if (name == NULL)
+			return dpkg_put_error(err, _("invalid symbol name "
+			                             "offset"));
+		if (name[0] == '\0' && (info & 0xf) == ELF_STT_SECTION)
+			name = section;
+
+		if (versym && (i + 1) * 2 <= versym->size)
+			version = elf_get_symbol_version(vers,
+				elf_get16(ef, ef->data + versym->offset + i * 2),
+				&hidden);
+		else
+			version = "";
+
+		switch (other & 0x3) {
+		case ELF_STV_INTERNAL:
+			visibility = "internal";
+			break;
+		case ELF_STV_HIDDEN:
+			visibility = "hidden";
+			break;
+		case ELF_STV_PROTECTED:
+			visibility = "protected";
+			break;
+		default:
+			if (other & ~0x3U) {
+				snprintf(vis, sizeof(vis), "0x%02x", other);
+				visibility = vis;
+			} else {
+				visibility = "";
+			}
+			break;
+		}
+
+		fprintf(out, "sym\t%s\t%s\t%s\t%s\t%s\t%s\n", flags, section,
+		        version, hidden ? "1" : "", visibility, name);
+	}
+
+	return 0;
+}
+
+static const char *
+elf_get_reloc_copy(const struct elf_file *ef, unsigned int *type)
+{
+	int i;
+
+	for (i = 0; elf_reloc_copy[i].name; i++) {
+		if (elf_reloc_copy[i].machine == ef->machine) {
+			*type = elf_reloc_copy[i].type;
+			return elf_reloc_copy[i].name;
+		}
+	}
+
+	return NULL;
+}
+
+static int
+elf_dump_relocs(const struct elf_file *ef, const struct elf_shdr *sh,
+                const struct elf_shdr *dynsym, FILE *out,
+                struct dpkg_error *err)
+{
+	struct elf_shdr strtab;
+	const char *copyname;
+	unsigned int copytype;
+	uint64_t entsize, i;
+	unsigned int symsize = ef->is64 ? 24 : 16;
+
+	copyname = elf_get_reloc_copy(ef, &copytype);
+	if (copyname == NULL)
+		return 0;
+
+	if (elf_get_strtab(ef, dynsym, &strtab, err) < 0)
+		return -1;
+
+	entsize = sh->entsize;
+	if (entsize == 0) {
+		entsize = ef->is64 ? 16 : 8;
+		if (sh->type == ELF_SHT_RELA)
+			entsize += ef->is64 ? 8 : 4;
+	}
+	if (entsize < (ef->is64 ? 16U : 8U) ||
+	    elf_ptr(ef, sh->offset, sh->size) == NULL)
+		return dpkg_put_error(err, _("invalid relocation section"));
+
+	for (i = 0; i + entsize <= sh->size; i += entsize) {
+		const unsigned char *p = ef->data + sh->offset + i;
+		const unsigned char *sym;
+		const char *name;
+		uint64_t symidx;
+		unsigned int type;
+
+		if (ef->is64 && ef->machine == ELF_EM_MIPS) {
+			/* MIPS64 splits r_info into a symbol and 3 types. */
+			symidx = elf_get32(ef, p + 8);
+			type = p[15];
+		} else if (ef->is64) {
+			uint64_t rinfo = elf_get64(ef, p + 8);
+
+			symidx = rinfo >> 32;
+			type = rinfo & 0xffffffff;
+			if (ef->machine == ELF_EM_SPARCV9)
+				type &= 0xff;
+		} else {
+			uint32_t rinfo = elf_get32(ef, p + 4);
+
+			symidx = rinfo >> 8;
+			type = rinfo & 0xff;
+		}
+
+		if (type != copytype || symidx == 0)
+			continue;
+
+		sym = elf_ptr(ef, dynsym->offset + symidx * symsize, symsize);
+		if (sym == NULL || (symidx + 1) * symsize > dynsym->size)
+			return dpkg_put_error(err, _("invalid relocation "
+			                             "symbol index"));
+		name = elf_get_str(ef, &strtab, elf_get32(ef, sym));
+		if (name == NULL)
+			return dpkg_put_error(err, _("invalid symbol name "
+			                             "offset"));
+
+		fprintf(out, "reloc\t%s\t%s\n", copyname, name);
+	}
+
+	return 0;
+}
+
+static void
+elf_print_flag(FILE *out, const char **sep, const char *flag)
+{
+	fprintf(out, "%s%s", *sep, flag);
+	*sep = ", ";
+}
+
+static int
+elf_dump_object(struct elf_file *ef, FILE *out, struct dpkg_error *err)
+{
+	struct elf_shdr sh, dynsym = { 0 }, versym = { 0 };
+	struct elf_versions vers = { 0 };
+	unsigned int dynsym_idx = 0;
+	bool has_syms = false;
+	bool has_versym = false;
+	const char *sep;
+	unsigned int i;
+	int rc = 0;
+
+	if (elf_parse_header(ef, err) < 0)
+		return -1;
+	if (elf_parse_sections(ef, err) < 0)
+		return -1;
+
+	/* Gather the sections we need to refer to from other sections. */
+	for (i = 0; i < ef->shnum; i++) {
+		if (elf_get_shdr(ef, i, &sh) < 0)
+			break;
+
+		if (sh.type == ELF_SHT_SYMTAB) {
+			has_syms = true;
+		} else if (sh.type == ELF_SHT_DYNSYM && dynsym_idx == 0) {
+			has_syms = true;
+			dynsym_idx = i;
+			dynsym = sh;
+		} else if (sh.type == ELF_SHT_GNU_VERSYM) {
+			has_versym = true;
+			versym = sh;
+		} else if (sh.type == ELF_SHT_GNU_VERDEF) {
+			rc = elf_parse_verdef(ef, &sh, &vers, err);
+		} else if (sh.type == ELF_SHT_GNU_VERNEED) {
+			rc = elf_parse_verneed(ef, &sh, &vers, err);
+		}
+		if (rc < 0)
+			goto out;
+	}
+	if (vers.ndefs == 0 && vers.nneeds == 0)
+		has_versym = false;
+
+	fprintf(out, "format\telf%d-%s\n", ef->is64 ? 64 : 32,
+	        ef->msb ? "big" : "little");
+
+	/* These mimic the BFD flags as printed by «objdump -f». */
+	sep = "\t";
+	fprintf(out, "flags");
+	if (ef->type == ELF_ET_REL)
+		elf_print_flag(out, &sep, "HAS_RELOC");
+	else if (ef->type == ELF_ET_EXEC)
+		elf_print_flag(out, &sep, "EXEC_P");
+	if (has_syms)
+		elf_print_flag(out, &sep, "HAS_SYMS");
+	if (ef->type == ELF_ET_DYN)
+		elf_print_flag(out, &sep, "DYNAMIC");
+	if (ef->phnum)
+		elf_print_flag(out, &sep, "D_PAGED");
+	fprintf(out, "\n");
+
+	if (elf_has_interp(ef))
+		fprintf(out, "interp\n");
+
+	for (i = 0; i < ef->shnum; i++) {
+		if (elf_get_shdr(ef, i, &sh) < 0)
+			break;
+		if (sh.type != ELF_SHT_DYNAMIC)
+			continue;
+
+		rc = elf_dump_dynamic(ef, &sh, out, err);
+		if (rc < 0)
+			goto out;
+		break;
+	}
+
+	if (dynsym_idx == 0)
+		goto out;
+
+	rc = elf_dump_symbols(ef, &dynsym, has_versym ? &versym : NULL, &vers,
+	                      out, err);
+	if (rc < 0)
+		goto out;
+
+	for (i = 0; i < ef->shnum; i++) {
+		if (elf_get_shdr(ef, i, &sh) < 0)
+			break;
+		if (sh.type != ELF_SHT_REL && sh.type != ELF_SHT_RELA)
+			continue;
+		if (sh.link != dynsym_idx)
+			continue;
+
+		rc = elf_dump_relocs(ef, &sh, &dynsym, out, err);
+		if (rc < 0)
+			goto out;
+	}
+
+out:
+	elf_versions_destroy(&vers);
+
+	return rc;
+}
+
+static int
+elf_dump_file(const char *filename, FILE *out, struct dpkg_error *err)
+{
+	struct elf_file ef = { 0 };
+	struct stat st;
+	void *data;
+	int fd;
+	int rc;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return dpkg_put_errno(err, _("cannot open file"));
+	if (fstat(fd, &st) < 0) {
+		rc = dpkg_put_errno(err, _("cannot stat file"));
+		close(fd);
+		return rc;
+	}
+	if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return dpkg_put_error(err, _("not an ELF file"));
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		rc = dpkg_put_errno(err, _("cannot map file"));
+		close(fd);
+		return rc;
+	}
+	close(fd);
+
+	ef.data = data;
+	ef.size = st.st_size;
+
+	rc = elf_dump_object(&ef, out, err);
+
+	munmap(data, st.st_size);
+
+	return rc;
+}
+
+/*
+ * Dump a list of files, each as a block delimited by «file» and «end»
+ * records, or a single «error» record if the file cannot be parsed, in
+ * which case any partial output for the file must be discarded.
+ */
+static void
+elf_dump_files(const char *const *files, int nfiles, FILE *out)
+{
+	int i;
+
+	for (i = 0; i < nfiles; i++) {
+		struct dpkg_error err = DPKG_ERROR_INIT;
+
+		fprintf(out, "file\t%s\n", files[i]);
+		if (elf_dump_file(files[i], out, &err) < 0) {
+			fprintf(out, "error\t%s\n", err.str);
+			dpkg_error_destroy(&err);
+		}
+		fprintf(out, "end\n");
+	}
+}
+
+static const struct cmdinfo cmdinfos[] = {
+	{ "jobs",    0,   1, NULL, NULL, file_jobs_set_option, 0, &opt_jobs },
+	{ "help",    '?', 0, NULL, NULL, usage        },
+	{ "version", 0,   0, NULL, NULL, printversion },
+	{ NULL,      0,   0, NULL, NULL, NULL         }
+};
+
+int
+main(int argc, const char *const *argv)
+{
+	int nfiles;
+
+	dpkg_locales_init(PACKAGE);
+	dpkg_program_init("dpkg-elfdump");
+	dpkg_options_parse(&argv, cmdinfos, printforhelp);
+
+	if (!*argv)
+		badusage(_("need at least one file argument"));
+
+	for (nfiles = 0; argv[nfiles]; nfiles++)
+		;
+
+	file_jobs_run(argv, nfiles, opt_jobs, NULL, elf_dump_files,
+	              _("ELF dump job"));
+
+	dpkg_program_done();
+
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * dpkg - main program for package management
+ * file-jobs.c - parallel file list processing jobs
+ *
+ * Copyright © 2018 Guillem Jover <guillem@debian.org>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/i18n.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/error.h>
+#include <dpkg/buffer.h>
+#include <dpkg/subproc.h>
+#include <dpkg/options.h>
+
+#include "file-jobs.h"
+
+/**
+ * Parse the number of jobs option value into the int pointed to by the
+ * cmdinfo arg_ptr member.
+ */
+void
+file_jobs_set_option(const struct cmdinfo *cip, const char *value)
+{
+	long jobs;
+
+	jobs = dpkg_options_parse_arg_int(cip, value);
+	if (jobs < 1)
+		badusage(_("invalid number of jobs for --%s: %ld"),
+		         cip->olong, jobs);
+
+	*(int *)cip->arg_ptr = jobs;
+}
+
+struct file_job {
+	const char *const *files;
+	int nfiles;
+	FILE *out;
+	pid_t pid;
+};
+
+/*
+ * Get the index past the last file for a job, so that the chunk has a
+ * total size up to its share, or its share of the file count if there are
+ * no sizes, while leaving at least one file for each of the remaining jobs.
+ */
+static int
+file_jobs_split(int nfiles, int njobs, const off_t *sizes, off_t total,
+                int job, int start, off_t *done)
+{
+	off_t limit = total / njobs * (job + 1);
+	int end = start;
+
+	if (job == njobs - 1)
+		return nfiles;
+	if (sizes == NULL)
+		return start + nfiles / njobs + (job < nfiles % njobs);
+
+	while (end < nfiles - (njobs - job - 1) &&
+	       (end == start || *done + sizes[end] <= limit))
+		*done += sizes[end++];
+
+	return end;
+}
+
+/**
+ * Process a list of files using parallel jobs.
+ *
+ * The files are split into contiguous chunks, of roughly the same total
+ * size if sizes is not NULL or the same number of files otherwise, one
+ * per forked job, each written into its own temporary file, so that the
+ * output can be emitted to stdout in argument order once all jobs have
+ * finished. With a single job the files are processed directly.
+ *
+ * @param files The files to process.
+ * @param nfiles The number of files.
+ * @param njobs The number of jobs, or 0 for the number of online CPUs.
+ * @param sizes The size of each file, or NULL.
+ * @param func The function to process a chunk of files.
+ * @param desc The job description, for error reporting.
+ */
+void
+file_jobs_run(const char *const *files, int nfiles, int njobs,
+              const off_t *sizes, file_jobs_func *func, const char *desc)
+{
+	struct file_job *jobs;
+	off_t total = 0, done = 0;
+	int start = 0;
+	int i;
+
+	if (njobs <= 0) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		njobs = ncpus > 0 ? ncpus : 1;
+	}
+	if (njobs > nfiles)
+		njobs = nfiles;
+
+	if (njobs <= 1) {
+		func(files, nfiles, stdout);
+		m_output(stdout, _("<standard output>"));
+		return;
+	}
+
+	if (sizes)
+		for (i = 0; i < nfiles; i++)
+			total += sizes[i];
+
+	jobs = m_malloc(njobs * sizeof(*jobs));
+
+	for (i = 0; i < njobs; i++) {
+		struct file_job *job = &jobs[i];
+		int end;
+
+		end = file_jobs_split(nfiles, njobs, sizes, total, i, start,
+		                      &done);
+
+		job->files = files + start;
+		job->nfiles = end - start;
+		start = end;
+
+		job->out = tmpfile();
+		if (job->out == NULL)
+			ohshite(_("cannot create temporary file"));
+
+		job->pid = subproc_fork();
+		if (job->pid == 0) {
+			func(job->files, job->nfiles, job->out);
+			m_output(job->out, _("<temporary file>"));
+			exit(0);
+		}
+	}
+
+	for (i = 0; i < njobs; i++) {
+		struct file_job *job = &jobs[i];
+		struct dpkg_error err;
+
+		subproc_reap(job->pid, desc, 0);
+
+		if (lseek(fileno(job->out), 0, SEEK_SET) < 0)
+			ohshite(_("cannot rewind temporary file"));
+		if (fd_fd_copy(fileno(job->out), STDOUT_FILENO, -1, &err) < 0)
+			ohshit(_("cannot copy job output: %s"), err.str);
+		fclose(job->out);
+	}
+
+	free(jobs);
+}
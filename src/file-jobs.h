@@ -0,0 +1,39 @@
+/*
+ * dpkg - main program for package management
+ * file-jobs.h - parallel file list processing jobs
+ *
+ * Copyright © 2018 Guillem Jover <guillem@debian.org>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DPKG_FILE_JOBS_H
+#define DPKG_FILE_JOBS_H
+
+#include <sys/types.h>
+
+#include <stdio.h>
+
+#include <dpkg/options.h>
+
+typedef void file_jobs_func(const char *const *files, int nfiles, FILE *out);
+
+void
+file_jobs_set_option(const struct cmdinfo *cip, const char *value);
+
+void
+file_jobs_run(const char *const *files, int nfiles, int njobs,
+              const off_t *sizes, file_jobs_func *func, const char *desc);
+
+#endif /* DPKG_FILE_JOBS_H */
@@ -0,0 +1,302 @@
+/*
+ * dpkg - main program for package management
+ * file-writer.c - parallel regular file writers
+ *
+ * Copyright © 2018 Guillem Jover <guillem@debian.org>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdlib.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include <dpkg/i18n.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/fdio.h>
+
+#include "file-writer.h"
+
+/*
+ * The writer threads only perform system calls on the jobs handed to them,
+ * and never call into the rest of dpkg, so that all the error handling and
+ * bookkeeping stays on the main thread, which is the one collecting the
+ * completed jobs.
+ */
+
+static int writer_nthreads;
+static int writer_npending;
+
+struct file_writer_list {
+	struct file_writer_job *head;
+	struct file_writer_job **tail;
+};
+
+static struct file_writer_list writer_queue = { NULL, &writer_queue.head };
+static struct file_writer_list writer_completed = {
+	NULL, &writer_completed.head
+};
+
+static void
+file_writer_list_push(struct file_writer_list *list,
+                      struct file_writer_job *job)
+{
+	job->next = NULL;
+	*list->tail = job;
+	list->tail = &job->next;
+}
+
+static struct file_writer_job *
+file_writer_list_pop(struct file_writer_list *list)
+{
+	struct file_writer_job *job = list->head;
+
+	if (job == NULL)
+		return NULL;
+
+	list->head = job->next;
+	if (list->head == NULL)
+		list->tail = &list->head;
+
+	return job;
+}
+
+static void
+file_writer_run(struct file_writer_job *job)
+{
+	job->error = FILE_WRITER_OK;
+	job->errnum = 0;
+	job->chown_errnum = 0;
+	job->chmod_errnum = 0;
+
+	/* We create the file with mode 0 to make sure nobody can do anything
+	 * with it until we apply the proper mode. */
+	job->fd = open(job->path, O_CREAT | O_EXCL | O_WRONLY, 0);
+	if (job->fd < 0) {
+		job->error = FILE_WRITER_ERR_OPEN;
+		job->errnum = errno;
+		return;
+	}
+
+	if (job->allocate)
+		fd_allocate_size(job->fd, 0, job->size);
+
+	errno = ENOSPC;
+	if (fd_write(job->fd, job->data, job->size) != job->size) {
+		job->error = FILE_WRITER_ERR_WRITE;
+		job->errnum = errno;
+		return;
+	}
+
+	/* Whether these errors are fatal is decided by the submitter. */
+	if (fchown(job->fd, job->uid, job->gid) < 0)
+		job->chown_errnum = errno;
+	if (fchmod(job->fd, job->mode) < 0)
+		job->chmod_errnum = errno;
+
+#ifdef HAVE_FUTIMES
+	if (futimes(job->fd, job->times) < 0) {
+#else
+	if (utimes(job->path, job->times) < 0) {
+#endif
+		job->error = FILE_WRITER_ERR_TIMES;
+		job->errnum = errno;
+	}
+}
+
+#ifdef HAVE_PTHREAD
+static pthread_t *writer_threads;
+static bool writer_running;
+static bool writer_quit;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t writer_finished = PTHREAD_COND_INITIALIZER;
+
+static void *
+file_writer_thread(void *arg)
+{
+	struct file_writer_job *job;
+
+	pthread_mutex_lock(&writer_lock);
+	for (;;) {
+		while (writer_queue.head == NULL && !writer_quit)
+			pthread_cond_wait(&writer_queued, &writer_lock);
+
+		job = file_writer_list_pop(&writer_queue);
+		if (job == NULL)
+			break;
+
+		pthread_mutex_unlock(&writer_lock);
+		file_writer_run(job);
+		pthread_mutex_lock(&writer_lock);
+
+		file_writer_list_push(&writer_completed, job);
+		pthread_cond_signal(&writer_finished);
+	}
+	pthread_mutex_unlock(&writer_lock);
+
+	return NULL;
+}
+
+static void
+file_writer_start(void)
+{
+	sigset_t sigset, oldset;
+	int i, rc;
+
+	/* The signals are to be handled by the main thread only. */
+	sigfillset(&sigset);
+	pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+
+	writer_threads = m_malloc(writer_nthreads * sizeof(*writer_threads));
+	for (i = 0; i < writer_nthreads; i++) {
+		rc = pthread_create(&writer_threads[i], NULL, file_writer_thread,
+		                    NULL);
+		if (rc) {
+			/* Let file_writer_done() join the threads already
+			 * started, on the cleanup path. */
+			writer_nthreads = i;
+			writer_running = true;
+			pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+			errno = rc;
+			ohshite(_("cannot create file writer thread"));
+		}
+	}
+
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+
+	writer_running = true;
+}
+#endif
+
+/**
+ * Set up the number of parallel file writers.
+ *
+ * @return The number of writer threads that will be used, 0 if jobs
+ *         get run synchronously on submission.
+ */
+int
+file_writer_init(int jobs)
+{
+#ifdef HAVE_PTHREAD
+	writer_nthreads = jobs > 1 ? jobs : 0;
+#else
+	writer_nthreads = 0;
+#endif
+
+	return writer_nthreads;
+}
+
+void
+file_writer_submit(struct file_writer_job *job)
+{
+#ifdef HAVE_PTHREAD
+	if (writer_nthreads && !writer_running)
+		file_writer_start();
+#endif
+
+	writer_npending++;
+
+#ifdef HAVE_PTHREAD
+	if (writer_nthreads) {
+		pthread_mutex_lock(&writer_lock);
+		file_writer_list_push(&writer_queue, job);
+		pthread_cond_signal(&writer_queued);
+		pthread_mutex_unlock(&writer_lock);
+		return;
+	}
+#endif
+
+	file_writer_run(job);
+	file_writer_list_push(&writer_completed, job);
+}
+
+/**
+ * Get a completed job.
+ *
+ * @param wait Whether to wait for a job to complete if there is none yet.
+ *
+ * @return The completed job, or NULL if there are no jobs pending, or
+ *         none has completed and we were not asked to wait.
+ */
+struct file_writer_job *
+file_writer_collect(bool wait)
+{
+	struct file_writer_job *job;
+
+	if (writer_npending == 0)
+		return NULL;
+
+#ifdef HAVE_PTHREAD
+	if (writer_nthreads) {
+		pthread_mutex_lock(&writer_lock);
+		while (writer_completed.head == NULL && wait)
+			pthread_cond_wait(&writer_finished, &writer_lock);
+		job = file_writer_list_pop(&writer_completed);
+		pthread_mutex_unlock(&writer_lock);
+	} else
+#endif
+	{
+		job = file_writer_list_pop(&writer_completed);
+	}
+
+	if (job)
+		writer_npending--;
+
+	return job;
+}
+
+/**
+ * Stop the writer threads, once all the pending jobs have been collected.
+ *
+ * This makes sure no threads are left around when we fork other processes.
+ */
+void
+file_writer_done(void)
+{
+#ifdef HAVE_PTHREAD
+	int i;
+
+	if (!writer_running)
+		return;
+	if (writer_npending)
+		internerr("file writer done with %d jobs pending", writer_npending);
+
+	pthread_mutex_lock(&writer_lock);
+	writer_quit = true;
+	pthread_cond_broadcast(&writer_queued);
+	pthread_mutex_unlock(&writer_lock);
+
+	for (i = 0; i < writer_nthreads; i++)
+		pthread_join(writer_threads[i], NULL);
+	free(writer_threads);
+	writer_threads = NULL;
+
+	writer_quit = false;
+	writer_running = false;
+#endif
+}
@@ -0,0 +1,68 @@
+/*
+ * dpkg - main program for package management
+ * file-writer.h - parallel regular file writers
+ *
+ * Copyright © 2018 Guillem Jover <guillem@debian.org>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DPKG_FILE_WRITER_H
+#define DPKG_FILE_WRITER_H
+
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include <stdbool.h>
+
+enum file_writer_error {
+	FILE_WRITER_OK,
+	FILE_WRITER_ERR_OPEN,
+	FILE_WRITER_ERR_WRITE,
+	FILE_WRITER_ERR_TIMES,
+};
+
+/*
+ * A regular file to create with the given contents and metadata. The
+ * writer only performs system calls on it, so all the fields are owned
+ * by the submitter, which gets the job back once it has been completed.
+ */
+struct file_writer_job {
+	struct file_writer_job *next;
+
+	/* Input. */
+	const char *path;
+	void *data;
+	off_t size;
+	uid_t uid;
+	gid_t gid;
+	mode_t mode;
+	struct timeval times[2];
+	bool allocate;
+	void *arg;
+
+	/* Output. */
+	int fd;
+	enum file_writer_error error;
+	int errnum;
+	int chown_errnum;
+	int chmod_errnum;
+};
+
+int file_writer_init(int jobs);
+void file_writer_submit(struct file_writer_job *job);
+struct file_writer_job *file_writer_collect(bool wait);
+void file_writer_done(void);
+
+#endif /* DPKG_FILE_WRITER_H */
@@ -50,6 +50,7 @@
 #include <dpkg/command.h>
 #include <dpkg/pager.h>
 #include <dpkg/options.h>
+#include <dpkg/db-ctrl.h>
 #include <dpkg/db-fsys.h>
 
 #include "main.h"
@@ -309,8 +310,10 @@ usage(const struct cmdinfo *ci, const char *value)
 "  -E|--skip-same-version     Skip packages whose same version is installed.\n"
 "  -G|--refuse-downgrade      Skip packages with earlier version than installed.\n"
 "  -B|--auto-deconfigure      Install even if it would break some other package.\n"
+"  --bootstrap                Unpack into an empty database, syncing only at the end.\n"
 "  --[no-]triggers            Skip or force consequential trigger processing.\n"
 "  --verify-format=<format>   Verify output format (supported: 'rpm').\n"
+"  --infodb-format=<format>   Upgrade the info database to <format>.\n"
 "  --no-debsig                Do not try to verify package signatures.\n"
 "  --no-act|--dry-run|--simulate\n"
 "                             Just say what we would do - don't do it.\n"
@@ -324,6 +327,9 @@ usage(const struct cmdinfo *ci, const char *value)
 "  --no-force-...|--refuse-...\n"
 "                             Stop when problems encountered.\n"
 "  --abort-after <n>          Abort after encountering <n> errors.\n"
+"  --small-file-size=<n>      Write files up to <n> bytes in one go.\n"
+"  --small-file-syncfs        Sync small files with one syncfs() per file system.\n"
+"  --unpack-jobs=<n>          Write files using up to <n> parallel jobs.\n"
 "\n"), ADMINDIR);
 
   printf(_(
@@ -352,6 +358,7 @@ static const char printforhelp[] = N_(
 
 int f_pending=0, f_recursive=0, f_alsoselect=1, f_skipsame=0, f_noact=0;
 int f_autodeconf=0, f_nodebsig=0;
+int f_bootstrap = 0;
 int f_triggers = 0;
 int fc_downgrade=1, fc_configureany=0, fc_hold=0, fc_removereinstreq=0, fc_overwrite=0;
 int fc_removeessential=0, fc_conflicts=0, fc_depends=0, fc_dependsversion=0;
@@ -365,6 +372,9 @@ int fc_badversion = 0;
 int fc_script_chrootless = 0;
 
 int errabort = 50;
+int small_file_size = 8192;
+int small_file_syncfs = 0;
+int unpack_jobs = 1;
 static const char *admindir = ADMINDIR;
 const char *instdir= "";
 struct pkg_list *ignoredependss = NULL;
@@ -524,6 +534,17 @@ set_verify_format(const struct cmdinfo *cip, const char *value)
     badusage(_("unknown verify output format '%s'"), value);
 }
 
+static void
+set_infodb_format(const struct cmdinfo *cip, const char *value)
+{
+  if (strcmp(value, "multiarch") == 0)
+    pkg_infodb_set_upgrade_format(PKG_INFODB_FORMAT_MULTIARCH);
+  else if (strcmp(value, "hierarchical") == 0)
+    pkg_infodb_set_upgrade_format(PKG_INFODB_FORMAT_HIERARCHICAL);
+  else
+    badusage(_("unknown info database format '%s'"), value);
+}
+
 static void
 set_instdir(const struct cmdinfo *cip, const char *value)
 {
@@ -889,6 +910,7 @@ static const struct cmdinfo cmdinfos[]= {
   { "path-exclude",      0,   1, NULL,          NULL,      set_filter,     0 },
   { "path-include",      0,   1, NULL,          NULL,      set_filter,     1 },
   { "verify-format",     0,   1, NULL,          NULL,      set_verify_format },
+  { "infodb-format",     0,   1, NULL,          NULL,      set_infodb_format },
   { "status-logger",     0,   1, NULL,          NULL,      set_invoke_hook, 0, &status_loggers },
   { "status-fd",         0,   1, NULL,          NULL,      set_pipe, 0 },
   { "log",               0,   1, NULL,          &log_file, NULL,    0 },
@@ -908,8 +930,12 @@ static const struct cmdinfo cmdinfos[]= {
   { "no-also-select",    'N', 0, &f_alsoselect, NULL,      NULL,    0 },
   { "skip-same-version", 'E', 0, &f_skipsame,   NULL,      NULL,    1 },
   { "auto-deconfigure",  'B', 0, &f_autodeconf, NULL,      NULL,    1 },
+  { "bootstrap",         0,   0, &f_bootstrap,  NULL,      NULL,    1 },
   { "root",              0,   1, NULL,          NULL,      set_root,      0 },
   { "abort-after",       0,   1, &errabort,     NULL,      set_integer,   0 },
+  { "small-file-size",   0,   1, &small_file_size, NULL,   set_integer,   0 },
+  { "small-file-syncfs", 0,   0, &small_file_syncfs, NULL,  NULL,          1 },
+  { "unpack-jobs",       0,   1, &unpack_jobs, NULL,       set_integer,   0 },
   { "admindir",          0,   1, NULL,          &admindir, NULL,          0 },
   { "instdir",           0,   1, NULL,          NULL,      set_instdir,   0 },
   { "ignore-depends",    0,   1, NULL,          NULL,      set_ignore_depends, 0 },
@@ -1074,6 +1100,11 @@ int main(int argc, const char *const *argv) {
 
   if (!cipaction) badusage(_("need an action option"));
 
+  if (f_bootstrap &&
+      cipaction->arg_int != act_install && cipaction->arg_int != act_unpack)
+    badusage(_("--%s is only supported with --install and --unpack"),
+             "bootstrap");
+
   admindir = dpkg_db_set_dir(admindir);
 
   /* Always set environment, to avoid possible security risks. */
@@ -56,6 +56,9 @@ struct perpackagestate {
 
   bool enqueued;
 
+  /** The Replaces relationship with the package being unpacked: 0 if not
+   * yet evaluated, 1 if it replaces this package's files, 2 if it gets
+   * replaced by this package's files, or 3 if there is none. */
   int replacingfilesandsaid;
   int cmdline_seen;
 
@@ -122,6 +125,7 @@ extern const char *const statusstrings[];
 
 extern int f_pending, f_recursive, f_alsoselect, f_skipsame, f_noact;
 extern int f_autodeconf, f_nodebsig;
+extern int f_bootstrap;
 extern int f_triggers;
 extern int fc_downgrade, fc_configureany, fc_hold, fc_removereinstreq, fc_overwrite;
 extern int fc_removeessential, fc_conflicts, fc_depends, fc_dependsversion;
@@ -136,6 +140,9 @@ extern int fc_script_chrootless;
 
 extern bool abort_processing;
 extern int errabort;
+extern int small_file_size;
+extern int small_file_syncfs;
+extern int unpack_jobs;
 extern const char *instdir;
 extern struct pkg_list *ignoredependss;
 
@@ -157,6 +164,7 @@ void ensure_package_clientdata(struct pkginfo *pkg);
 int archivefiles(const char *const *argv);
 void process_archive(const char *filename);
 bool wanttoinstall(struct pkginfo *pkg);
+void ondisk_stat_flush(void);
 
 /* from update.c */
 
@@ -277,6 +285,8 @@ void log_action(const char *action, struct pkginfo *pkg, struct pkgbin *pkgbin);
 
 void dpkg_selabel_load(void);
 void dpkg_selabel_set_context(const char *matchpath, const char *path, mode_t mode);
+void dpkg_selabel_set_context_fd(const char *matchpath, int fd,
+                                 const char *path, mode_t mode);
 void dpkg_selabel_close(void);
 
 /* from trigproc.c */
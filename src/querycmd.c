@@ -33,6 +33,7 @@
 #endif
 #include <errno.h>
 #include <limits.h>
+#include <stdint.h>
 #include <string.h>
 #include <fcntl.h>
 #include <dirent.h>
@@ -62,50 +63,207 @@ static const char *showformat = "${binary:Package}\t${Version}\n";
 
 static int opt_loadavail = 0;
 
+/*
+ * Package specifiers get precompiled so that matching does not need to try
+ * every specifier against every package: exact names are resolved upfront
+ * into their package sets, which get looked up by pointer, and glob patterns
+ * are bucketed by the first character of their literal prefix, so that only
+ * the ones which could possibly match a given name get passed to fnmatch().
+ */
+
+struct pkg_spec_exact {
+  struct pkgset *set;
+  int ip;
+};
+
+struct pkg_spec_matcher {
+  struct pkg_spec *ps;
+  int n_ps;
+
+  struct pkg_spec_exact *exact;
+  int n_exact;
+
+  /* Glob buckets, indexed by the first literal character, as linked lists
+   * of specifier indices chained through glob_next. The last bucket holds
+   * the globs without a literal prefix, which need to be tried always. */
+  int glob_head[UCHAR_MAX + 2];
+  int *glob_next;
+  size_t *glob_prefix_len;
+};
+
+#define PKG_SPEC_GLOB_NOPREFIX (UCHAR_MAX + 1)
+
+static int
+pkg_spec_exact_cmp(const void *a, const void *b)
+{
+  const struct pkg_spec_exact *ea = a;
+  const struct pkg_spec_exact *eb = b;
+  uintptr_t sa = (uintptr_t)ea->set;
+  uintptr_t sb = (uintptr_t)eb->set;
+
+  if (sa < sb)
+    return -1;
+  if (sa > sb)
+    return 1;
+  return ea->ip - eb->ip;
+}
+
+static void
+pkg_spec_matcher_init(struct pkg_spec_matcher *m, const char *const *argv)
+{
+  int ip, bucket;
+
+  for (m->n_ps = 0; argv[m->n_ps]; m->n_ps++);
+
+  m->ps = m_malloc(sizeof(*m->ps) * m->n_ps);
+  m->exact = m_malloc(sizeof(*m->exact) * m->n_ps);
+  m->n_exact = 0;
+  m->glob_next = m_malloc(sizeof(*m->glob_next) * m->n_ps);
+  m->glob_prefix_len = m_malloc(sizeof(*m->glob_prefix_len) * m->n_ps);
+  for (bucket = 0; bucket <= PKG_SPEC_GLOB_NOPREFIX; bucket++)
+    m->glob_head[bucket] = -1;
+
+  /* Add them in reverse so that each bucket ends up in argument order. */
+  for (ip = m->n_ps - 1; ip >= 0; ip--) {
+    struct pkg_spec *ps = &m->ps[ip];
+    size_t prefix_len;
+
+    pkg_spec_init(ps, PKG_SPEC_PATTERNS | PKG_SPEC_ARCH_WILDCARD);
+    pkg_spec_parse(ps, argv[ip]);
+
+    prefix_len = strcspn(ps->name, "*[?\\");
+    if (ps->name[prefix_len] == '\0') {
+      struct pkgset *set;
+
+      /* Package set names are always stored folded to lower case, and
+       * the exact match is case-sensitive, so anything else is not in
+       * the database. */
+      set = pkg_db_find_set(ps->name);
+      if (strcmp(set->name, ps->name) != 0)
+        continue;
+
+      m->exact[m->n_exact].set = set;
+      m->exact[m->n_exact].ip = ip;
+      m->n_exact++;
+    } else {
+      if (prefix_len == 0)
+        bucket = PKG_SPEC_GLOB_NOPREFIX;
+      else
+        bucket = (unsigned char)ps->name[0];
+
+      m->glob_prefix_len[ip] = prefix_len;
+      m->glob_next[ip] = m->glob_head[bucket];
+      m->glob_head[bucket] = ip;
+    }
+  }
+
+  qsort(m->exact, m->n_exact, sizeof(*m->exact), pkg_spec_exact_cmp);
+}
+
+static void
+pkg_spec_matcher_destroy(struct pkg_spec_matcher *m)
+{
+  int ip;
+
+  for (ip = 0; ip < m->n_ps; ip++)
+    pkg_spec_destroy(&m->ps[ip]);
+
+  free(m->ps);
+  free(m->exact);
+  free(m->glob_next);
+  free(m->glob_prefix_len);
+}
+
+static bool
+pkg_spec_matcher_match_globs(struct pkg_spec_matcher *m, int ip,
+                             struct pkginfo *pkg, int *found)
+{
+  const char *name = pkg->set->name;
+  bool pkg_found = false;
+
+  for (; ip >= 0; ip = m->glob_next[ip]) {
+    struct pkg_spec *ps = &m->ps[ip];
+
+    if (strncmp(ps->name, name, m->glob_prefix_len[ip]) != 0)
+      continue;
+    if (pkg_spec_match_pkg(ps, pkg, &pkg->installed)) {
+      pkg_found = true;
+      found[ip]++;
+    }
+  }
+
+  return pkg_found;
+}
+
+static bool
+pkg_spec_matcher_match(struct pkg_spec_matcher *m, struct pkginfo *pkg,
+                       int *found)
+{
+  uintptr_t set = (uintptr_t)pkg->set;
+  bool pkg_found = false;
+  int lo, hi, bucket;
+
+  /* Find the first exact specifier for this package set, if any. */
+  lo = 0;
+  hi = m->n_exact;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+
+    if ((uintptr_t)m->exact[mid].set < set)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  for (; lo < m->n_exact && m->exact[lo].set == pkg->set; lo++) {
+    int ip = m->exact[lo].ip;
+
+    /* The name is known to match, but the architecture might not. */
+    if (pkg_spec_match_pkg(&m->ps[ip], pkg, &pkg->installed)) {
+      pkg_found = true;
+      found[ip]++;
+    }
+  }
+
+  bucket = (unsigned char)pkg->set->name[0];
+  if (pkg_spec_matcher_match_globs(m, m->glob_head[bucket], pkg, found))
+    pkg_found = true;
+  if (pkg_spec_matcher_match_globs(m, m->glob_head[PKG_SPEC_GLOB_NOPREFIX],
+                                   pkg, found))
+    pkg_found = true;
+
+  return pkg_found;
+}
+
 static int
 pkg_array_match_patterns(struct pkg_array *array,
                          pkg_array_visitor_func *pkg_visitor, void *pkg_data,
                          const char *const *argv)
 {
-  int argc, i, ip, *found;
+  struct pkg_spec_matcher matcher;
+  int i, ip, *found;
   int rc = 0;
-  struct pkg_spec *ps;
 
-  for (argc = 0; argv[argc]; argc++);
-  found = m_calloc(argc, sizeof(int));
-
-  ps = m_malloc(sizeof(*ps) * argc);
-  for (ip = 0; ip < argc; ip++) {
-    pkg_spec_init(&ps[ip], PKG_SPEC_PATTERNS | PKG_SPEC_ARCH_WILDCARD);
-    pkg_spec_parse(&ps[ip], argv[ip]);
-  }
+  pkg_spec_matcher_init(&matcher, argv);
+  found = m_calloc(matcher.n_ps, sizeof(int));
 
   for (i = 0; i < array->n_pkgs; i++) {
     struct pkginfo *pkg;
-    bool pkg_found = false;
 
     pkg = array->pkgs[i];
-    for (ip = 0; ip < argc; ip++) {
-      if (pkg_spec_match_pkg(&ps[ip], pkg, &pkg->installed)) {
-        pkg_found = true;
-        found[ip]++;
-      }
-    }
-    if (!pkg_found)
+    if (!pkg_spec_matcher_match(&matcher, pkg, found))
       array->pkgs[i] = NULL;
   }
 
   pkg_array_foreach(array, pkg_visitor, pkg_data);
 
-  for (ip = 0; ip < argc; ip++) {
+  for (ip = 0; ip < matcher.n_ps; ip++) {
     if (!found[ip]) {
       notice(_("no packages found matching %s"), argv[ip]);
       rc++;
     }
-    pkg_spec_destroy(&ps[ip]);
   }
 
-  free(ps);
+  pkg_spec_matcher_destroy(&matcher);
   free(found);
 
   return rc;
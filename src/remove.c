@@ -221,6 +221,7 @@ removal_bulk_remove_file(const char *filename, const char *filetype)
 
   if (unlink(filename))
     ohshite(_("unable to delete control info file '%.250s'"), filename);
+  pkg_infodb_index_remove_file(filename);
 
   debug(dbg_scripts, "removal_bulk info unlinked %s", filename);
 }
@@ -368,7 +369,7 @@ removal_bulk_remove_files(struct pkginfo *pkg)
 
     debug(dbg_general, "removal_bulk cleaning info directory");
     pkg_infodb_foreach(pkg, &pkg->installed, removal_bulk_remove_file);
-    dir_sync_path(pkg_infodb_get_dir());
+    pkg_infodb_sync_pkgdir(pkg, &pkg->installed);
 
     pkg_set_status(pkg, PKG_STAT_CONFIGFILES);
     pkg->installed.essential = false;
@@ -658,12 +659,16 @@ void removal_bulk(struct pkginfo *pkg) {
           filename);
     if (unlink(filename) && errno != ENOENT)
       ohshite(_("cannot remove old files list"));
+    pkg_infodb_index_remove_file(filename);
 
     filename = pkg_infodb_get_file(pkg, &pkg->installed, POSTRMFILE);
     debug(dbg_general, "removal_bulk purge done, removing postrm '%s'",
           filename);
     if (unlink(filename) && errno != ENOENT)
       ohshite(_("can't remove old postrm script"));
+    pkg_infodb_index_remove_file(filename);
+
+    pkg_infodb_remove_pkgdir(pkg, &pkg->installed);
 
     pkg_set_status(pkg, PKG_STAT_NOTINSTALLED);
     pkg_set_want(pkg, PKG_WANT_UNKNOWN);
@@ -209,6 +209,9 @@ maintscript_exec(struct pkginfo *pkg, struct pkgbin *pkgbin,
 	rc = subproc_reap(pid, cmd->name, warn);
 	subproc_signals_restore();
 
+	/* The script might have modified anything on the filesystem. */
+	ondisk_stat_flush();
+
 	pop_cleanup(ehflag_normaltidy);
 
 	return rc;
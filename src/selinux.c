@@ -25,11 +25,14 @@
 #include <sys/stat.h>
 
 #include <errno.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/debug.h>
+#include <dpkg/clock.h>
 
 #ifdef WITH_LIBSELINUX
 #include <selinux/selinux.h>
@@ -41,6 +44,48 @@
 
 #ifdef WITH_LIBSELINUX
 static struct selabel_handle *sehandle;
+
+static struct {
+	unsigned long lookups;
+	double time;
+} selabel_stats;
+
+/*
+ * Returns the context for the match pathname, to be released with
+ * freecon(), or NULL if there is none; in which case the default context
+ * shall be applied.
+ */
+static security_context_t
+selabel_lookup_context(const char *matchpath, mode_t mode)
+{
+	security_context_t scontext = NULL;
+	struct timespec start, end;
+	int ret;
+
+	if (debug_has_flag(dbg_general))
+		dpkg_clock_get_monotonic(&start);
+
+	/*
+	 * We use the _raw function variants here so that no translation
+	 * happens from computer to human readable forms, to avoid issues
+	 * when mcstransd has disappeared during the unpack process.
+	 */
+
+	/* Do nothing if we can't figure out what the context is, or if it has
+	 * no context; in which case the default context shall be applied. */
+	ret = selabel_lookup_raw(sehandle, &scontext, matchpath, mode & S_IFMT);
+
+	if (debug_has_flag(dbg_general)) {
+		dpkg_clock_get_monotonic(&end);
+		selabel_stats.time += dpkg_clock_elapsed(&start, &end);
+	}
+	selabel_stats.lookups++;
+
+	if (ret == -1 || (ret == 0 && scontext == NULL))
+		return NULL;
+
+	return scontext;
+}
 #endif
 
 void
@@ -85,31 +130,54 @@ void
 dpkg_selabel_set_context(const char *matchpath, const char *path, mode_t mode)
 {
 #ifdef WITH_LIBSELINUX
-	security_context_t scontext = NULL;
+	security_context_t context;
 	int ret;
 
 	/* If SELinux is not enabled just do nothing. */
 	if (sehandle == NULL)
 		return;
 
-	/*
-	 * We use the _raw function variants here so that no translation
-	 * happens from computer to human readable forms, to avoid issues
-	 * when mcstransd has disappeared during the unpack process.
-	 */
+	context = selabel_lookup_context(matchpath, mode);
+	if (context == NULL)
+		return;
 
-	/* Do nothing if we can't figure out what the context is, or if it has
-	 * no context; in which case the default context shall be applied. */
-	ret = selabel_lookup_raw(sehandle, &scontext, matchpath, mode & S_IFMT);
-	if (ret == -1 || (ret == 0 && scontext == NULL))
+	ret = lsetfilecon_raw(path, context);
+	if (ret < 0 && errno != ENOTSUP)
+		ohshite(_("cannot set security context for file object '%s'"),
+		        path);
+
+	freecon(context);
+#endif /* WITH_LIBSELINUX */
+}
+
+/**
+ * Set the security context on an already open file.
+ *
+ * This avoids walking the pathname again, and the path is only used for
+ * error reporting.
+ */
+void
+dpkg_selabel_set_context_fd(const char *matchpath, int fd, const char *path,
+                            mode_t mode)
+{
+#ifdef WITH_LIBSELINUX
+	security_context_t context;
+	int ret;
+
+	/* If SELinux is not enabled just do nothing. */
+	if (sehandle == NULL)
 		return;
 
-	ret = lsetfilecon_raw(path, scontext);
+	context = selabel_lookup_context(matchpath, mode);
+	if (context == NULL)
+		return;
+
+	ret = fsetfilecon_raw(fd, context);
 	if (ret < 0 && errno != ENOTSUP)
 		ohshite(_("cannot set security context for file object '%s'"),
 		        path);
 
-	freecon(scontext);
+	freecon(context);
 #endif /* WITH_LIBSELINUX */
 }
 
@@ -120,6 +188,9 @@ dpkg_selabel_close(void)
 	if (sehandle == NULL)
 		return;
 
+	debug(dbg_general, "selabel %lu lookups in %.6fs",
+	      selabel_stats.lookups, selabel_stats.time);
+
 	selinux_status_close();
 	selabel_close(sehandle);
 	sehandle = NULL;
@@ -0,0 +1,298 @@
+#!/usr/bin/perl
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+use strict;
+use warnings;
+
+use Test::More;
+
+use File::Path qw(make_path remove_tree);
+
+use Dpkg::Path qw(find_command);
+use Dpkg::Shlibs::Objdump;
+
+my $builddir = $ENV{builddir} || '.';
+my $tmpdir = 't.tmp/dpkg_elfdump';
+
+my $elfdump = "$builddir/../src/dpkg-elfdump";
+
+if (! -x $elfdump) {
+    plan skip_all => 'dpkg-elfdump not available';
+    exit(0);
+}
+if (not find_command('objdump')) {
+    plan skip_all => 'objdump not available';
+    exit(0);
+}
+
+plan tests => 27;
+
+$Dpkg::Shlibs::Objdump::ELFDUMP = $elfdump;
+
+remove_tree($tmpdir);
+make_path($tmpdir);
+
+#
+# Generate a minimal shared object, with a dynamic section, dynamic symbols
+# and version information, for any ELF class and byte order. The machine
+# is left unset, so that objdump handles it with its generic ELF targets.
+#
+
+sub elf_strtab {
+    my @strs = @_;
+    my $data = "\0";
+    my %offset;
+
+    foreach my $str (@strs) {
+        $offset{$str} = length $data;
+        $data .= "$str\0";
+    }
+
+    return ($data, \%offset);
+}
+
+sub elf_gen_object {
+    my ($bits, $msb) = @_;
+    my $is64 = $bits == 64;
+    my $e = $msb ? '>' : '<';
+    my $half = "S$e";
+    my $word = "L$e";
+    my $addr = $is64 ? "Q$e" : "L$e";
+
+    my ($dynstr, $str) = elf_strtab(qw(
+        libc.so.6 libfoo.so.1 /opt/lib /opt/run:/opt/run2
+        foo_func foo_data undef_func weak_sym old_func
+        LIBFOO_1.0 GLIBC_2.2.5
+    ));
+    my ($shstrtab, $shstr) = elf_strtab(qw(
+        .dynsym .dynstr .gnu.version .gnu.version_d .gnu.version_r
+        .text .data .dynamic .shstrtab
+    ));
+
+    my %shndx = (
+        text => 6,
+        data => 7,
+    );
+
+    # Symbols, as name, bind, type, other, section, version index.
+    my @syms = (
+        [ 'foo_func',    1, 2, 0, $shndx{text}, 2 ],
+        [ 'foo_data',    1, 1, 3, $shndx{data}, 2 ],
+        [ 'undef_func',  1, 2, 0, 0, 3 ],
+        [ 'weak_sym',    2, 0, 0, 0, 0 ],
+        [ 'old_func',    1, 2, 0, $shndx{text}, 0x8002 ],
+        [ 'LIBFOO_1.0',  1, 1, 0, 0xfff1, 2 ],
+    );
+
+    my $dynsym = "\0" x ($is64 ? 24 : 16);
+    my $versym = pack $half, 0;
+    foreach my $sym (@syms) {
+        my ($name, $bind, $type, $other, $sect, $ver) = @{$sym};
+        my $info = $bind << 4 | $type;
+        my $value = $sect ? 0x1000 : 0;
+
+        if ($is64) {
+            $dynsym .= pack "${word}CC${half}${addr}${addr}",
+                $str->{$name}, $info, $other, $sect, $value, 0;
+        } else {
+            $dynsym .= pack "${word}${word}${word}CC${half}",
+                $str->{$name}, $value, 0, $info, $other, $sect;
+        }
+        $versym .= pack $half, $ver;
+    }
+
+    my $verdef =
+        pack("${half}${half}${half}${half}${word}${word}${word}",
+             1, 1, 1, 1, 0, 20, 28) .
+        pack("${word}${word}", $str->{'libfoo.so.1'}, 0) .
+        pack("${half}${half}${half}${half}${word}${word}${word}",
+             1, 0, 2, 1, 0, 20, 0) .
+        pack("${word}${word}", $str->{'LIBFOO_1.0'}, 0);
+
+    my $verneed =
+        pack("${half}${half}${word}${word}${word}",
+             1, 1, $str->{'libc.so.6'}, 16, 0) .
+        pack("${word}${half}${half}${word}${word}",
+             0, 0, 3, $str->{'GLIBC_2.2.5'}, 0);
+
+    my $dynamic = '';
+    foreach my $dyn ([ 1, $str->{'libc.so.6'} ],
+                     [ 14, $str->{'libfoo.so.1'} ],
+                     [ 15, $str->{'/opt/lib'} ],
+                     [ 29, $str->{'/opt/run:/opt/run2'} ],
+                     [ 4, 0x260 ],
+                     [ 0x6ffffef5, 0x2a0 ],
+                     [ 0, 0 ]) {
+        $dynamic .= pack "${addr}${addr}", @{$dyn};
+    }
+
+    # Sections, as name, type, flags, data, link, info, entry size.
+    my @sects = (
+        [ '.dynsym', 11, 2, $dynsym, 2, 1, $is64 ? 24 : 16 ],
+        [ '.dynstr', 3, 2, $dynstr, 0, 0, 0 ],
+        [ '.gnu.version', 0x6fffffff, 2, $versym, 1, 0, 2 ],
+        [ '.gnu.version_d', 0x6ffffffd, 2, $verdef, 2, 2, 0 ],
+        [ '.gnu.version_r', 0x6ffffffe, 2, $verneed, 2, 1, 0 ],
+        [ '.text', 1, 6, "\0" x 16, 0, 0, 0 ],
+        [ '.data', 1, 3, "\0" x 16, 0, 0, 0 ],
+        [ '.dynamic', 6, 3, $dynamic, 2, 0, $is64 ? 16 : 8 ],
+        [ '.shstrtab', 3, 0, $shstrtab, 0, 0, 0 ],
+    );
+
+    my $ehsize = $is64 ? 64 : 52;
+    my $shentsize = $is64 ? 64 : 40;
+    my $body = '';
+    my $shdrs = "\0" x $shentsize;
+    foreach my $sect (@sects) {
+        my ($name, $type, $flags, $data, $link, $info, $entsize) = @{$sect};
+        my $offset = $ehsize + length $body;
+
+        $body .= $data;
+        $body .= "\0" x (-length($body) % 8);
+
+        if ($is64) {
+            $shdrs .= pack "${word}${word}${addr}${addr}${addr}${addr}" .
+                           "${word}${word}${addr}${addr}",
+                $shstr->{$name}, $type, $flags, $offset, $offset,
+                length $data, $link, $info, 8, $entsize;
+        } else {
+            $shdrs .= pack "${word}" x 10,
+                $shstr->{$name}, $type, $flags, $offset, $offset,
+                length $data, $link, $info, 8, $entsize;
+        }
+    }
+
+    my $ident = pack 'a4CCCCx8', "\177ELF", $is64 ? 2 : 1, $msb ? 2 : 1, 1, 0;
+    my $shoff = $ehsize + length $body;
+    my $ehdr = $ident . pack "${half}${half}${word}${addr}${addr}${addr}" .
+                             "${word}${half}${half}${half}${half}${half}${half}",
+        3, 0, 1, 0, 0, $shoff, 0, $ehsize, 0, 0,
+        $shentsize, scalar(@sects) + 1, scalar(@sects);
+
+    return $ehdr . $body . $shdrs;
+}
+
+sub write_file {
+    my ($filename, $data) = @_;
+
+    open my $fh, '>', $filename or die "cannot create $filename: $!";
+    binmode $fh;
+    print { $fh } $data;
+    close $fh or die "cannot write $filename: $!";
+}
+
+sub run_elfdump {
+    my @files = @_;
+
+    open my $fh, '-|', $elfdump, '--', @files
+        or die "cannot execute $elfdump: $!";
+    local $/;
+    my $output = <$fh>;
+    close $fh;
+
+    return ($? >> 8, $output);
+}
+
+sub parse_objdump {
+    my $file = shift;
+    my $obj = Dpkg::Shlibs::Objdump::Object->new;
+
+    local $ENV{LC_ALL} = 'C';
+    open my $fh, '-|', 'objdump', '-w', '-f', '-p', '-T', '-R', $file
+        or die "cannot execute objdump: $!";
+    $obj->parse_objdump_output($fh);
+    close $fh;
+
+    return $obj;
+}
+
+sub parse_elfdump {
+    my $output = shift;
+    my $obj = Dpkg::Shlibs::Objdump::Object->new;
+
+    open my $fh, '<', \$output or die "cannot read output: $!";
+    $obj->parse_elfdump_output($fh);
+    close $fh;
+
+    return $obj;
+}
+
+# Test that the output matches the objdump parsing.
+foreach my $bits (32, 64) {
+    foreach my $msb (0, 1) {
+        my $format = "elf$bits-" . ($msb ? 'big' : 'little');
+        my $file = "$tmpdir/$format.so";
+
+        write_file($file, elf_gen_object($bits, $msb));
+
+        my ($rc, $output) = run_elfdump($file);
+        is($rc, 0, "dpkg-elfdump exits successfully for $format");
+        unlike($output, qr/^error\t/m, "dpkg-elfdump parses $format");
+
+        my $obj_elfdump = parse_elfdump($output);
+        my $obj_objdump = parse_objdump($file);
+
+        is_deeply($obj_elfdump, $obj_objdump,
+                  "dpkg-elfdump matches objdump for $format");
+        is($obj_elfdump->{HASH},
+           sprintf('0x%0*x', $bits / 4, 0x260),
+           "hash address is zero-padded for $format");
+    }
+}
+
+# Test that unparsable objects get reported, so that objdump gets used.
+my $object = elf_gen_object(64, 0);
+my $shoff = unpack 'Q<', substr $object, 40, 8;
+my %corrupt = (
+    'truncated-header' => [
+        substr($object, 0, 40),
+        qr/^error\ttruncated ELF header$/m,
+    ],
+    'truncated-sections' => [
+        substr($object, 0, $shoff + 100),
+        qr/^error\ttruncated section headers$/m,
+    ],
+    'bad-strtab-link' => [
+        # Point the .dynamic section link to a nonexistent section.
+        substr($object, 0, $shoff + 8 * 64 + 40) . pack('L<', 99) .
+        substr($object, $shoff + 8 * 64 + 44),
+        qr/^error\tinvalid string table link 99$/m,
+    ],
+    'bad-class' => [
+        substr($object, 0, 4) . "\x07" . substr($object, 5),
+        qr/^error\tunknown ELF class 7$/m,
+    ],
+);
+
+foreach my $name (sort keys %corrupt) {
+    my ($data, $error) = @{$corrupt{$name}};
+    my $file = "$tmpdir/$name.so";
+
+    write_file($file, $data);
+
+    my ($rc, $output) = run_elfdump($file);
+    is($rc, 0, "dpkg-elfdump exits successfully for $name");
+    like($output, $error, "dpkg-elfdump reports $name");
+}
+
+# Test that the batched scanning only caches the parsable objects.
+my @files = map { "$tmpdir/$_.so" } qw(elf32-little truncated-header elf64-big);
+Dpkg::Shlibs::Objdump::scan_files(@files);
+ok(defined Dpkg::Shlibs::Objdump::get_elfdump_output($files[0]),
+   'scanned elf32-little output is cached');
+ok(!defined Dpkg::Shlibs::Objdump::get_elfdump_output($files[1]),
+   'scanned truncated-header output is not cached');
+ok(defined Dpkg::Shlibs::Objdump::get_elfdump_output($files[2]),
+   'scanned elf64-big output is cached');
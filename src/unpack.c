@@ -431,6 +431,7 @@ pkg_infodb_remove_file(const char *filename, const char *filetype)
 {
   if (unlink(filename))
     ohshite(_("unable to delete control info file '%.250s'"), filename);
+  pkg_infodb_index_remove_file(filename);
 
   debug(dbg_scripts, "removal_bulk info unlinked %s", filename);
 }
@@ -481,6 +482,7 @@ pkg_infodb_update(struct pkginfo *pkg, char *cidir, char *cidirrest)
       if (unlink(match_node->filename))
         ohshite(_("unable to remove obsolete info file '%.250s'"),
                 match_node->filename);
+      pkg_infodb_index_remove_file(match_node->filename);
       debug(dbg_scripts, "process_archive info unlinked %s",
             match_node->filename);
     } else {
@@ -491,6 +493,7 @@ pkg_infodb_update(struct pkginfo *pkg, char *cidir, char *cidirrest)
   }
 
   /* The control directory itself. */
+  pkg_infodb_setup_pkgdir(pkg, &pkg->available);
   cidirrest[0] = '\0';
   dsd = opendir(cidir);
   if (!dsd)
@@ -534,6 +537,7 @@ pkg_infodb_update(struct pkginfo *pkg, char *cidir, char *cidirrest)
     if (rename(cidir, newinfofilename))
       ohshite(_("unable to install new info file '%.250s' as '%.250s'"),
               cidir, newinfofilename);
+    pkg_infodb_index_add_file(newinfofilename);
 
     debug(dbg_scripts,
           "process_archive tmp.ci script/file '%s' installed as '%s'",
@@ -549,9 +553,10 @@ pkg_infodb_update(struct pkginfo *pkg, char *cidir, char *cidirrest)
     debug(dbg_scripts,
           "process_archive remove old info files after db layout switch");
     pkg_infodb_foreach(pkg, &pkg->installed, pkg_infodb_remove_file);
+    pkg_infodb_remove_pkgdir(pkg, &pkg->installed);
   }
 
-  dir_sync_path(pkg_infodb_get_dir());
+  pkg_infodb_sync_pkgdir(pkg, &pkg->available);
 }
 
 static void
@@ -585,7 +590,7 @@ pkg_remove_old_files(struct pkginfo *pkg,
         continue;
     }
 
-    if (lstat(fnamevb.buf, &oldfs)) {
+    if (ondisk_lstat(usenode, fnamevb.buf, &oldfs)) {
       if (!(errno == ENOENT || errno == ELOOP || errno == ENOTDIR))
         warning(_("could not stat old file '%.250s' so not deleting it: %s"),
                 fnamevb.buf, strerror(errno));
@@ -601,9 +606,11 @@ pkg_remove_old_files(struct pkginfo *pkg,
       if (rmdir(fnamevb.buf)) {
         warning(_("unable to delete old directory '%.250s': %s"),
                 namenode->name, strerror(errno));
-      } else if ((namenode->flags & fnnf_old_conff)) {
-        warning(_("old conffile '%.250s' was an empty directory "
-                  "(and has now been deleted)"), namenode->name);
+      } else {
+        ondisk_stat_invalidate(usenode);
+        if (namenode->flags & fnnf_old_conff)
+          warning(_("old conffile '%.250s' was an empty directory "
+                    "(and has now been deleted)"), namenode->name);
       }
     } else {
       struct fileinlist *sameas = NULL;
@@ -645,7 +652,7 @@ pkg_remove_old_files(struct pkginfo *pkg,
           varbuf_add_str(&cfilename, cfile->namenode->name);
           varbuf_end_str(&cfilename);
 
-          if (lstat(cfilename.buf, &tmp_stat) == 0) {
+          if (ondisk_lstat(cfile->namenode, cfilename.buf, &tmp_stat) == 0) {
             struct file_ondisk_id *file_ondisk_id;
 
             file_ondisk_id = nfmalloc(sizeof(*file_ondisk_id));
@@ -711,6 +718,7 @@ pkg_remove_old_files(struct pkginfo *pkg,
         warning(_("unable to securely remove old file '%.250s': %s"),
                 namenode->name, strerror(errno));
       }
+      ondisk_stat_invalidate(usenode);
     } /* !S_ISDIR */
   }
 }
@@ -819,7 +827,8 @@ pkg_disappear(struct pkginfo *pkg, struct pkginfo *infavour)
   /* OK, now we delete all the stuff in the ‘info’ directory ... */
   debug(dbg_general, "pkg_disappear cleaning info directory");
   pkg_infodb_foreach(pkg, &pkg->installed, pkg_infodb_remove_file);
-  dir_sync_path(pkg_infodb_get_dir());
+  pkg_infodb_sync_pkgdir(pkg, &pkg->installed);
+  pkg_infodb_remove_pkgdir(pkg, &pkg->installed);
 
   pkg_set_status(pkg, PKG_STAT_NOTINSTALLED);
   pkg_set_want(pkg, PKG_WANT_UNKNOWN);
@@ -1194,6 +1203,8 @@ void process_archive(const char *filename) {
 
   ensure_allinstfiles_available();
   filesdbinit();
+  ondisk_stat_flush();
+  tar_writeback_reset();
   trig_file_interests_ensure();
 
   printf(_("Preparing to unpack %s ...\n"), pfilename);
@@ -1427,6 +1438,7 @@ void process_archive(const char *filename) {
   newfiles_queue.tail = &newfiles_queue.head;
   tc.newfiles_queue = &newfiles_queue;
   push_cleanup(cu_fileslist, ~0, 0);
+  push_cleanup(cu_writeback, ehflag_bombout, 0);
   tc.pkg= pkg;
   tc.backendpipe= p1[0];
   tc.pkgset_getting_in_sync = pkgset_getting_in_sync(pkg);
@@ -0,0 +1,286 @@
+/*
+ * dpkg-deb - construction and deconstruction of *.deb archives
+ * b-dpkg-deb.c - benchmark package building
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/dpkg.h>
+#include <dpkg/ehandle.h>
+#include <dpkg/options.h>
+#include <dpkg/string.h>
+#include <dpkg/subproc.h>
+#include <dpkg/command.h>
+
+/*
+ * The benchmark generates packages with conffiles lists of different
+ * lengths, and builds them with dpkg-deb to time its control area checks.
+ * It can be controlled with these environment variables:
+ *
+ *   BENCH_TMPDIR	  working directory (default: b-dpkg-deb.tmp)
+ *   BENCH_CONFFILES	  comma separated list of conffiles list lengths
+ *			  (default: 2000,20000)
+ *   BENCH_SCALE	  list length multiplier (default: 1)
+ *
+ * The results are printed one per line, as space separated key=value
+ * pairs, so that they can be easily tracked across versions. The time
+ * per conffile should stay roughly the same for all the list lengths.
+ */
+
+static const char *bench_tmpdir;
+static int bench_scale;
+
+static void DPKG_ATTR_PRINTF(1)
+bench_mkdir(const char *fmt, ...)
+{
+	va_list args;
+	char *dirname;
+	char *slash;
+
+	va_start(args, fmt);
+	m_vasprintf(&dirname, fmt, args);
+	va_end(args);
+
+	for (slash = strchr(dirname + 1, '/'); ; slash = strchr(slash + 1, '/')) {
+		if (slash)
+			*slash = '\0';
+		if (mkdir(dirname, 0755) < 0 && errno != EEXIST)
+			ohshite("cannot create directory '%s'", dirname);
+		if (slash == NULL)
+			break;
+		*slash = '/';
+	}
+
+	free(dirname);
+}
+
+static void
+bench_gen_package(const char *root, int n)
+{
+	FILE *control, *conffiles;
+	char *filename;
+	int i;
+
+	bench_mkdir("%s/DEBIAN", root);
+	bench_mkdir("%s/etc", root);
+
+	filename = str_fmt("%s/DEBIAN/control", root);
+	control = fopen(filename, "w");
+	if (control == NULL)
+		ohshite("cannot create '%s'", filename);
+	free(filename);
+
+	fprintf(control,
+	        "Package: bench-conffiles\n"
+	        "Version: 1.0\n"
+	        "Section: test\n"
+	        "Priority: extra\n"
+	        "Maintainer: Dpkg Developers <debian-dpkg@lists.debian.org>\n"
+	        "Architecture: all\n"
+	        "Description: benchmark package\n");
+
+	if (ferror(control) || fclose(control))
+		ohshite("cannot write control file");
+
+	filename = str_fmt("%s/DEBIAN/conffiles", root);
+	conffiles = fopen(filename, "w");
+	if (conffiles == NULL)
+		ohshite("cannot create '%s'", filename);
+	free(filename);
+
+	for (i = 0; i < n; i++) {
+		int fd;
+
+		filename = str_fmt("%s/etc/conffile-%d", root, i);
+		fd = creat(filename, 0644);
+		if (fd < 0 || close(fd) < 0)
+			ohshite("cannot create '%s'", filename);
+		free(filename);
+
+		fprintf(conffiles, "/etc/conffile-%d\n", i);
+	}
+
+	if (ferror(conffiles) || fclose(conffiles))
+		ohshite("cannot write conffiles");
+}
+
+static void
+bench_run(struct command *cmd, const char *output)
+{
+	pid_t pid;
+
+	pid = subproc_fork();
+	if (pid == 0) {
+		int fd_out;
+
+		fd_out = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd_out < 0)
+			ohshite("cannot open '%s'", output);
+		m_dup2(fd_out, 1);
+
+		command_exec(cmd);
+	}
+	subproc_reap(pid, cmd->name, 0);
+}
+
+static double
+bench_parse_checks(const char *logname, int n)
+{
+	char line[512];
+	FILE *log;
+	double checks = -1;
+
+	log = fopen(logname, "r");
+	if (log == NULL)
+		ohshite("cannot open '%s'", logname);
+	while (fgets(line, sizeof(line), log)) {
+		const char *dir;
+		double total, seconds;
+
+		if (sscanf(line, "dpkg-deb: built '%*[^']' in %lfs (checks %lfs",
+		           &total, &seconds) != 2)
+			continue;
+		dir = strstr(line, "/conffiles-");
+		if (dir == NULL)
+			continue;
+		if (strtol(dir + strlen("/conffiles-"), NULL, 10) == n)
+			checks = seconds;
+	}
+	fclose(log);
+
+	if (checks < 0)
+		ohshit("missing control area checks timing for %d conffiles", n);
+
+	return checks;
+}
+
+static void
+bench_build_checks(int *sizes, int nsizes)
+{
+	struct command cmd;
+	char *listname, *logname;
+	FILE *list;
+	int i;
+
+	listname = str_fmt("%s/build-list", bench_tmpdir);
+	logname = str_fmt("%s/build-log", bench_tmpdir);
+
+	list = fopen(listname, "w");
+	if (list == NULL)
+		ohshite("cannot create '%s'", listname);
+	for (i = 0; i < nsizes; i++) {
+		char *root;
+
+		root = str_fmt("%s/conffiles-%d", bench_tmpdir, sizes[i]);
+		bench_gen_package(root, sizes[i]);
+		fprintf(list, "%s %s.deb\n", root, root);
+		free(root);
+	}
+	if (ferror(list) || fclose(list))
+		ohshite("cannot write '%s'", listname);
+
+	/* Build the packages one at a time, so that the timings do not
+	 * interfere with each other. */
+	command_init(&cmd, "dpkg-deb", "dpkg-deb");
+	command_add_args(&cmd, "dpkg-deb", "-Znone", "--root-owner-group",
+	                 "--jobs=1", "--build-many", listname, NULL);
+	bench_run(&cmd, logname);
+	command_destroy(&cmd);
+
+	for (i = 0; i < nsizes; i++) {
+		double checks = bench_parse_checks(logname, sizes[i]);
+
+		printf("bench=dpkg-deb phase=build-checks conffiles=%d "
+		       "seconds=%.6f usecs_per_conffile=%.3f\n", sizes[i], checks,
+		       checks * 1000000.0 / sizes[i]);
+	}
+
+	free(listname);
+	free(logname);
+}
+
+static const char *
+bench_getenv_str(const char *name, const char *def)
+{
+	const char *value = getenv(name);
+
+	if (str_is_unset(value))
+		return def;
+
+	return value;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *conffiles;
+	char *list, *item, *sep;
+	int *sizes = NULL;
+	int nsizes = 0;
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	push_error_context();
+
+	bench_tmpdir = bench_getenv_str("BENCH_TMPDIR", "b-dpkg-deb.tmp");
+	conffiles = bench_getenv_str("BENCH_CONFFILES", "2000,20000");
+	bench_scale = dpkg_options_parse_env_int("BENCH_SCALE", 1);
+	if (bench_scale < 1)
+		ohshit("invalid value '%d' for BENCH_SCALE", bench_scale);
+
+	list = m_strdup(conffiles);
+	for (item = list; item; item = sep) {
+		char *endp;
+		long n;
+
+		sep = strchr(item, ',');
+		if (sep)
+			*sep++ = '\0';
+
+		errno = 0;
+		n = strtol(item, &endp, 10);
+		if (*endp || errno || n < 1 || n > INT_MAX / bench_scale)
+			ohshit("invalid value '%s' for BENCH_CONFFILES", item);
+
+		sizes = m_realloc(sizes, (nsizes + 1) * sizeof(*sizes));
+		sizes[nsizes++] = n * bench_scale;
+	}
+	free(list);
+
+	printf("bench=dpkg-deb conffiles=%s scale=%d\n", conffiles, bench_scale);
+
+	bench_mkdir("%s", bench_tmpdir);
+	bench_build_checks(sizes, nsizes);
+
+	free(sizes);
+
+	pop_error_context(ehflag_normaltidy);
+
+	return 0;
+}
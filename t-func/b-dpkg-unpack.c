@@ -0,0 +1,685 @@
+/*
+ * dpkg - main program for package management
+ * b-dpkg-unpack.c - benchmark package install, upgrade and removal
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/dpkg.h>
+#include <dpkg/ehandle.h>
+#include <dpkg/clock.h>
+#include <dpkg/options.h>
+#include <dpkg/string.h>
+#include <dpkg/varbuf.h>
+#include <dpkg/subproc.h>
+#include <dpkg/command.h>
+
+/*
+ * The benchmark generates .deb corpora with controlled shapes, and then
+ * times installing, upgrading and removing them with dpkg into a sandbox
+ * root directory. It can be controlled with these environment variables:
+ *
+ *   BENCH_TMPDIR	  working directory (default: b-dpkg-unpack.tmp)
+ *   BENCH_SHAPES	  comma separated list of corpus shapes to use
+ *			  (default: tiny,huge,deep,conffiles,links)
+ *   BENCH_COMPRESSORS	  comma separated list of compressors to use
+ *			  (default: gzip)
+ *   BENCH_SCALE	  corpus size multiplier (default: 1)
+ *   BENCH_STRACE	  strace program to count the sync calls with, in
+ *			  an additional untimed run (default: none)
+ *   BENCH_DPKG_OPTS	  space separated list of additional dpkg options,
+ *			  such as tuning thresholds to compare (default: none)
+ *
+ * When not running as root, the dpkg commands are run under fakeroot.
+ *
+ * The results are printed one per line, as space separated key=value
+ * pairs, so that they can be easily tracked across versions. The peak
+ * RSS is the one of the largest process in the dpkg process tree.
+ */
+
+struct bench_corpus {
+	const char *shape;
+	const char *compressor;
+	char *pkgname;
+	char *debs[2];
+	long files;
+	long bytes;
+};
+
+struct bench_result {
+	double seconds;
+	long max_rss;
+	long fsyncs;
+};
+
+static const char *bench_tmpdir;
+static const char *bench_strace;
+static const char *bench_dpkg_opts;
+static const char *bench_wrapper;
+static int bench_scale;
+
+/*
+ * Corpus generation.
+ */
+
+static void DPKG_ATTR_PRINTF(1)
+bench_mkdir(const char *fmt, ...)
+{
+	va_list args;
+	char *dirname;
+	char *slash;
+
+	va_start(args, fmt);
+	m_vasprintf(&dirname, fmt, args);
+	va_end(args);
+
+	for (slash = strchr(dirname + 1, '/'); ; slash = strchr(slash + 1, '/')) {
+		if (slash)
+			*slash = '\0';
+		if (mkdir(dirname, 0755) < 0 && errno != EEXIST)
+			ohshite("cannot create directory '%s'", dirname);
+		if (slash == NULL)
+			break;
+		*slash = '/';
+	}
+
+	free(dirname);
+}
+
+static unsigned long bench_seed = 1;
+
+static long
+bench_write_file(const char *filename, long size)
+{
+	char block[4096];
+	long done;
+	int fd;
+	int i;
+
+	fd = creat(filename, 0644);
+	if (fd < 0)
+		ohshite("cannot create '%s'", filename);
+
+	for (i = 0; i < (int)sizeof(block); i++) {
+		bench_seed = bench_seed * 1103515245 + 12345;
+		block[i] = bench_seed >> 16;
+	}
+
+	for (done = 0; done < size; done += sizeof(block)) {
+		size_t len = size - done;
+
+		if (len > sizeof(block))
+			len = sizeof(block);
+
+		/* Make each block different, but still somewhat compressible. */
+		memcpy(block, &done, sizeof(done));
+		if (write(fd, block, len) != (ssize_t)len)
+			ohshite("cannot write '%s'", filename);
+	}
+
+	if (close(fd) < 0)
+		ohshite("cannot close '%s'", filename);
+
+	return size;
+}
+
+static void
+bench_gen_tiny(struct bench_corpus *bc, const char *root)
+{
+	int n = 2000 * bench_scale;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		char *filename;
+
+		if (i % 100 == 0) {
+			bench_mkdir("%s/usr/share/%s/dir-%d", root, bc->pkgname,
+			            i / 100);
+			bc->files++;
+		}
+
+		filename = str_fmt("%s/usr/share/%s/dir-%d/file-%d", root,
+		                   bc->pkgname, i / 100, i);
+		bc->bytes += bench_write_file(filename, 64 + i % 512);
+		bc->files++;
+		free(filename);
+	}
+}
+
+static void
+bench_gen_huge(struct bench_corpus *bc, const char *root)
+{
+	int i;
+
+	bench_mkdir("%s/usr/share/%s", root, bc->pkgname);
+
+	for (i = 0; i < 2; i++) {
+		char *filename;
+
+		filename = str_fmt("%s/usr/share/%s/huge-%d", root,
+		                   bc->pkgname, i);
+		bc->bytes += bench_write_file(filename, 16L * 1024 * 1024 *
+		                                        bench_scale);
+		bc->files++;
+		free(filename);
+	}
+}
+
+static void
+bench_gen_deep(struct bench_corpus *bc, const char *root)
+{
+	struct varbuf path = VARBUF_INIT;
+	int chain, depth;
+
+	for (chain = 0; chain < 16 * bench_scale; chain++) {
+		varbuf_reset(&path);
+		varbuf_printf(&path, "%s/usr/share/%s/chain-%d", root,
+		              bc->pkgname, chain);
+
+		for (depth = 0; depth < 32; depth++) {
+			char *filename;
+
+			varbuf_printf(&path, "/level-%d", depth);
+			bench_mkdir("%s", path.buf);
+			bc->files++;
+
+			filename = str_fmt("%s/file", path.buf);
+			bc->bytes += bench_write_file(filename, 128);
+			bc->files++;
+			free(filename);
+		}
+	}
+
+	varbuf_destroy(&path);
+}
+
+static void
+bench_gen_conffiles(struct bench_corpus *bc, const char *root)
+{
+	FILE *conffiles;
+	char *filename;
+	int n = 200 * bench_scale;
+	int i;
+
+	bench_mkdir("%s/etc/%s", root, bc->pkgname);
+
+	filename = str_fmt("%s/DEBIAN/conffiles", root);
+	conffiles = fopen(filename, "w");
+	if (conffiles == NULL)
+		ohshite("cannot create '%s'", filename);
+	free(filename);
+
+	for (i = 0; i < n; i++) {
+		filename = str_fmt("%s/etc/%s/conf-%d", root, bc->pkgname, i);
+		bc->bytes += bench_write_file(filename, 256);
+		bc->files++;
+		free(filename);
+
+		fprintf(conffiles, "/etc/%s/conf-%d\n", bc->pkgname, i);
+	}
+
+	if (ferror(conffiles) || fclose(conffiles))
+		ohshite("cannot write conffiles");
+}
+
+static void
+bench_gen_links(struct bench_corpus *bc, const char *root)
+{
+	int n = 500 * bench_scale;
+	int i;
+
+	bench_mkdir("%s/usr/share/%s/targets", root, bc->pkgname);
+	bench_mkdir("%s/usr/share/%s/symlinks", root, bc->pkgname);
+	bench_mkdir("%s/usr/share/%s/hardlinks", root, bc->pkgname);
+
+	for (i = 0; i < 10; i++) {
+		char *filename;
+
+		filename = str_fmt("%s/usr/share/%s/targets/target-%d", root,
+		                   bc->pkgname, i);
+		bc->bytes += bench_write_file(filename, 4096);
+		bc->files++;
+		free(filename);
+	}
+
+	for (i = 0; i < n; i++) {
+		char *target, *linkname;
+
+		target = str_fmt("../targets/target-%d", i % 10);
+		linkname = str_fmt("%s/usr/share/%s/symlinks/symlink-%d", root,
+		                   bc->pkgname, i);
+		if (symlink(target, linkname) < 0)
+			ohshite("cannot create symlink '%s'", linkname);
+		bc->files++;
+		free(target);
+		free(linkname);
+
+		target = str_fmt("%s/usr/share/%s/targets/target-%d", root,
+		                 bc->pkgname, i % 10);
+		linkname = str_fmt("%s/usr/share/%s/hardlinks/hardlink-%d", root,
+		                   bc->pkgname, i);
+		if (link(target, linkname) < 0)
+			ohshite("cannot create hard link '%s'", linkname);
+		bc->files++;
+		free(target);
+		free(linkname);
+	}
+}
+
+static const struct bench_shape {
+	const char *name;
+	void (*gen)(struct bench_corpus *bc, const char *root);
+} bench_shapes[] = {
+	{ "tiny",	bench_gen_tiny },
+	{ "huge",	bench_gen_huge },
+	{ "deep",	bench_gen_deep },
+	{ "conffiles",	bench_gen_conffiles },
+	{ "links",	bench_gen_links },
+	{ NULL,		NULL },
+};
+
+static const struct bench_shape *
+bench_shape_find(const char *name)
+{
+	const struct bench_shape *shape;
+
+	for (shape = bench_shapes; shape->name; shape++)
+		if (strcmp(shape->name, name) == 0)
+			return shape;
+
+	ohshit("unknown corpus shape '%s'", name);
+}
+
+static void
+bench_gen_control(const char *root, const char *pkgname, const char *version)
+{
+	char *filename;
+	FILE *control;
+
+	filename = str_fmt("%s/DEBIAN/control", root);
+	control = fopen(filename, "w");
+	if (control == NULL)
+		ohshite("cannot create '%s'", filename);
+	free(filename);
+
+	fprintf(control,
+	        "Package: %s\n"
+	        "Version: %s\n"
+	        "Section: test\n"
+	        "Priority: extra\n"
+	        "Maintainer: Dpkg Developers <debian-dpkg@lists.debian.org>\n"
+	        "Architecture: all\n"
+	        "Description: benchmark package\n", pkgname, version);
+
+	if (ferror(control) || fclose(control))
+		ohshite("cannot write control file");
+}
+
+/*
+ * Command execution.
+ */
+
+static void
+bench_run(struct command *cmd, struct bench_result *res)
+{
+	struct timespec start, end;
+	struct rusage usage;
+	pid_t pid;
+	int status;
+
+	dpkg_clock_get_monotonic(&start);
+
+	pid = subproc_fork();
+	if (pid == 0) {
+		int fd_null;
+
+		fd_null = open("/dev/null", O_WRONLY);
+		if (fd_null < 0)
+			ohshite("cannot open /dev/null");
+		m_dup2(fd_null, 1);
+
+		command_exec(cmd);
+	}
+
+	while (wait4(pid, &status, 0, &usage) < 0)
+		if (errno != EINTR)
+			ohshite("wait for %s failed", cmd->name);
+
+	dpkg_clock_get_monotonic(&end);
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		ohshit("%s failed", cmd->name);
+
+	res->seconds = dpkg_clock_elapsed(&start, &end);
+	res->max_rss = usage.ru_maxrss;
+}
+
+static void
+bench_cmd_init(struct command *cmd, const char *name)
+{
+	if (bench_wrapper) {
+		command_init(cmd, bench_wrapper, name);
+		command_add_arg(cmd, bench_wrapper);
+	} else {
+		command_init(cmd, name, name);
+	}
+	command_add_arg(cmd, name);
+}
+
+static long
+bench_parse_fsyncs(const char *logname)
+{
+	char line[512];
+	FILE *log;
+	long fsyncs = 0;
+
+	log = fopen(logname, "r");
+	if (log == NULL)
+		ohshite("cannot open '%s'", logname);
+	while (fgets(line, sizeof(line), log)) {
+		double percent, seconds;
+		long usecs, calls;
+
+		/* The summary table columns are: % time, seconds, usecs/call,
+		 * calls, errors (optional) and syscall. */
+		if (sscanf(line, "%lf %lf %ld %ld", &percent, &seconds,
+		           &usecs, &calls) == 4 && strstr(line, "total") == NULL)
+			fsyncs += calls;
+	}
+	fclose(log);
+
+	return fsyncs;
+}
+
+static void
+bench_dpkg(struct bench_result *res, bool strace,
+           const char *action, const char *what)
+{
+	struct command cmd;
+	char *logname = NULL;
+	char *rootopt;
+	char *admindiropt;
+	char *opts = NULL;
+
+	if (strace) {
+		logname = str_fmt("%s/strace.log", bench_tmpdir);
+
+		command_init(&cmd, bench_strace, "strace");
+		command_add_args(&cmd, bench_strace, "-f", "-c", "-o", logname,
+		                 "-e", "trace=fsync,fdatasync,sync_file_range,syncfs",
+		                 NULL);
+		if (bench_wrapper)
+			command_add_arg(&cmd, bench_wrapper);
+		command_add_arg(&cmd, "dpkg");
+	} else {
+		bench_cmd_init(&cmd, "dpkg");
+	}
+
+	rootopt = str_fmt("--root=%s/root", bench_tmpdir);
+	admindiropt = str_fmt("--admindir=%s/root/var/lib/dpkg", bench_tmpdir);
+	command_add_args(&cmd, rootopt, admindiropt, "--force-not-root",
+	                 "--force-confnew", "--log=/dev/null", NULL);
+	if (bench_dpkg_opts) {
+		char *opt, *next;
+
+		opts = m_strdup(bench_dpkg_opts);
+		for (opt = opts; opt; opt = next) {
+			next = strchr(opt, ' ');
+			if (next)
+				*next++ = '\0';
+			if (opt[0] != '\0')
+				command_add_arg(&cmd, opt);
+		}
+	}
+	command_add_args(&cmd, action, what, NULL);
+	bench_run(&cmd, res);
+	command_destroy(&cmd);
+	free(opts);
+	free(admindiropt);
+	free(rootopt);
+
+	if (strace) {
+		res->fsyncs = bench_parse_fsyncs(logname);
+		free(logname);
+	}
+}
+
+static void
+bench_report(struct bench_corpus *bc, const char *phase,
+             struct bench_result *res, bool data)
+{
+	printf("bench=dpkg-unpack shape=%s compressor=%s phase=%s "
+	       "seconds=%.6f", bc->shape, bc->compressor, phase, res->seconds);
+	if (data)
+		printf(" files=%ld files_per_second=%.0f "
+		       "bytes=%ld mb_per_second=%.2f",
+		       bc->files, bc->files / res->seconds, bc->bytes,
+		       bc->bytes / res->seconds / (1024 * 1024));
+	if (res->fsyncs >= 0)
+		printf(" fsyncs=%ld", res->fsyncs);
+	else
+		printf(" fsyncs=unknown");
+	printf(" max_rss_kib=%ld\n", res->max_rss);
+}
+
+static void
+bench_corpus_build(struct bench_corpus *bc, const struct bench_shape *shape)
+{
+	struct bench_result res = { .fsyncs = -1 };
+	char *root;
+	int v;
+
+	bc->pkgname = str_fmt("bench-%s-%s", bc->shape, bc->compressor);
+	bc->files = 0;
+	bc->bytes = 0;
+
+	root = str_fmt("%s/corpus/%s", bench_tmpdir, bc->pkgname);
+	bench_mkdir("%s/DEBIAN", root);
+	shape->gen(bc, root);
+
+	for (v = 0; v < 2; v++) {
+		struct command cmd;
+		char *version;
+		char *compopt;
+
+		version = str_fmt("%d.0", v + 1);
+		bench_gen_control(root, bc->pkgname, version);
+		free(version);
+
+		bc->debs[v] = str_fmt("%s/corpus/%s-%d.deb", bench_tmpdir,
+		                      bc->pkgname, v + 1);
+
+		compopt = str_fmt("-Z%s", bc->compressor);
+		bench_cmd_init(&cmd, "dpkg-deb");
+		command_add_args(&cmd, compopt, "--root-owner-group", "--build",
+		                 root, bc->debs[v], NULL);
+		bench_run(&cmd, &res);
+		command_destroy(&cmd);
+		free(compopt);
+	}
+
+	bench_report(bc, "build", &res, true);
+
+	free(root);
+}
+
+enum bench_phase {
+	BENCH_INSTALL,
+	BENCH_UPGRADE,
+	BENCH_REMOVE,
+	BENCH_PHASES,
+};
+
+static void
+bench_sequence(struct bench_corpus *bc, struct bench_result *res, bool strace)
+{
+	bench_dpkg(&res[BENCH_INSTALL], strace, "--install", bc->debs[0]);
+	bench_dpkg(&res[BENCH_UPGRADE], strace, "--install", bc->debs[1]);
+	bench_dpkg(&res[BENCH_REMOVE], strace, "--purge", bc->pkgname);
+}
+
+static void
+bench_corpus(const struct bench_shape *shape, const char *compressor)
+{
+	struct bench_corpus bc = { 0 };
+	struct bench_result res[BENCH_PHASES];
+	struct bench_result res_strace[BENCH_PHASES];
+	int phase;
+
+	bc.shape = shape->name;
+	bc.compressor = compressor;
+	bench_corpus_build(&bc, shape);
+
+	bench_sequence(&bc, res, false);
+
+	/* Count the sync calls in a separate run, to not skew the timings. */
+	for (phase = 0; phase < BENCH_PHASES; phase++)
+		res[phase].fsyncs = -1;
+	if (bench_strace) {
+		bench_sequence(&bc, res_strace, true);
+		for (phase = 0; phase < BENCH_PHASES; phase++)
+			res[phase].fsyncs = res_strace[phase].fsyncs;
+	}
+
+	bench_report(&bc, "install", &res[BENCH_INSTALL], true);
+	bench_report(&bc, "upgrade", &res[BENCH_UPGRADE], true);
+	bench_report(&bc, "remove", &res[BENCH_REMOVE], false);
+
+	free(bc.pkgname);
+	free(bc.debs[0]);
+	free(bc.debs[1]);
+}
+
+static void
+bench_setup_root(void)
+{
+	char *statusfile;
+	int fd;
+
+	bench_mkdir("%s/root/var/lib/dpkg/info", bench_tmpdir);
+	bench_mkdir("%s/root/var/lib/dpkg/updates", bench_tmpdir);
+	bench_mkdir("%s/root/var/lib/dpkg/triggers", bench_tmpdir);
+
+	statusfile = str_fmt("%s/root/var/lib/dpkg/status", bench_tmpdir);
+	fd = creat(statusfile, 0644);
+	if (fd < 0)
+		ohshite("cannot create '%s'", statusfile);
+	close(fd);
+	free(statusfile);
+}
+
+static char *
+bench_list_next(char **list)
+{
+	char *item = *list;
+	char *sep;
+
+	if (item == NULL)
+		return NULL;
+
+	sep = strchr(item, ',');
+	if (sep) {
+		*sep = '\0';
+		*list = sep + 1;
+	} else {
+		*list = NULL;
+	}
+
+	return item;
+}
+
+static const char *
+bench_getenv_str(const char *name, const char *def)
+{
+	const char *value = getenv(name);
+
+	if (str_is_unset(value))
+		return def;
+
+	return value;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *shapes, *compressors;
+	char *shapes_list, *compressors_list;
+	char *shape, *compressor;
+	char *list;
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	push_error_context();
+
+	bench_tmpdir = bench_getenv_str("BENCH_TMPDIR", "b-dpkg-unpack.tmp");
+	if (bench_tmpdir[0] != '/') {
+		char *cwd = getcwd(NULL, 0);
+
+		if (cwd == NULL)
+			ohshite("cannot get current directory");
+		bench_tmpdir = str_fmt("%s/%s", cwd, bench_tmpdir);
+		free(cwd);
+	}
+	shapes = bench_getenv_str("BENCH_SHAPES",
+	                          "tiny,huge,deep,conffiles,links");
+	compressors = bench_getenv_str("BENCH_COMPRESSORS", "gzip");
+	bench_scale = dpkg_options_parse_env_int("BENCH_SCALE", 1);
+	if (bench_scale < 1)
+		ohshit("invalid value '%d' for BENCH_SCALE", bench_scale);
+	bench_strace = bench_getenv_str("BENCH_STRACE", NULL);
+	bench_dpkg_opts = bench_getenv_str("BENCH_DPKG_OPTS", NULL);
+	if (getuid() != 0)
+		bench_wrapper = "fakeroot";
+
+	printf("bench=dpkg-unpack shapes=%s compressors=%s scale=%d "
+	       "wrapper=%s dpkg-opts=\"%s\"\n", shapes, compressors, bench_scale,
+	       bench_wrapper ? bench_wrapper : "none",
+	       bench_dpkg_opts ? bench_dpkg_opts : "");
+
+	bench_setup_root();
+
+	compressors_list = list = m_strdup(compressors);
+	while ((compressor = bench_list_next(&compressors_list))) {
+		char *shapes_dup;
+
+		shapes_list = shapes_dup = m_strdup(shapes);
+		while ((shape = bench_list_next(&shapes_list)))
+			bench_corpus(bench_shape_find(shape), compressor);
+		free(shapes_dup);
+	}
+	free(list);
+
+	pop_error_context(ehflag_normaltidy);
+
+	return 0;
+}